@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CACQSESSION_H
+#define CACQSESSION_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QPointF>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "CComm.h"
+#include "CCommReplay.h"
+#include "CProtocol.h"
+#include "CLidarConfig.h"
+#include "CCloudPoints.h"
+#include "CSynthScene.h"
+#include "CStageTimer.h"
+
+/**
+ * @brief One received scan as handed to the sinks (acquisition thread).
+ */
+struct AcqScan {
+    int sensor;
+    quint64 seq;
+    qint64 epochNs;             // receive time
+    quint32 configHash;
+    QByteArray frame;           // as received
+    QByteArray payload;         // getBulk payload: [angle, dist x channels] big endian
+    QVector<QPointF> points;    // meters, sensor frame; empty without the transform stage
+};
+
+class CAcqSession;
+
+/**
+ * @brief Output of a session. open/publish/close run on the session's thread.
+ */
+class IScanSink {
+public:
+    virtual ~IScanSink() {}
+    virtual bool open(const CAcqSession& session) = 0;
+    virtual void publish(const AcqScan& scan) = 0;
+    virtual void close() {}
+    virtual QString describe() const = 0;
+};
+
+/**
+ * @brief Widget-free acquisition loop: getBulk -> unpack -> decode -> transform -> sinks.
+ *
+ * The same request / reply exchange as CMainWin::runProtocol (exchange()),
+ * paced by `interval` ms from the start of one request to the next. Meant to
+ * live on its own thread (Comm blocks and spins the event loop while waiting).
+ * After RECONNECT_FAILURES failed scans in a row the link is reopened.
+ *
+ * To stop: requestInterruption() + quit() on the thread, then wait(). A scan in
+ * progress returns early, and the session is deleted on its own thread once the
+ * loop is out of it (connect QThread::finished to deleteLater). Never delete it
+ * through a queued call: Comm::doEvents() would run it in the middle of a scan.
+ */
+class CAcqSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum { RECONNECT_FAILURES = 10, RECONNECT_DELAY_MS = 1000, WAIT_FOR_CONN = 1000 };
+
+    struct Link {
+        QString commType;   // TCP, UDP, COM, VIRTUAL, REPLAY (init.json "commType")
+        QString address;    // ip, serial port name or replay file
+        int number = 0;     // port or baud rate
+        int intervalMs = 100;
+        double virtualHz = 20;
+    };
+
+    struct Stats {
+        std::atomic<quint64> scans{ 0 };
+        std::atomic<quint64> failures{ 0 };
+        std::atomic<quint64> reconnects{ 0 };
+        std::atomic<quint64> bytes{ 0 };
+    };
+
+    CAcqSession(int index, const QString& name, const LidarConfig& cfg, const Link& link, QObject* parent = nullptr)
+        : QObject(parent), m_index(index), m_name(name), m_cfg(cfg), m_link(link), m_timer(this)
+    {
+        m_reqWords = cfg.reqWordSize();
+        m_configHash = cfg.hash();
+        m_timer.setSingleShot(true);
+        connect(&m_timer, &QTimer::timeout, this, &CAcqSession::cycle);
+    }
+
+    ~CAcqSession() { stop(); }
+
+    // Before start().
+    void addSink(std::shared_ptr<IScanSink> sink) { m_sinks.push_back(sink); }
+    void setTransform(bool on) { m_transform = on; }
+
+    int index() const { return m_index; }
+    const QString& name() const { return m_name; }
+    const LidarConfig& config() const { return m_cfg; }
+    quint32 configHash() const { return m_configHash; }
+    int reqWordSize() const { return m_reqWords; }
+    const Link& link() const { return m_link; }
+    const Stats& stats() const { return m_stats; }
+
+    // Sends request; with reply, waits for the first bytes (50 x 30 ms) and reads up to expectedBytes.
+    static bool exchange(Comm* comm, QByteArray& request, QByteArray* reply, int expectedBytes)
+    {
+        if (!comm->send(request, 1000)) return false;
+        comm->waitForReady();
+        if (!reply) return true;
+
+        bool isOK = false;
+        {
+            CStageScope timing(CStageTimer::eStage::inbox);
+            for (int i = 0; i < 50; i++) {
+                comm->doEvents();
+                isOK = comm->inbox(30);
+                if (isOK) break;
+                comm->doEvents();
+                if (QThread::currentThread()->isInterruptionRequested()) return false;
+            }
+        }
+        int recvTimeout = isOK ? 300 : 100;
+        {
+            CStageScope timing(CStageTimer::eStage::recv);
+            isOK = comm->recv(*reply, recvTimeout, expectedBytes);
+        }
+        if (isOK) CStageTimer::addBytes(reply->size());
+        return isOK;
+    }
+
+public slots:
+    // Session thread.
+    void start()
+    {
+        m_cloud.reset(new CCloudPoints(nullptr, 1, m_cfg.mesuresPerScan * m_cfg.channels));
+        m_cloud->setOrientation(m_cfg.angleOffset, m_cfg.isClockwise);
+        m_cloud->setDistanceSettings(m_cfg.distanceRate, m_cfg.unitToMeter());
+
+        for (auto it = m_sinks.begin(); it != m_sinks.end(); ) {
+            if ((*it)->open(*this)) {
+                ++it;
+                continue;
+            }
+            qWarning().noquote() << m_name << ": couldn't open" << (*it)->describe();
+            it = m_sinks.erase(it);
+        }
+        if (!openLink()) qWarning().noquote() << m_name << ": couldn't connect" << m_link.commType << m_link.address;
+        m_timer.start(0);
+    }
+
+    void stop()
+    {
+        m_timer.stop();
+        if (m_comm) {
+            m_comm->close(WAIT_FOR_CONN);
+            delete m_comm;
+            m_comm = nullptr;
+        }
+        for (const std::shared_ptr<IScanSink>& sink : m_sinks) sink->close();
+        m_sinks.clear();
+    }
+
+private:
+    bool openLink()
+    {
+        if (m_comm) {
+            m_comm->close(WAIT_FOR_CONN);
+            delete m_comm;
+            m_comm = nullptr;
+        }
+        const QString type = m_link.commType.toUpper();
+        if (type == "UDP") m_comm = new CommUDP(this);
+        else if (type == "COM") m_comm = new CommSerial(this);
+        else if (type == "VIRTUAL") {
+            m_synth.reset(new CSynthScene);
+            m_synth->setScene(CSynthScene::loadScene());
+            m_synth->setRate(m_link.virtualHz);
+            m_synth->setProfile(m_cfg.channels, m_cfg.resolution, m_cfg.mesuresPerScan, m_cfg.distanceRate * m_cfg.unitToMeter());
+            m_virtualPayload = QByteArray(m_synth->payloadBytes(), 0);
+            CommVirtual* virt = new CommVirtual(this);
+            virt->setGenerator([this]() {
+                m_synth->generate((uchar*)m_virtualPayload.data());
+                return Protocol::pack(Protocol::eCmd::setBulk, 0, 0, m_reqWords, &m_virtualPayload, nullptr);
+            });
+            virt->setFrameRate(m_link.virtualHz);
+            m_comm = virt;
+        }
+        else if (type == "REPLAY") {
+            CommReplay* replay = new CommReplay(this);
+            replay->setFrameBytes(m_reqWords * 2 + 11);
+            replay->setMinFrameSize(m_reqWords * 2);
+            m_comm = replay;
+        }
+        else m_comm = new CommTCP(this);
+
+        m_comm->setConnInfo(m_link.address, m_link.number);
+        return m_comm->connect(WAIT_FOR_CONN);
+    }
+
+    void cycle()
+    {
+        if (QThread::currentThread()->isInterruptionRequested()) return;
+        QElapsedTimer stopwatch;
+        stopwatch.start();
+
+        if (scan()) m_failures = 0;
+        else if (QThread::currentThread()->isInterruptionRequested()) return;
+        else {
+            ++m_stats.failures;
+            if (++m_failures >= RECONNECT_FAILURES) {
+                m_failures = 0;
+                ++m_stats.reconnects;
+                openLink();
+                m_timer.start(RECONNECT_DELAY_MS);
+                return;
+            }
+        }
+        m_timer.start(int(qMax<qint64>(0, m_link.intervalMs - stopwatch.elapsed())));
+    }
+
+    bool scan()
+    {
+        if (!m_comm || !m_comm->isIdle()) return false;
+        CStageScope scanTiming(CStageTimer::eStage::scan);
+
+        AcqScan out;
+        QByteArray request = Protocol::pack(Protocol::eCmd::getBulk, 4, 0, m_reqWords);
+        if (!exchange(m_comm, request, &out.frame, m_reqWords * 2 + 11)) return false;
+        out.epochNs = QDateTime::currentMSecsSinceEpoch() * 1000000LL;
+        {
+            CStageScope timing(CStageTimer::eStage::unpack);
+            if (!Protocol::unpack(out.frame, nullptr, nullptr, nullptr, nullptr, &out.payload, nullptr)) return false;
+        }
+        if (m_transform) {
+            CStageScope timing(CStageTimer::eStage::process);
+            decodeScanPayload(out.payload, m_cfg.channels, m_cloud.get());
+            out.points = m_cloud->getPoints();
+        }
+
+        out.sensor = m_index;
+        out.seq = m_seq++;
+        out.configHash = m_configHash;
+        for (const std::shared_ptr<IScanSink>& sink : m_sinks) sink->publish(out);
+
+        ++m_stats.scans;
+        m_stats.bytes += out.frame.size();
+        return true;
+    }
+
+    int m_index;
+    QString m_name;
+    LidarConfig m_cfg;
+    Link m_link;
+    int m_reqWords = 0;
+    quint32 m_configHash = 0;
+    bool m_transform = true;
+
+    Comm* m_comm = nullptr;
+    QTimer m_timer;
+    std::unique_ptr<CCloudPoints> m_cloud;
+    std::unique_ptr<CSynthScene> m_synth;
+    QByteArray m_virtualPayload;
+    std::vector<std::shared_ptr<IScanSink>> m_sinks;
+    quint64 m_seq = 0;
+    int m_failures = 0;
+    Stats m_stats;
+};
+
+#endif // CACQSESSION_H
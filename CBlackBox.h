@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CBLACKBOX_H
+#define CBLACKBOX_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QtConcurrent>
+#include <atomic>
+#include <memory>
+#include <climits>
+#include <cstring>
+
+#include "CScanRecord.h"
+
+/**
+ * @brief Last-N-seconds ring of raw frames, dumped to a .lrec on trigger.
+ *
+ * Slots are preallocated (one fixed size each). push() is a memcpy plus two
+ * stores: every slot carries a sequence number (odd while written), so the
+ * dump thread copies a slot and keeps it only if the number did not change;
+ * frames overwritten during the dump are dropped instead of blocking
+ * acquisition. One producer (the acquisition thread), one dump at a time.
+ */
+class CBlackBox : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum { DEFAULT_MEGABYTES = 64, DEFAULT_SECONDS = 60 };
+
+    CBlackBox(QObject* parent = nullptr) : QObject(parent) { m_clock.start(); }
+    ~CBlackBox() { m_worker.waitForFinished(); }
+
+    // (Re)allocate for frames up to frameBytes. Clears the ring; false while dumping (retry after dumpFinished).
+    bool allocate(int frameBytes, int megabytes = DEFAULT_MEGABYTES)
+    {
+        if (isDumping() || frameBytes <= 0) return false;
+        m_slotBytes = frameBytes;
+        m_slotCount = qMax<qint64>(2, (qint64)megabytes * 1024 * 1024 / frameBytes);
+        m_storage = QByteArray(int(qMin<qint64>(m_slotCount * m_slotBytes, INT_MAX)), 0);
+        m_slotCount = m_storage.size() / m_slotBytes;
+        m_slots.reset(new Slot[m_slotCount]);
+        m_head.store(0, std::memory_order_relaxed);
+        m_oversize = 0;
+        return true;
+    }
+
+    int capacity() const { return int(m_slotCount); }
+    int frameBytes() const { return m_slotBytes; }
+
+    void setSeconds(int seconds) { m_seconds = qMax(1, seconds); }
+    int seconds() const { return m_seconds; }
+
+    // Written into the dump header (LidarConfig::toJson / hash).
+    void setConfig(const QJsonObject& config, quint32 configHash)
+    {
+        m_config = config;
+        m_configHash = configHash;
+    }
+
+    void setCompressed(bool compressed) { m_compressed = compressed; }
+
+    void setArmed(bool armed) { m_armed = armed; }
+    bool isArmed() const { return m_armed; }
+
+    // Acquisition thread only.
+    void push(const QByteArray& frame)
+    {
+        if (!m_armed || !m_slots) return;
+        if (frame.size() > m_slotBytes) {
+            ++m_oversize;
+            return;
+        }
+
+        quint64 n = m_head.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[n % m_slotCount];
+        slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        memcpy(m_storage.data() + (n % m_slotCount) * m_slotBytes, frame.constData(), frame.size());
+        slot.size.store(frame.size(), std::memory_order_relaxed);
+        slot.timeNs.store(m_clock.nsecsElapsed(), std::memory_order_relaxed);
+
+        slot.seq.store(2 * n + 2, std::memory_order_release);
+        m_head.store(n + 1, std::memory_order_release);
+    }
+
+    int oversizeFrames() const { return m_oversize; }
+    quint64 framesPushed() const { return m_head.load(std::memory_order_relaxed); }
+
+    // Starts a background dump of the last seconds(); false while a dump is running.
+    bool trigger(const QString& path, const QString& reason)
+    {
+        bool idle = false;
+        if (!m_slots || !m_dumping.compare_exchange_strong(idle, true)) return false;
+
+        Snapshot snap;
+        snap.head = m_head.load(std::memory_order_acquire);
+        snap.triggerNs = m_clock.nsecsElapsed();
+        snap.triggerEpochMs = QDateTime::currentMSecsSinceEpoch();
+        snap.config = m_config;
+        snap.configHash = m_configHash;
+        snap.compressed = m_compressed;
+        m_worker = QtConcurrent::run([this, path, reason, snap]() { dump(path, reason, snap); });
+        return true;
+    }
+
+    bool isDumping() const { return m_dumping.load(std::memory_order_acquire); }
+    void waitForDump() { m_worker.waitForFinished(); }
+
+signals:
+    // From the dump thread; frames < 0 when the file could not be written.
+    void dumpFinished(const QString& path, int frames, qint64 elapsedMs, const QString& reason);
+
+private:
+    struct Slot {
+        std::atomic<quint64> seq{ 0 };
+        std::atomic<int> size{ 0 };
+        std::atomic<qint64> timeNs{ 0 };
+    };
+
+    struct Snapshot {
+        quint64 head;
+        qint64 triggerNs;
+        qint64 triggerEpochMs;
+        QJsonObject config;
+        quint32 configHash;
+        bool compressed;
+    };
+
+    void dump(const QString& path, const QString& reason, const Snapshot& snap)
+    {
+        QElapsedTimer stopwatch;
+        stopwatch.start();
+
+        const qint64 windowStart = snap.triggerNs - (qint64)m_seconds * 1000000000LL;
+        quint64 first = snap.head > (quint64)m_slotCount ? snap.head - m_slotCount : 0;
+
+        CScanRecorder recorder;
+        recorder.setCompressed(snap.compressed);
+        QByteArray scratch(m_slotBytes, 0);
+        qint64 t0 = -1;
+        int frames = 0;
+        bool ok = true;
+
+        for (quint64 n = first; n < snap.head && ok; ++n) {
+            const Slot& slot = m_slots[n % m_slotCount];
+            if (slot.seq.load(std::memory_order_acquire) != 2 * n + 2) continue; // overwritten
+            int size = slot.size.load(std::memory_order_relaxed);
+            qint64 timeNs = slot.timeNs.load(std::memory_order_relaxed);
+            memcpy(scratch.data(), m_storage.constData() + (n % m_slotCount) * m_slotBytes, size);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != 2 * n + 2) continue;
+            if (timeNs < windowStart) continue;
+
+            if (t0 < 0) {
+                t0 = timeNs;
+                qint64 startEpochMs = snap.triggerEpochMs - (snap.triggerNs - t0) / 1000000;
+                ok = recorder.open(path, snap.config, snap.configHash, startEpochMs);
+                if (!ok) break;
+            }
+            ok = recorder.write(QByteArray::fromRawData(scratch.constData(), size), 0, snap.configHash, timeNs - t0);
+            if (ok) ++frames;
+        }
+        recorder.close();
+
+        m_dumping.store(false, std::memory_order_release);
+        emit dumpFinished(path, ok ? frames : -1, stopwatch.elapsed(), reason);
+    }
+
+    QByteArray m_storage;
+    std::unique_ptr<Slot[]> m_slots;
+    qint64 m_slotCount = 0;
+    int m_slotBytes = 0;
+    std::atomic<quint64> m_head{ 0 };
+    int m_oversize = 0;
+
+    int m_seconds = DEFAULT_SECONDS;
+    bool m_armed = false;
+    bool m_compressed = true;
+    QJsonObject m_config;
+    quint32 m_configHash = 0;
+
+    QElapsedTimer m_clock;
+    std::atomic<bool> m_dumping{ false };
+    QFuture<void> m_worker;
+};
+
+#endif // CBLACKBOX_H
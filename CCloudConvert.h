@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CCLOUDCONVERT_H
+#define CCLOUDCONVERT_H
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <memory>
+
+#include "CCloudPoints.h"
+#include "CLidarConfig.h"
+#include "CProtocol.h"
+#include "CScanRecord.h"
+#include "CPcapReader.h"
+
+/**
+ * @brief Recorded frames -> binary PLY / PCD point clouds (meters, z = 0).
+ *
+ * Same math as CCloudPoints::setPoint (polarToXY) with scale Rate * U2M, so
+ * files line up with the map. Points without a return (distance 0) are left out.
+ * Vertex: float x, y, z, uchar layer (1-based), little endian.
+ */
+class CCloudConverter
+{
+public:
+    enum class eFormat { ply, pcd };
+    enum { POINT_BYTES = 13 };
+
+    struct Params {
+        float scale;        // raw distance -> meter
+        float angleOffset;
+        bool isClockwise;
+        int channels;
+        eFormat format;
+    };
+
+    static Params params(const LidarConfig& cfg, eFormat format)
+    {
+        Params p = { cfg.distanceRate * cfg.unitToMeter(), cfg.angleOffset, cfg.isClockwise, cfg.channels, format };
+        return p;
+    }
+
+    static QString suffix(eFormat format) { return format == eFormat::pcd ? "pcd" : "ply"; }
+
+    // Frames as received (before unpack) -> one file.
+    static QByteArray convert(const QVector<QByteArray>& frames, const Params& p)
+    {
+        QByteArray points;
+        QByteArray payload;
+        int count = 0;
+        for (const QByteArray& frame : frames) {
+            if (!Protocol::unpack(frame, nullptr, nullptr, nullptr, nullptr, &payload, nullptr)) continue;
+            count += appendPoints(payload, p, points);
+        }
+        QByteArray file = header(p.format, count);
+        file.append(points);
+        return file;
+    }
+
+private:
+    static int appendPoints(const QByteArray& payload, const Params& p, QByteArray& out)
+    {
+        const int packetSize = 2 + p.channels * 2;
+        const int packets = payload.size() / packetSize;
+        const quint8* d = (const quint8*)payload.constData();
+
+        int start = out.size();
+        out.resize(start + packets * p.channels * POINT_BYTES);
+        uchar* o = (uchar*)out.data() + start;
+
+        int count = 0;
+        for (int i = 0; i < packets; ++i, d += packetSize) {
+            quint16 angle = (quint16)((d[0] << 8) | d[1]);
+            for (int j = 0; j < p.channels; ++j) {
+                quint16 dist = (quint16)((d[2 + j * 2] << 8) | d[3 + j * 2]);
+                if (dist == 0) continue;
+
+                float xy[3] = { 0.0f, 0.0f, 0.0f };
+                polarToXY(angle, dist, p.scale, p.angleOffset, p.isClockwise, &xy[0], &xy[1]);
+                for (int k = 0; k < 3; ++k) {
+                    quint32 bits;
+                    memcpy(&bits, &xy[k], 4);
+                    qToLittleEndian<quint32>(bits, o + k * 4);
+                }
+                o[12] = (uchar)(j + 1);
+                o += POINT_BYTES;
+                ++count;
+            }
+        }
+        out.resize(start + count * POINT_BYTES);
+        return count;
+    }
+
+    static QByteArray header(eFormat format, int count)
+    {
+        if (format == eFormat::pcd) {
+            return QString("# .PCD v0.7 - LumoMap\nVERSION 0.7\nFIELDS x y z layer\nSIZE 4 4 4 1\nTYPE F F F U\n"
+                "COUNT 1 1 1 1\nWIDTH %1\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS %1\nDATA binary\n")
+                .arg(count).toLatin1();
+        }
+        return QString("ply\nformat binary_little_endian 1.0\ncomment LumoMap\nelement vertex %1\n"
+            "property float x\nproperty float y\nproperty float z\nproperty uchar layer\nend_header\n")
+            .arg(count).toLatin1();
+    }
+};
+
+/**
+ * @brief Batch conversion of a recording or capture:
+ *
+ *   LumoMap --convert --input FILE [--out DIR] [--format ply|pcd] [--window MS]
+ *           [--threads N[,N...]] [--profile N] [--port P]
+ *
+ * Frames are read on the main thread and converted on a thread pool; files are
+ * written in order from a FIFO of at most 2 x threads pending jobs.
+ */
+class CCloudConvertCli
+{
+public:
+    static bool isRequested(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i) {
+            if (QByteArray(argv[i]) == "--convert") return true;
+        }
+        return false;
+    }
+
+    static int run(const QStringList& arguments)
+    {
+        QTextStream out(stdout);
+
+        QCommandLineParser parser;
+        parser.setApplicationDescription("LumoMap point cloud converter");
+        parser.addHelpOption();
+        parser.addOptions({
+            { "convert", "Convert a recording (.lrec) or capture (.pcap/.pcapng)." },
+            { "input", "Recording or capture.", "path" },
+            { "out", "Output directory (default: <input>_cloud).", "dir" },
+            { "format", "ply or pcd.", "format", "ply" },
+            { "window", "Milliseconds per file; 0 = one file per scan.", "ms", "0" },
+            { "threads", "Worker threads; a list (1,4,16) runs each and reports scans/s.", "count",
+              QString::number(QThread::idealThreadCount()) },
+            { "config", "LiDAR profile file.", "path", "config.json" },
+            { "profile", "Profile index when the input has none (captures).", "index", "1" },
+            { "port", "Sensor UDP port in a capture.", "port", QString::number(CPcapReader::DEFAULT_PORT) },
+        });
+        parser.process(arguments);
+
+        const QString input = parser.value("input");
+        QJsonArray types = LidarConfig::loadTypes(parser.value("config"));
+        if (types.isEmpty()) types = LidarConfig::defaultTypes();
+        int index = qBound(0, parser.value("profile").toInt(), types.count() - 1);
+        LidarConfig cfg = LidarConfig::fromJson(types[index].toObject());
+
+        std::unique_ptr<IFrameSource> source;
+        if (CPcapReader::isCapture(input)) source.reset(new CPcapReader((quint16)parser.value("port").toUInt(), cfg.reqWordSize() * 2 + 11));
+        else source.reset(new CScanReader);
+        if (input.isEmpty() || !source->open(input)) {
+            out << "Couldn't open " << input << Qt::endl;
+            return 1;
+        }
+        if (!source->config().isEmpty()) cfg = LidarConfig::fromJson(source->config());
+
+        CCloudConverter::eFormat format = (parser.value("format") == "pcd")
+            ? CCloudConverter::eFormat::pcd : CCloudConverter::eFormat::ply;
+        QString outDir = parser.isSet("out") ? parser.value("out")
+            : QFileInfo(input).absolutePath() + "/" + QFileInfo(input).completeBaseName() + "_cloud";
+        if (!QDir().mkpath(outDir)) {
+            out << "Couldn't create " << outDir << Qt::endl;
+            return 1;
+        }
+
+        QVector<QPair<int, int>> jobs = groupFrames(*source, cfg.reqWordSize() * 2,
+            (quint64)qMax(0, parser.value("window").toInt()) * 1000000ULL);
+
+        const CCloudConverter::Params params = CCloudConverter::params(cfg, format);
+        for (const QString& t : parser.value("threads").split(',', Qt::SkipEmptyParts)) {
+            int threads = qMax(1, t.toInt());
+            int scans = 0;
+            QElapsedTimer stopwatch;
+            stopwatch.start();
+            if (!convertAll(*source, jobs, cfg.reqWordSize() * 2, params, threads, outDir, &scans)) {
+                out << "Couldn't write to " << outDir << Qt::endl;
+                return 1;
+            }
+            double sec = qMax<qint64>(1, stopwatch.nsecsElapsed()) / 1e9;
+            out << QString("%1 threads: %2 scans -> %3 %4 files in %5 s, %6 scans/s")
+                .arg(threads).arg(scans).arg(jobs.size()).arg(CCloudConverter::suffix(format))
+                .arg(sec, 0, 'f', 3).arg(scans / sec, 0, 'f', 0) << Qt::endl;
+        }
+        out << "'" << cfg.name << "' -> " << outDir << Qt::endl;
+        return 0;
+    }
+
+private:
+    // [first, last] frame per output file; frames shorter than a scan (parameter replies) are skipped.
+    static QVector<QPair<int, int>> groupFrames(const IFrameSource& source, int minBytes, quint64 windowNs)
+    {
+        QVector<QPair<int, int>> jobs;
+        quint64 windowEnd = 0;
+        for (int i = 0; i < source.frameCount(); ++i) {
+            if (source.frameSize(i) < minBytes) continue;
+            quint64 t = source.frameTimeNs(i);
+            if (windowNs == 0 || jobs.isEmpty() || t >= windowEnd) {
+                jobs.append(qMakePair(i, i));
+                windowEnd = windowNs ? (t / windowNs + 1) * windowNs : 0;
+            }
+            else {
+                jobs.last().second = i;
+            }
+        }
+        return jobs;
+    }
+
+    static bool convertAll(const IFrameSource& source, const QVector<QPair<int, int>>& jobs, int minBytes,
+        const CCloudConverter::Params& params, int threads, const QString& outDir, int* scans)
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads);
+        QVector<QFuture<QByteArray>> pending;
+        const int maxPending = threads * 2;
+        int written = 0;
+        bool ok = true;
+
+        auto writeNext = [&]() {
+            QFile file(QString("%1/%2.%3").arg(outDir).arg(written, 6, 10, QChar('0'))
+                .arg(CCloudConverter::suffix(params.format)));
+            QByteArray bytes = pending.first().result();
+            ok &= file.open(QIODevice::WriteOnly) && file.write(bytes) == bytes.size();
+            pending.removeFirst();
+            ++written;
+        };
+
+        IFrameSource::Frame frame;
+        for (const QPair<int, int>& job : jobs) {
+            QVector<QByteArray> frames;
+            for (int i = job.first; i <= job.second; ++i) {
+                if (source.frameSize(i) < minBytes || !source.frame(i, &frame)) continue;
+                frames.append(frame.data);
+                ++*scans;
+            }
+            pending.append(QtConcurrent::run(&pool, [frames, params]() {
+                return CCloudConverter::convert(frames, params);
+                }));
+            if (pending.size() >= maxPending) writeNext();
+        }
+        while (!pending.isEmpty()) writeNext();
+        return ok;
+    }
+};
+
+#endif // CCLOUDCONVERT_H
@@ -28,6 +28,8 @@
 #include <QtMath>
 #include <QDataStream> 
 
+#include "CScanIndex.h"
+
 class ICloudPointGetter {
 public:
     virtual ~ICloudPointGetter() {}
@@ -36,6 +38,71 @@ public:
 };
 Q_DECLARE_INTERFACE(ICloudPointGetter, "com.LumosLiDAR.ICloudPointGetter/1.0")
 
+/**
+ * @brief 극좌표 -> 직교좌표 (setPoint, CCloudConverter 공용)
+ *  angle: 0.01 deg, scale: Rate * U2M (* PPM 이면 pixel 단위), Y축 반전
+ */
+inline void polarToXY(quint16 angle, quint16 distance, float scale, float angleOffset, bool isClockwise,
+    float* x, float* y)
+{
+    while (angle > 36000) {
+        angle -= 36000;
+    }
+
+    float fAngle = (float)angle / 100;
+    float fDist = (float)distance * scale;
+
+    // 각도 보정
+    if (isClockwise) fAngle = -fAngle;
+
+    fAngle += angleOffset;
+
+    float radian = fAngle * M_PI / 180.0;
+
+    *x = fDist * std::cos(radian);
+    *y = -fDist * std::sin(radian); // Y축 반전
+}
+
+/**
+ * @brief getBulk 페이로드 decode: [Angle(2) + Channels * Dist(2)] * N, Big Endian
+ */
+inline void decodeScanPayload(const QByteArray& payload, int numChannels, ICloudPointGetter* processor)
+{
+    if (!processor) return;
+
+    processor->clearPoints();
+
+    // 패킷 크기: Angle(2) + (Channels * Dist(2))
+    int packetSize = 2 + (numChannels * 2);
+
+    int cnt = payload.count() / packetSize;
+    if (cnt <= 0) return;
+
+    quint16 wdAngle, wdDist;
+
+    const quint8* dataPtr = (const quint8*)payload.constData();
+
+    for (int i = 0; i < cnt; i++) {
+        int offset = i * packetSize;
+
+        // Big Endian (MSB first)
+        quint8 angleHi = dataPtr[offset];
+        quint8 angleLo = dataPtr[offset + 1];
+        wdAngle = (quint16)((angleHi << 8) | angleLo);
+
+        for (int j = 0; j < numChannels; j++) {
+            int distOffset = offset + 2 + (j * 2);
+
+            // Distance (2 bytes) - Big Endian
+            quint8 distHi = dataPtr[distOffset];
+            quint8 distLo = dataPtr[distOffset + 1];
+            wdDist = (quint16)((distHi << 8) | distLo);
+
+            processor->setPoint(wdAngle, wdDist, j);
+        }
+    }
+}
+
 class CCloudPoints : public QObject, public ICloudPointGetter {
     Q_OBJECT
     Q_INTERFACES(ICloudPointGetter)
@@ -51,7 +118,6 @@ public:
 
         m_angleOffset = 0.0f;
         m_isClockwise = true;
-        m_virtualShapeType = 0;
     }
 
     QVector<QPointF> getPoints() const {
@@ -62,6 +128,15 @@ public:
         return m_unitToMeter * m_pixelsPerMeter;
     }
 
+    // 현재 scan의 공간 인덱스 (row = decode 순서 = Point Viewer 행)
+    const CScanIndex& getIndex() const {
+        return m_index;
+    }
+
+    void buildIndex() {
+        m_index.build();
+    }
+
     void setPoints(QVector<QPointF> points) {
         m_points.append(points);
         // (MaxPoints 로직 유지)
@@ -88,69 +163,25 @@ public:
     // ICloudPointGetter 구현
     void clearPoints() override {
         m_points.clear();
+        m_index.clear();
     }
 
     void setPoint(quint16 angle, quint16 distance, int layerNo) override {
-        Q_UNUSED(layerNo);
-        while (angle > 36000) {
-            angle -= 36000;
-        }
-
-        float fAngle = (float)angle / 100;
-
         // Raw * Rate * U2M * PPM
-        float fPixelDist = (float)distance * m_finalScale;
-
-        // 각도 보정
-        if (m_isClockwise) fAngle = -fAngle;
-        
-        fAngle += m_angleOffset;
-
-        float radian = fAngle * M_PI / 180.0;
-
-        float x = fPixelDist * std::cos(radian);
-        float y = -fPixelDist * std::sin(radian); // Y축 반전
+        float x, y;
+        polarToXY(angle, distance, m_finalScale, m_angleOffset, m_isClockwise, &x, &y);
 
         m_points.append(QPointF(x, y));
+        m_index.append(x, y, angle, distance, layerNo);
     }
 
     //int getPointCount() const {
     //    return m_points.size();
     //}
 
-    /**
-     * @brief 가상 데이터 생성 (Raw 데이터 생성)
-     */
-    QByteArray generateVirtualPayload(int channels, float resolution, int mesuresPerScan) {
-
-        QByteArray payload;
-        QDataStream out(&payload, QIODevice::WriteOnly);
-        out.setByteOrder(QDataStream::BigEndian);
-
-        quint16 _resolution = quint16(resolution * 100), angle = 0, distUnit = 3000;
-
-        for (int i = 0; i < mesuresPerScan; ++i) {
-            switch (m_virtualShapeType) {
-            case 0: distUnit = 30000 + ((i % 50) * 100); break;
-            case 1: distUnit = 25000; break;
-            case 2: distUnit = i * 50; break;
-            case 3: distUnit = 0; break;
-            }
-
-            out << angle;
-            for (int j = 0; j < channels; j++) {
-                out << distUnit;
-                distUnit += (distUnit * 0.02);
-            }
-            angle += _resolution;
-        }
-
-        m_virtualShapeType = (m_virtualShapeType + 1) % 4;
-        return payload;
-    }
-
 private:
     QVector<QPointF> m_points;
+    CScanIndex m_index;
     QTimer timer;
     int m_maxPoints = 2400;
 
@@ -159,7 +190,6 @@ private:
 
     float m_angleOffset;
     bool m_isClockwise;
-    int m_virtualShapeType;
 
     // [신규]
     float m_distanceRate;
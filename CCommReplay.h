@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CCOMMREPLAY_H
+#define CCOMMREPLAY_H
+
+#include <functional>
+#include <memory>
+
+#include "CComm.h"
+#include "CScanRecord.h"
+#include "CPcapReader.h"
+
+//*===============================================================*//
+//*                  Device-less Comm Classes                     *//
+//*===============================================================*//
+
+// CommVirtual class: every request is answered with a generated frame,
+//  at most frameRate frames per second (0 = as fast as requested).
+class CommVirtual : public Comm {
+    Q_OBJECT
+
+public:
+    CommVirtual(QObject *parent = nullptr, int commID = 0)
+        : Comm(parent, commID) {}
+
+    // Returns one complete frame (as the device would send it) per request.
+    void setGenerator(std::function<QByteArray()> generator) {
+        m_generator = generator;
+    }
+
+    void setFrameRate(double hz) {
+        m_periodNs = hz > 0 ? qint64(1e9 / hz) : 0;
+        m_dueNs = 0;
+        m_clock.start();
+    }
+
+protected:
+    bool setConnInfoProc(QString connString, int connNum, void* connInfo) override {
+        Q_UNUSED(connString); Q_UNUSED(connNum); Q_UNUSED(connInfo);
+        return true;
+    }
+
+    bool connectProc(quint32 timeout = INFINITE) override {
+        Q_UNUSED(timeout);
+        m_open = true;
+        m_dueNs = 0;
+        m_clock.start();
+        return true;
+    }
+
+    bool closeProc(quint32 timeout = INFINITE) const override {
+        Q_UNUSED(timeout);
+        m_open = false;
+        return true;
+    }
+
+    bool sendProc(QByteArray &data, quint32 timeout = INFINITE) override {
+        Q_UNUSED(timeout);
+        m_bytesSent = data.size();
+        m_frame = m_generator ? m_generator() : QByteArray();
+        return true;
+    }
+
+    bool inboxProc(quint32 timeout = IGNORE) override {
+        m_bytesInbox = 0;
+        if (m_frame.isEmpty() || !waitDue(timeout)) return false;
+        m_bytesInbox = m_frame.size();
+        return true;
+    }
+
+    bool recvProc(QByteArray &buffer, quint32 timeout = INFINITE,
+                  quint32 expectedBytes = IGNORE) override {
+        Q_UNUSED(expectedBytes);
+        if (!m_frame.isEmpty() && !waitDue(timeout)) return false;
+        buffer += m_frame;
+        m_frame.clear();
+        if (m_periodNs > 0) {
+            // next frame one period later; a late caller restarts from now instead of bursting
+            qint64 now = m_clock.nsecsElapsed();
+            m_dueNs = qMax(m_dueNs + m_periodNs, now);
+        }
+        m_bytesRecv = buffer.size();
+        return (bool)m_bytesRecv;
+    }
+
+    bool checkConnProc() override {
+        return m_open;
+    }
+
+private:
+    // Wait (processing events) until the next frame is due, at most `timeout` ms.
+    bool waitDue(quint32 timeout) {
+        if (m_periodNs <= 0) return true;
+        qint64 remainMs = (m_dueNs - m_clock.nsecsElapsed()) / 1000000;
+        if (remainMs <= 0) return true;
+        if (timeout != INFINITE && remainMs > (qint64)timeout) {
+            doEvents((int)timeout);
+            return false;
+        }
+        doEvents((int)remainMs);
+        return true;
+    }
+
+    std::function<QByteArray()> m_generator;
+    QByteArray m_frame;
+    mutable bool m_open = false;
+    qint64 m_periodNs = 0;
+    qint64 m_dueNs = 0;
+    QElapsedTimer m_clock;
+};
+
+// CommReplay class: answers requests with the frames of a .lrec recording or
+//  of a pcap/pcapng capture (UDP from the sensor port, connNum; 47777 if 0).
+//  connString = recording path. speed 0 = as fast as possible (no pacing),
+//  otherwise frames are released at their recorded time / speed; when the
+//  caller falls behind, frames that are already overdue are skipped.
+class CommReplay : public Comm {
+    Q_OBJECT
+
+public:
+    CommReplay(QObject *parent = nullptr, int commID = 0)
+        : Comm(parent, commID) {}
+
+    void setSpeed(double speed) {
+        m_speed = qMax(0.0, speed);
+        rebase();
+    }
+
+    double speed() const { return m_speed; }
+
+    // Recorded frames shorter than this (e.g. replies to getParam) are skipped.
+    void setMinFrameSize(int bytes) { m_minFrameSize = bytes; }
+
+    // Captures only: datagrams are joined until a frame has this many bytes (as CommUDP expectedBytes).
+    void setFrameBytes(int bytes) { m_frameBytes = bytes; }
+
+    bool isCapture() const { return CPcapReader::isCapture(m_path); }
+    int frameCount() const { return m_source ? m_source->frameCount() : 0; }
+    int position() const { return m_pos; }
+    quint64 frameTimeNs(int index) const {
+        return (index >= 0 && index < frameCount()) ? m_source->frameTimeNs(index) : 0;
+    }
+    quint64 durationNs() const { return m_source ? m_source->durationNs() : 0; }
+    QJsonObject recordedConfig() const { return m_source ? m_source->config() : QJsonObject(); }
+    quint32 recordedConfigHash() const { return m_source ? m_source->configHash() : 0; }
+
+    void seek(int index) {
+        m_pos = qBound(0, index, qMax(0, frameCount() - 1));
+        m_pending = -1;
+        m_finished = false;
+        rebase();
+    }
+
+signals:
+    void framePlayed(int index, int count);
+    void finished();
+
+protected:
+    bool setConnInfoProc(QString connString, int connNum, void* connInfo) override {
+        Q_UNUSED(connInfo);
+        m_path = connString;
+        m_port = (connNum > 0 && connNum <= 65535) ? (quint16)connNum : (quint16)CPcapReader::DEFAULT_PORT;
+        return QFile::exists(m_path);
+    }
+
+    bool connectProc(quint32 timeout = INFINITE) override {
+        Q_UNUSED(timeout);
+        if (isCapture())
+            m_source.reset(new CPcapReader(m_port, m_frameBytes));
+        else
+            m_source.reset(new CScanReader);
+
+        if (!m_source->open(m_path)) {
+            m_source.reset();
+            setAlert(this, 0, "Couldn't open recording " + m_path);
+            return false;
+        }
+        if (m_source->frameCount() == 0)
+            setAlert(this, 0, QString("No frames from port %1 in %2").arg(m_port).arg(m_path));
+        seek(0);
+        return true;
+    }
+
+    bool closeProc(quint32 timeout = INFINITE) const override {
+        Q_UNUSED(timeout);
+        if (m_source) m_source->close();
+        return true;
+    }
+
+    bool sendProc(QByteArray &data, quint32 timeout = INFINITE) override {
+        Q_UNUSED(timeout);
+        m_bytesSent = data.size();
+        if (m_pending < 0) m_pending = nextFrame();
+        return true;
+    }
+
+    bool inboxProc(quint32 timeout = IGNORE) override {
+        m_bytesInbox = 0;
+        if (m_pending < 0 || !waitDue(timeout)) return false;
+
+        m_bytesInbox = m_source->frameSize(m_pending);
+        return true;
+    }
+
+    bool recvProc(QByteArray &buffer, quint32 timeout = INFINITE,
+                  quint32 expectedBytes = IGNORE) override {
+        Q_UNUSED(expectedBytes);
+        if (m_pending < 0) {
+            if (!m_finished) {
+                m_finished = true;
+                emit finished();
+            }
+            return false;
+        }
+        if (!waitDue(timeout)) return false;
+
+        // an unreadable frame is skipped, not answered with a stale or empty buffer
+        IFrameSource::Frame frame;
+        const bool ok = m_source->frame(m_pending, &frame);
+        if (ok) buffer.append(frame.data.constData(), frame.data.size());
+
+        m_pos = m_pending + 1;
+        emit framePlayed(m_pending, frameCount());
+        m_pending = -1;
+        m_bytesRecv = ok ? buffer.size() : 0;
+        return ok && m_bytesRecv > 0;
+    }
+
+    bool checkConnProc() override {
+        return m_source && m_source->isOpen();
+    }
+
+private:
+    int nextFrame() const {
+        const int count = frameCount();
+        int i = m_pos;
+        if (m_speed > 0 && i < count) {
+            // last frame whose time has already passed
+            quint64 now = m_baseNs + (quint64)(m_clock.nsecsElapsed() * m_speed);
+            int due = m_source->seek(now);
+            if (m_source->frameTimeNs(due) > now) --due;
+            i = qMax(i, due);
+        }
+        while (i < count && m_source->frameSize(i) < m_minFrameSize) ++i;
+        return i < count ? i : -1;
+    }
+
+    // Wait (processing events) until the pending frame is due, at most `timeout` ms.
+    bool waitDue(quint32 timeout) {
+        if (m_speed <= 0) return true;
+
+        // signed: a frame stamped before the base (out-of-order capture) is due now
+        const qint64 sinceBaseNs = (qint64)m_source->frameTimeNs(m_pending) - (qint64)m_baseNs;
+        const qint64 dueNs = qMax<qint64>(0, (qint64)(sinceBaseNs / m_speed));
+        qint64 remainMs = (dueNs - m_clock.nsecsElapsed()) / 1000000;
+        if (remainMs <= 0) return true;
+        if (timeout != INFINITE && remainMs > (qint64)timeout) {
+            doEvents((int)timeout);
+            return false;
+        }
+        doEvents((int)remainMs);
+        return true;
+    }
+
+    void rebase() {
+        m_baseNs = frameTimeNs(m_pos);
+        m_clock.start();
+    }
+
+    std::unique_ptr<IFrameSource> m_source;
+    QString m_path;
+    quint16 m_port = CPcapReader::DEFAULT_PORT;
+    int m_frameBytes = 0;
+    double m_speed = 1.0;
+    int m_minFrameSize = 0;
+    int m_pos = 0;
+    int m_pending = -1;
+    bool m_finished = false;
+    quint64 m_baseNs = 0;
+    QElapsedTimer m_clock;
+};
+
+#endif // CCOMMREPLAY_H
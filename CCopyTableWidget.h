@@ -1,50 +1,106 @@
-#include <QTableWidget>
+#include <QTableView>
 #include <QKeyEvent>
 #include <QApplication>
 #include <QClipboard>
 #include <QItemSelectionRange>
+#include <QMenu>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QFile>
 
-class CCopyTableWidget : public QTableWidget
+#include "CPointExport.h"
+
+// Point Viewer 테이블 (model/view). Ctrl+C 로 선택 영역을 TSV 로 복사.
+// CPointTableModel 이면 셀 텍스트 대신 raw 데이터에서 바로 스트리밍 (CSV/TSV/binary, 클립보드/파일).
+class CCopyTableWidget : public QTableView
 {
     Q_OBJECT
 public:
-    CCopyTableWidget(QWidget* parent = nullptr) : QTableWidget(parent) {}
+    CCopyTableWidget(QWidget* parent = nullptr) : QTableView(parent) {}
+
+    void copySelection(CPointExporter::eFormat format)
+    {
+        const CPointTableModel* points = qobject_cast<const CPointTableModel*>(model());
+        if (!points || !selectionModel()) return;
+
+        CPointExporter::RowRanges ranges = CPointExporter::rowRanges(selectionModel()->selection());
+        if (ranges.isEmpty()) return;
+        QApplication::clipboard()->setText(CPointExporter::toText(*points, ranges, format));
+    }
+
+    // Format from the file extension: .csv, .bin, anything else TSV.
+    bool exportSelection(const QString& path)
+    {
+        const CPointTableModel* points = qobject_cast<const CPointTableModel*>(model());
+        if (!points || !selectionModel()) return false;
+
+        CPointExporter::eFormat format = CPointExporter::eFormat::tsv;
+        if (path.endsWith(".csv", Qt::CaseInsensitive)) format = CPointExporter::eFormat::csv;
+        else if (path.endsWith(".bin", Qt::CaseInsensitive)) format = CPointExporter::eFormat::binary;
+
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) return false;
+        return CPointExporter::write(*points, CPointExporter::rowRanges(selectionModel()->selection()),
+            format, &file) >= 0;
+    }
 
 protected:
+    void contextMenuEvent(QContextMenuEvent* event) override
+    {
+        if (!qobject_cast<const CPointTableModel*>(model())) return;
+
+        QMenu menu(this);
+        QAction* copyCsv = menu.addAction("Copy as CSV");
+        QAction* copyTsv = menu.addAction("Copy as TSV");
+        menu.addSeparator();
+        QAction* saveAs = menu.addAction("Export Selection...");
+
+        QAction* chosen = menu.exec(event->globalPos());
+        if (chosen == copyCsv) copySelection(CPointExporter::eFormat::csv);
+        else if (chosen == copyTsv) copySelection(CPointExporter::eFormat::tsv);
+        else if (chosen == saveAs) {
+            QString path = QFileDialog::getSaveFileName(this, "Export Selection", "points.csv",
+                "CSV (*.csv);;TSV (*.tsv);;Binary (*.bin)");
+            if (!path.isEmpty() && !exportSelection(path))
+                QMessageBox::warning(this, "Export Selection", "Couldn't write " + path);
+        }
+    }
+
     void keyPressEvent(QKeyEvent* event) override
     {
         if (event->matches(QKeySequence::Copy)) {
             copySelectionToClipboard();
         }
         else {
-            QTableWidget::keyPressEvent(event);
+            QTableView::keyPressEvent(event);
         }
     }
 
 private:
     void copySelectionToClipboard()
     {
+        if (!model() || !selectionModel()) return;
+        if (qobject_cast<const CPointTableModel*>(model())) {
+            copySelection(CPointExporter::eFormat::tsv);
+            return;
+        }
+
         QString textData;
-        QList<QTableWidgetSelectionRange> ranges = selectedRanges();
+        QItemSelection ranges = selectionModel()->selection();
         if (ranges.isEmpty()) return;
 
         for (int i = 0; i < ranges.count(); ++i) {
-            const QTableWidgetSelectionRange& range = ranges.at(i);
-            for (int row = range.topRow(); row <= range.bottomRow(); ++row)
+            const QItemSelectionRange& range = ranges.at(i);
+            for (int row = range.top(); row <= range.bottom(); ++row)
             {
-                for (int col = range.leftColumn(); col <= range.rightColumn(); ++col)
+                for (int col = range.left(); col <= range.right(); ++col)
                 {
-                    QTableWidgetItem* item = this->item(row, col);
-                    if (item) {
-                        textData += item->text();
-                    }
-                    if (col < range.rightColumn()) {
+                    textData += model()->data(model()->index(row, col)).toString();
+                    if (col < range.right()) {
                         textData += "\t";
                     }
                 }
-                if (row <= range.bottomRow()) {
-                    textData += "\n";
-                }
+                textData += "\n";
             }
         }
         QApplication::clipboard()->setText(textData);
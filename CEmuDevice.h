@@ -0,0 +1,542 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CEMUDEVICE_H
+#define CEMUDEVICE_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QNetworkDatagram>
+#include <QSocketNotifier>
+#include <QPointer>
+#include <QTimer>
+#include <QHash>
+#include <QElapsedTimer>
+#include <deque>
+#include <memory>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <stdlib.h>
+#endif
+
+#include "CProtocol.h"
+#include "CLidarConfig.h"
+#include "CSynthScene.h"
+#include "CScanRecord.h"
+#include "CPcapReader.h"
+
+/**
+ * @brief Scan payloads for emulated devices, shared by every device of a profile.
+ *
+ * Time is cut into slots of 1/rate s on one clock; a slot's payload is made
+ * once (ray-cast or read from the recording) however many devices serve it,
+ * so hundreds of sensors cost one generator.
+ */
+class CEmuScanSource
+{
+public:
+    CEmuScanSource() { m_clock.start(); }
+
+    void openSynth(const LidarConfig& cfg, const QJsonObject& scene)
+    {
+        m_reqWords = cfg.reqWordSize();
+        m_synth.setScene(scene);
+        m_synth.setProfile(cfg.channels, cfg.resolution, cfg.mesuresPerScan, cfg.distanceRate * cfg.unitToMeter());
+        m_rate = m_synth.rate();
+        m_recording.reset();
+        m_payload = QByteArray(m_reqWords * 2, 0);
+        m_slot = -1;
+    }
+
+    // Recording (.lrec) or capture (.pcap/.pcapng); frames shorter than a scan are skipped.
+    bool openRecording(const QString& path, const LidarConfig& cfg, quint16 port)
+    {
+        m_reqWords = cfg.reqWordSize();
+        if (CPcapReader::isCapture(path)) m_recording.reset(new CPcapReader(port, m_reqWords * 2 + 11));
+        else m_recording.reset(new CScanReader);
+        if (!m_recording->open(path)) {
+            m_recording.reset();
+            return false;
+        }
+
+        m_scans.clear();
+        for (int i = 0; i < m_recording->frameCount(); ++i) {
+            if (m_recording->frameSize(i) >= m_reqWords * 2) m_scans.append(i);
+        }
+        if (m_scans.isEmpty()) {
+            m_recording.reset();
+            return false;
+        }
+        quint64 span = m_recording->frameTimeNs(m_scans.last()) - m_recording->frameTimeNs(m_scans.first());
+        m_rate = (m_scans.size() > 1 && span) ? (m_scans.size() - 1) * 1e9 / span : 10.0;
+        m_payload = QByteArray(m_reqWords * 2, 0);
+        m_slot = -1;
+        return true;
+    }
+
+    int reqWordSize() const { return m_reqWords; }
+    double rate() const { return m_rate; }
+    void setRate(double hz)
+    {
+        m_rate = qMax(1.0, hz);
+        m_synth.setRate(m_rate);
+    }
+
+    qint64 nowNs() const { return m_clock.nsecsElapsed(); }
+    qint64 slotAt(qint64 ns) const { return qint64(ns * m_rate / 1e9); }
+    qint64 slotStartNs(qint64 slot) const { return qint64(std::ceil(slot * 1e9 / m_rate)); }
+
+    // Payload of the current slot (reqWordSize() words, big endian as on the wire).
+    const QByteArray& payload()
+    {
+        qint64 slot = slotAt(nowNs());
+        if (slot == m_slot) return m_payload;
+        m_slot = slot;
+
+        if (!m_recording) {
+            m_synth.generate((uchar*)m_payload.data());
+            return m_payload;
+        }
+        IFrameSource::Frame frame;
+        QByteArray scan;
+        if (m_recording->frame(m_scans[int(slot % m_scans.size())], &frame)
+            && Protocol::unpack(frame.data, nullptr, nullptr, nullptr, nullptr, &scan, nullptr)) {
+            memcpy(m_payload.data(), scan.constData(), qMin(scan.size(), m_payload.size()));
+        }
+        return m_payload;
+    }
+
+private:
+    CSynthScene m_synth;
+    std::unique_ptr<IFrameSource> m_recording;
+    QVector<int> m_scans;
+    int m_reqWords = 0;
+    double m_rate = 20;
+    QElapsedTimer m_clock;
+    qint64 m_slot = -1;
+    QByteArray m_payload;
+};
+
+/**
+ * @brief One emulated sensor on TCP, UDP or a pseudo-terminal (CommSerial).
+ *
+ * Requests as packed by Protocol (wCnt in words, setParam included):
+ *   A1 'V' -> A1 'V' <version> CR        A1 'S'/'Q'/'A'..'D' -> echoed (ack)
+ *   getParam -> AA 00 'M' 'B' len dType sAddr wCnt <words> crc CR
+ *   setParam -> stored; AA 00 'A' 'E' 0007 dType sAddr wCnt crc CR
+ *   getBulk  -> setBulk with wCnt words of the current scan
+ * A stopped device ('Q') does not answer getBulk. A client polling faster than
+ * the scan rate is answered when the next scan is ready, as the device would.
+ *
+ * Replies go through an impairment stage: fixed latency, uniform jitter, loss
+ * (per datagram on UDP, per reply otherwise) and a bandwidth limit (serialized
+ * link). Replies stay in order.
+ */
+class CEmuDevice : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class eTransport { tcp, udp, pty };
+    enum { DEFAULT_DATAGRAM_BYTES = 1472 };
+
+    struct Impairment {
+        int latencyMs = 0;
+        int jitterMs = 0;
+        double loss = 0.0;      // 0..1
+        qint64 bandwidth = 0;   // bytes/s, 0 = unlimited
+    };
+
+    struct Stats {
+        quint64 requests = 0;
+        quint64 replies = 0;
+        quint64 dropped = 0;
+        quint64 badRequests = 0;
+        quint64 bytesOut = 0;
+    };
+
+    CEmuDevice(int id, CEmuScanSource* source, QObject* parent = nullptr)
+        : QObject(parent), m_id(id), m_source(source), m_timer(this), m_seed(0x9E3779B9u ^ quint32(id * 2654435761u))
+    {
+        if (!m_seed) m_seed = 1;
+        m_timer.setSingleShot(true);
+        m_timer.setTimerType(Qt::PreciseTimer);
+        connect(&m_timer, &QTimer::timeout, this, &CEmuDevice::flush);
+    }
+
+    ~CEmuDevice()
+    {
+#ifdef Q_OS_UNIX
+        if (m_ptyMaster >= 0) ::close(m_ptyMaster);
+        if (m_ptySlave >= 0) ::close(m_ptySlave);
+#endif
+    }
+
+    void setImpairment(const Impairment& imp) { m_imp = imp; }
+    void setDatagramBytes(int bytes) { m_datagramBytes = qMax(64, bytes); }
+    void setVersion(const QByteArray& version) { m_version = version; }
+
+    bool listen(eTransport transport, const QHostAddress& address, quint16 port)
+    {
+        m_transport = transport;
+        switch (transport) {
+        case eTransport::tcp:
+            m_tcp = new QTcpServer(this);
+            connect(m_tcp, &QTcpServer::newConnection, this, &CEmuDevice::onNewConnection);
+            if (!m_tcp->listen(address, port)) return fail(m_tcp->errorString());
+            m_endpoint = QString("%1:%2").arg(address.toString()).arg(m_tcp->serverPort());
+            return true;
+        case eTransport::udp:
+            m_udp = new QUdpSocket(this);
+            connect(m_udp, &QUdpSocket::readyRead, this, &CEmuDevice::onDatagrams);
+            if (!m_udp->bind(address, port)) return fail(m_udp->errorString());
+            m_endpoint = QString("%1:%2").arg(address.toString()).arg(m_udp->localPort());
+            return true;
+        case eTransport::pty:
+            return openPty();
+        }
+        return false;
+    }
+
+    int id() const { return m_id; }
+    QString endpoint() const { return m_endpoint; }   // host:port or the pty slave path
+    quint16 port() const { return m_tcp ? m_tcp->serverPort() : (m_udp ? m_udp->localPort() : 0); }
+    QString errorString() const { return m_error; }
+    const Stats& stats() const { return m_stats; }
+    int clients() const { return m_sockets.size(); }
+
+    // Length of the request at d (n bytes available): > 0 complete, 0 need more, -1 not a request.
+    static int requestLength(const uchar* d, int n)
+    {
+        if (n < 1) return 0;
+        if (d[0] == 0xA1) return n < 3 ? 0 : 3;
+        if (d[0] != 0xAA) return -1;
+        if (n < 4) return 0;
+        if (d[2] == 'M' && d[3] == 'B') return 15;
+        if (d[2] == 'G' && d[3] == 'A') return 13;
+        if (d[2] == 'A' && d[3] == 'E') {
+            if (n < 12) return 0;
+            return 12 + ((d[10] << 8) | d[11]) * 2 + 3;
+        }
+        return -1;
+    }
+
+private:
+    struct Pending {
+        qint64 dueNs;
+        QByteArray data;             // empty for a scan (packed when sent)
+        quint16 startAddr;
+        quint16 wordCount;
+        QPointer<QTcpSocket> socket;
+        QHostAddress address;
+        quint16 port;
+    };
+
+    struct Peer {
+        QTcpSocket* socket;
+        QHostAddress address;
+        quint16 port;
+    };
+
+    bool fail(const QString& error)
+    {
+        m_error = error;
+        return false;
+    }
+
+    bool openPty()
+    {
+#ifdef Q_OS_UNIX
+        m_ptyMaster = ::posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (m_ptyMaster < 0 || ::grantpt(m_ptyMaster) != 0 || ::unlockpt(m_ptyMaster) != 0)
+            return fail("posix_openpt failed");
+        m_endpoint = QString::fromLocal8Bit(::ptsname(m_ptyMaster));
+
+        // slave kept open: raw mode sticks and the master does not see EIO between clients
+        m_ptySlave = ::open(m_endpoint.toLocal8Bit().constData(), O_RDWR | O_NOCTTY);
+        if (m_ptySlave < 0) return fail("open " + m_endpoint + " failed");
+        termios tio;
+        if (::tcgetattr(m_ptySlave, &tio) == 0) {
+            ::cfmakeraw(&tio);
+            ::tcsetattr(m_ptySlave, TCSANOW, &tio);
+        }
+
+        m_ptyNotifier = new QSocketNotifier(m_ptyMaster, QSocketNotifier::Read, this);
+        connect(m_ptyNotifier, &QSocketNotifier::activated, this, &CEmuDevice::onPtyRead);
+        return true;
+#else
+        return fail("pty transport needs a Unix host");
+#endif
+    }
+
+    void onNewConnection()
+    {
+        while (QTcpSocket* socket = m_tcp->nextPendingConnection()) {
+            socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            m_sockets.insert(socket, QByteArray());
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+                QByteArray& buffer = m_sockets[socket];
+                buffer += socket->readAll();
+                consume(buffer, { socket, QHostAddress(), 0 });
+            });
+            connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+                m_sockets.remove(socket);
+                socket->deleteLater();
+            });
+        }
+    }
+
+    void onDatagrams()
+    {
+        while (m_udp->hasPendingDatagrams()) {
+            QNetworkDatagram datagram = m_udp->receiveDatagram();
+            QByteArray buffer = datagram.data();
+            consume(buffer, { nullptr, datagram.senderAddress(), (quint16)datagram.senderPort() });
+        }
+    }
+
+    void onPtyRead()
+    {
+#ifdef Q_OS_UNIX
+        char chunk[4096];
+        ssize_t n;
+        while ((n = ::read(m_ptyMaster, chunk, sizeof(chunk))) > 0) m_ptyBuffer.append(chunk, int(n));
+        consume(m_ptyBuffer, { nullptr, QHostAddress(), 0 });
+#endif
+    }
+
+    // Handles every complete request in buffer; garbage is skipped a byte at a time.
+    void consume(QByteArray& buffer, const Peer& peer)
+    {
+        int pos = 0;
+        while (pos < buffer.size()) {
+            const uchar* d = (const uchar*)buffer.constData() + pos;
+            int length = requestLength(d, buffer.size() - pos);
+            if (length == 0) break;
+            if (length < 0) {
+                ++m_stats.badRequests;
+                ++pos;
+                continue;
+            }
+            if (length > buffer.size() - pos) break;
+            handle(d, length, peer);
+            pos += length;
+        }
+        buffer.remove(0, pos);
+    }
+
+    static quint16 crcOf(const uchar* packet, int size)
+    {
+        return MakeCRC16((char*)packet + 4, size - 4);
+    }
+
+    void handle(const uchar* d, int length, const Peer& peer)
+    {
+        ++m_stats.requests;
+        QByteArray reply;
+
+        if (d[0] == 0xA1) {
+            reply.append(char(0xA1));
+            reply.append(char(d[1]));
+            switch (d[1]) {
+            case 'V': reply.append(m_version); break;
+            case 'S': m_running = true; break;
+            case 'Q': m_running = false; break;
+            case 'A': case 'B': case 'C': case 'D': m_mode = d[1] - 'A' + 1; break;
+            default:
+                ++m_stats.badRequests;
+                return;
+            }
+            reply.append('\r');
+            schedule(reply, 0, 0, peer, false);
+            return;
+        }
+
+        const quint16 dType = (d[6] << 8) | d[7];
+        const quint16 sAddr = (d[8] << 8) | d[9];
+        const quint16 wCnt = (d[10] << 8) | d[11];
+
+        if (d[2] == 'G') {
+            if (m_running) schedule(QByteArray(), sAddr, wCnt, peer, true);
+            return;
+        }
+
+        // getParam / setParam carry a CRC over everything after the length field
+        const int crcAt = length - 3;
+        if (crcOf(d, crcAt) != quint16((d[crcAt] << 8) | d[crcAt + 1])) {
+            ++m_stats.badRequests;
+            return;
+        }
+
+        QVector<quint16>& table = m_params[dType];
+        if (d[2] == 'A') {
+            if (table.size() < sAddr + wCnt) table.resize(sAddr + wCnt);
+            for (int i = 0; i < wCnt; ++i) table[sAddr + i] = (d[12 + i * 2] << 8) | d[13 + i * 2];
+            reply = QByteArray((const char*)d, 12);
+            reply[4] = 0;
+            reply[5] = 7;
+        }
+        else {
+            reply = QByteArray((const char*)d, 12);
+            reply[4] = char((7 + wCnt) >> 8);
+            reply[5] = char(7 + wCnt);
+            reply.resize(12 + wCnt * 2);
+            uchar* p = (uchar*)reply.data() + 12;
+            for (int i = 0; i < wCnt; ++i) {
+                quint16 v = (sAddr + i < table.size()) ? table[sAddr + i] : 0;
+                *p++ = uchar(v >> 8);
+                *p++ = uchar(v);
+            }
+        }
+        quint16 crc = crcOf((const uchar*)reply.constData(), reply.size());
+        reply.append(char(crc >> 8));
+        reply.append(char(crc));
+        reply.append('\r');
+        schedule(reply, 0, 0, peer, false);
+    }
+
+    // Due time = the scan (if any) + latency + jitter, then serialized over the bandwidth limit.
+    void schedule(const QByteArray& reply, quint16 sAddr, quint16 wCnt, const Peer& peer, bool isScan)
+    {
+        const qint64 now = m_source->nowNs();
+        qint64 due = now;
+        if (isScan) {
+            qint64 slot = m_source->slotAt(now);
+            if (slot <= m_lastSlot) slot = m_lastSlot + 1;
+            m_lastSlot = slot;
+            due = qMax(due, m_source->slotStartNs(slot));
+        }
+        if (m_transport != eTransport::udp && m_imp.loss > 0 && nextUniform() < m_imp.loss) {
+            ++m_stats.dropped;
+            return;
+        }
+
+        due += qint64(m_imp.latencyMs) * 1000000;
+        if (m_imp.jitterMs > 0) due += qint64(nextUniform() * m_imp.jitterMs * 1e6);
+        if (m_imp.bandwidth > 0) {
+            int bytes = isScan ? 10 + wCnt * 2 + 1 : reply.size();
+            m_linkFreeNs = qMax(m_linkFreeNs, due) + bytes * 1000000000LL / m_imp.bandwidth;
+            due = m_linkFreeNs;
+        }
+        due = qMax(due, m_lastDueNs);
+        m_lastDueNs = due;
+
+        m_pending.push_back({ due, reply, sAddr, wCnt, QPointer<QTcpSocket>(peer.socket), peer.address, peer.port });
+        if (due <= now && m_pending.size() == 1) flush();
+        else if (!m_timer.isActive()) armTimer();
+    }
+
+    void armTimer()
+    {
+        if (m_pending.empty()) return;
+        qint64 waitNs = m_pending.front().dueNs - m_source->nowNs();
+        m_timer.start(int(qMax<qint64>(0, (waitNs + 999999) / 1000000)));
+    }
+
+    void flush()
+    {
+        const qint64 now = m_source->nowNs();
+        while (!m_pending.empty() && m_pending.front().dueNs <= now) {
+            Pending& p = m_pending.front();
+            if (p.data.isEmpty()) {
+                QByteArray scan = m_source->payload();
+                if (scan.size() != p.wordCount * 2) scan.resize(p.wordCount * 2);
+                p.data = Protocol::pack(Protocol::eCmd::setBulk, 0, p.startAddr, p.wordCount, &scan, nullptr);
+            }
+            send(p);
+            m_pending.pop_front();
+        }
+        armTimer();
+    }
+
+    void send(const Pending& p)
+    {
+        switch (m_transport) {
+        case eTransport::tcp:
+            if (!p.socket) return;
+            p.socket->write(p.data);
+            break;
+        case eTransport::udp:
+            for (int pos = 0; pos < p.data.size(); pos += m_datagramBytes) {
+                if (m_imp.loss > 0 && nextUniform() < m_imp.loss) {
+                    ++m_stats.dropped;
+                    continue;
+                }
+                m_udp->writeDatagram(p.data.constData() + pos, qMin(m_datagramBytes, p.data.size() - pos), p.address, p.port);
+            }
+            break;
+        case eTransport::pty:
+#ifdef Q_OS_UNIX
+            for (int pos = 0; pos < p.data.size(); ) {
+                ssize_t n = ::write(m_ptyMaster, p.data.constData() + pos, p.data.size() - pos);
+                if (n <= 0) break; // nobody reading: the rest is lost, as on a wire
+                pos += int(n);
+            }
+#endif
+            break;
+        }
+        ++m_stats.replies;
+        m_stats.bytesOut += p.data.size();
+    }
+
+    float nextUniform()
+    {
+        // xorshift32
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return (m_seed >> 8) * (1.0f / 16777216.0f);
+    }
+
+    int m_id;
+    CEmuScanSource* m_source;
+    eTransport m_transport = eTransport::tcp;
+    QString m_endpoint;
+    QString m_error;
+    QByteArray m_version = "LumoEmu 1.0";
+
+    QTcpServer* m_tcp = nullptr;
+    QHash<QTcpSocket*, QByteArray> m_sockets;
+    QUdpSocket* m_udp = nullptr;
+    int m_datagramBytes = DEFAULT_DATAGRAM_BYTES;
+    int m_ptyMaster = -1;
+    int m_ptySlave = -1;
+    QSocketNotifier* m_ptyNotifier = nullptr;
+    QByteArray m_ptyBuffer;
+
+    bool m_running = true;
+    int m_mode = 1;
+    QHash<quint16, QVector<quint16>> m_params;   // data type -> words
+
+    Impairment m_imp;
+    std::deque<Pending> m_pending;
+    QTimer m_timer;
+    qint64 m_lastSlot = -1;
+    qint64 m_lastDueNs = 0;
+    qint64 m_linkFreeNs = 0;
+    quint32 m_seed;
+    Stats m_stats;
+};
+
+#endif // CEMUDEVICE_H
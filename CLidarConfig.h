@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLIDARCONFIG_H
+#define CLIDARCONFIG_H
+
+#include <QString>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+// config.json "Types" 항목 하나 (LiDAR 모델 프로파일)
+struct LidarConfig {
+    QString name;
+    int channels;
+    int fov;
+    float resolution;
+    bool isClockwise;
+    float angleOffset;
+    float distanceRate;
+    QString distanceUnit;
+    int mesuresPerScan;
+
+    static LidarConfig fromJson(const QJsonObject& config) {
+        LidarConfig cfg;
+        cfg.name = config["name"].toString();
+        cfg.channels = config["channels"].toInt(1);
+        cfg.fov = config["fov"].toInt(360);
+        cfg.resolution = (float)config["resolution"].toDouble(0.33);
+        cfg.isClockwise = config["isClockwise"].toBool(true);
+        cfg.angleOffset = (float)config["angleOffset"].toDouble(0.0);
+        cfg.distanceRate = (float)config["distanceRate"].toDouble(0.1);
+        cfg.distanceUnit = config["distanceUnit"].toString("cm");
+        cfg.mesuresPerScan = config["mesuresPerScan"].toInt((int)(cfg.fov / cfg.resolution) + 1);
+        if (cfg.mesuresPerScan <= 0) cfg.mesuresPerScan = 1;
+        return cfg;
+    }
+
+    QJsonObject toJson() const {
+        QJsonObject config;
+        config["name"] = name;
+        config["channels"] = channels;
+        config["fov"] = fov;
+        config["resolution"] = resolution;
+        config["isClockwise"] = isClockwise;
+        config["angleOffset"] = angleOffset;
+        config["distanceRate"] = distanceRate;
+        config["distanceUnit"] = distanceUnit;
+        config["mesuresPerScan"] = mesuresPerScan;
+        return config;
+    }
+
+    // 녹화 파일에 기록하는 프로파일 식별값 (FNV-1a, 실행마다 동일)
+    quint32 hash() const {
+        QByteArray bytes = QJsonDocument(toJson()).toJson(QJsonDocument::Compact);
+        quint32 h = 2166136261u;
+        for (char c : bytes) {
+            h ^= (quint8)c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    // Unit -> Meter 변환
+    float unitToMeter() const {
+        if (distanceUnit == "mm") return 0.001f;
+        if (distanceUnit == "m") return 1.0f;
+        return 0.01f; // 기본 cm
+    }
+
+    // getBulk 요청 word 수 (scan 당 측정 횟수 * 패킷 크기)
+    int reqWordSize() const {
+        int bytesPerPacket = 2 + (channels * 2);
+        int totalDataBytes = mesuresPerScan * bytesPerPacket;
+        return (totalDataBytes + 1) / 2;
+    }
+
+    // config.json이 없거나 잘못된 경우 사용하는 기본 프로파일
+    static QJsonArray defaultTypes() {
+        QJsonObject type1, type2;
+        QJsonArray typesArray;
+
+        type1["name"] = "1ch / 360° (Standard)";
+        type1["channels"] = 1;
+        type1["fov"] = 360;
+        type1["resolution"] = 0.33;
+        type1["isClockwise"] = true;
+        type1["angleOffset"] = 180.0;
+        type1["fovStart"] = 0.0;
+        type1["distanceRate"] = 0.1; // Raw 1 = 0.1cm (1mm)
+        type1["distanceUnit"] = "cm";
+        type1["mesuresPerScan"] = (int)(360 / 0.33) + 1;
+
+        type2["name"] = "4ch / 90° (Front-Facing)";
+        type2["channels"] = 4;
+        type2["fov"] = 90;
+        type2["resolution"] = 0.33;
+        type2["isClockwise"] = true;
+        type2["angleOffset"] = 135.0;
+        type2["fovStart"] = 45.0;
+        type2["distanceRate"] = 0.1;
+        type2["distanceUnit"] = "cm";
+        type2["mesuresPerScan"] = (int)(90 / 0.33) + 1;
+
+        typesArray.append(type1);
+        typesArray.append(type2);
+        return typesArray;
+    }
+
+    // config.json의 "Types" 배열. 파일이 없거나 잘못되면 빈 배열.
+    static QJsonArray loadTypes(const QString& path = "config.json") {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return QJsonArray();
+
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+        if (doc.isNull() || !doc.isObject() || !doc.object()["Types"].isArray()) return QJsonArray();
+        return doc.object()["Types"].toArray();
+    }
+};
+
+#endif // CLIDARCONFIG_H
@@ -0,0 +1,720 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * LumoBench: pipeline stage benchmarks with regression check.
+ *
+ *   LumoBench [--profile N|all] [--input file.lrec|file.pcap[ng]] [--frames N] [--repeats N]
+ *             [--size WxH] [--e2e-scans N] [--shm-consumers N,N..] [--out results.json]
+ *             [--baseline baseline.json] [--threshold PERCENT] [--save-baseline | --check]
+ *   LumoBench --codec-bench [--profile N|all] [--frames N] [--input file.lrec]
+ *   LumoBench --blackbox-bench [--profile N|all] [--rate HZ]
+ *   LumoBench --replay-bench --input file.lrec|file.pcap[ng] [--profile N] [--port P]
+ *   LumoBench --synth-bench [--profile N|all] [--frames N]
+ *
+ * Stages, per scan of each profile (synthetic scene) and of --input:
+ *   pack       Protocol::pack of the setBulk reply
+ *   unpack     Protocol::unpack of the reply
+ *   crc16      MakeCRC16 over the reply
+ *   decode     decodeScanPayload into a no-op getter (parse only)
+ *   filter     CScanFilter median of 5 scans, in place
+ *   transform  decodeScanPayload into CCloudPoints + buildIndex (as updatePoints)
+ *   render     CMapRenderer lumos + render into an offscreen image
+ *   table      CPointTableModel::updateScan + DisplayRole of the visible rows
+ *   e2e        getBulk over loopback TCP to a CEmuDevice (CommTCP, as runProtocol),
+ *              then unpack, transform and render
+ *   shm_cN     CShmScanWriter::publish to N CShmScanReader threads: median
+ *              publish-to-read latency (ns), plus p99, publish cost and lost scans
+ *
+ * Each stage runs --repeats times over the fixed frame set; the median ns/scan
+ * is reported. With --baseline, a stage slower than baseline x (1 + threshold)
+ * fails the run (exit code 2). --save-baseline writes the results as the baseline.
+ *
+ * Baselines are per machine, so none is shipped. Create one on the bench host
+ * from a known-good build, then gate later builds with --check:
+ *   LumoBench --save-baseline --baseline bench_baseline.json
+ *   LumoBench --check --baseline bench_baseline.json
+ * Without --check a missing baseline only prints a note; with --check a missing
+ * or unreadable baseline, or one that shares no stage with the run, exits 3.
+ *
+ * The --*-bench modes print one report line per profile instead of running the
+ * stages (no JSON, no baseline):
+ *   codec      CScanCodec ratio and encode / decode MB/s (of --input if given)
+ *   blackbox   CBlackBox push ns/frame for 60 s at --rate, and the dump time
+ *   replay     open/index time and frames/s through frame, unpack and decode
+ *   synth      CSynthScene frames/s
+ */
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QSysInfo>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QThread>
+#include <QDir>
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <thread>
+
+#include "CComm.h"
+#include "CEmuDevice.h"
+#include "CCloudPoints.h"
+#include "CMapRenderer.h"
+#include "CPointTableModel.h"
+#include "CShmScanRing.h"
+#include "CScanFilter.h"
+#include "CBlackBox.h"
+
+namespace {
+
+struct Input {
+    QString name;               // "<profile>/synthetic" or "<profile>/<file>"
+    LidarConfig cfg;
+    QVector<QByteArray> frames; // as received (setBulk)
+    QVector<QByteArray> payloads;
+};
+
+struct Options {
+    int repeats;
+    QSize size;
+    int tableRows;
+    int e2eScans;
+    QList<int> shmConsumers;
+    int shmScans;
+};
+
+class CNullGetter : public ICloudPointGetter {
+public:
+    void clearPoints() override { m_count = 0; }
+    void setPoint(quint16 angle, quint16 distance, int layerNo) override { m_count += angle + distance + layerNo; }
+    quint64 m_count = 0;
+};
+
+// Median over repeats of the mean ns per scan.
+template <typename F>
+double measure(int scans, int repeats, F run)
+{
+    QVector<double> samples;
+    QElapsedTimer stopwatch;
+    for (int r = 0; r < repeats; ++r) {
+        stopwatch.start();
+        run();
+        samples.append((double)stopwatch.nsecsElapsed() / qMax(1, scans));
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+Input syntheticInput(const LidarConfig& cfg, int count)
+{
+    Input in;
+    in.name = cfg.name + "/synthetic";
+    in.cfg = cfg;
+    CSynthScene scene;
+    scene.setProfile(cfg.channels, cfg.resolution, cfg.mesuresPerScan, cfg.distanceRate * cfg.unitToMeter());
+    for (int i = 0; i < count; ++i) {
+        QByteArray payload(cfg.reqWordSize() * 2, 0);
+        scene.generate((uchar*)payload.data());
+        in.payloads.append(payload);
+        in.frames.append(Protocol::pack(Protocol::eCmd::setBulk, 0, 0, cfg.reqWordSize(), &payload, nullptr));
+    }
+    return in;
+}
+
+bool recordedInput(const QString& path, LidarConfig cfg, int count, Input* in)
+{
+    std::unique_ptr<IFrameSource> source;
+    if (CPcapReader::isCapture(path)) source.reset(new CPcapReader(CPcapReader::DEFAULT_PORT, cfg.reqWordSize() * 2 + 11));
+    else source.reset(new CScanReader);
+    if (!source->open(path)) return false;
+    if (!source->config().isEmpty()) cfg = LidarConfig::fromJson(source->config());
+
+    in->name = cfg.name + "/" + QFileInfo(path).fileName();
+    in->cfg = cfg;
+    IFrameSource::Frame frame;
+    QByteArray payload;
+    for (int i = 0; i < source->frameCount() && in->frames.size() < count; ++i) {
+        if (source->frameSize(i) < cfg.reqWordSize() * 2 || !source->frame(i, &frame)) continue;
+        QByteArray data(frame.data.constData(), frame.data.size());
+        if (!Protocol::unpack(data, nullptr, nullptr, nullptr, nullptr, &payload, nullptr)) continue;
+        in->frames.append(data);
+        in->payloads.append(payload);
+    }
+    return !in->frames.isEmpty();
+}
+
+void setupMap(CMapRenderer& map, const LidarConfig& cfg, const QSize& size)
+{
+    map.setViewportSize(size);
+    map.setMapOrientation(cfg.angleOffset, cfg.isClockwise);
+    map.setDistanceUnit(cfg.distanceUnit);
+    map.normalInfo().info = cfg.name;
+}
+
+void setupCloud(CCloudPoints& cloud, const LidarConfig& cfg)
+{
+    cloud.setOrientation(cfg.angleOffset, cfg.isClockwise);
+    cloud.setDistanceSettings(cfg.distanceRate, cfg.unitToMeter());
+}
+
+// getBulk round trips against an emulated device on its own thread; < 0 on failure.
+double endToEnd(const Input& in, const Options& opt)
+{
+    CEmuScanSource source;
+    source.openSynth(in.cfg, CSynthScene::defaultScene());
+    source.setRate(1e6); // a new scan for every request: measures the link, not the scan rate
+
+    QThread emuThread;
+    CEmuDevice* device = new CEmuDevice(0, &source);
+    device->moveToThread(&emuThread);
+    emuThread.start();
+    bool listening = false;
+    QMetaObject::invokeMethod(device, [&]() {
+        listening = device->listen(CEmuDevice::eTransport::tcp, QHostAddress::LocalHost, 0);
+    }, Qt::BlockingQueuedConnection);
+    auto shutdown = [&]() {
+        QMetaObject::invokeMethod(device, [device]() { delete device; }, Qt::BlockingQueuedConnection);
+        emuThread.quit();
+        emuThread.wait();
+    };
+    if (!listening) {
+        shutdown();
+        return -1;
+    }
+
+    CommTCP comm;
+    bool ok = comm.setConnInfo("127.0.0.1", device->port()) && comm.connect(1000);
+
+    CCloudPoints cloud(nullptr);
+    setupCloud(cloud, in.cfg);
+    CMapRenderer map(in.cfg.channels, in.cfg.fov, in.cfg.resolution);
+    setupMap(map, in.cfg, opt.size);
+    QImage image(opt.size, QImage::Format_ARGB32_Premultiplied);
+
+    const int reqWords = in.cfg.reqWordSize();
+    auto scan = [&]() {
+        comm.waitForReady();
+        QByteArray request = Protocol::pack(Protocol::eCmd::getBulk, 4, 0, reqWords);
+        if (!comm.send(request, 1000)) return false;
+        comm.waitForReady();
+        bool isOK = false;
+        for (int i = 0; i < 50 && !isOK; i++) isOK = comm.inbox(30);
+        QByteArray frame, payload;
+        if (!comm.recv(frame, isOK ? 300 : 100, reqWords * 2 + 11)) return false;
+        if (!Protocol::unpack(frame, nullptr, nullptr, nullptr, nullptr, &payload, nullptr)) return false;
+        decodeScanPayload(payload, in.cfg.channels, &cloud);
+        cloud.buildIndex();
+        map.lumos(cloud.getPoints());
+        map.render(image);
+        return true;
+    };
+
+    for (int i = 0; i < 10 && ok; ++i) ok = scan(); // connect + first replies
+    double ns = -1;
+    if (ok) {
+        ns = measure(opt.e2eScans, opt.repeats, [&]() {
+            for (int i = 0; i < opt.e2eScans && ok; ++i) ok = scan();
+        });
+    }
+    comm.close(1000);
+    shutdown();
+    return ok ? ns : -1;
+}
+
+// One scan per SHM_PERIOD_US through the ring, each reader in its own mapping (as another process would).
+QJsonObject shmLatency(const Input& in, int consumers, int scans)
+{
+    enum { SHM_PERIOD_US = 1000, READ_TIMEOUT_US = 2000000 };
+    const QString name = QString("LumoBench.%1").arg(QCoreApplication::applicationPid());
+    const int maxPoints = in.cfg.mesuresPerScan * in.cfg.channels;
+    CShmScanWriter writer;
+    if (!writer.create(name, in.cfg.channels, quint32(maxPoints), quint32(in.cfg.reqWordSize() * 2), 0)) return QJsonObject();
+
+    CCloudPoints cloud(nullptr);
+    setupCloud(cloud, in.cfg);
+    QVector<QVector<float>> points(in.payloads.size());
+    for (int i = 0; i < in.payloads.size(); ++i) {
+        decodeScanPayload(in.payloads[i], in.cfg.channels, &cloud);
+        for (const QPointF& p : cloud.getPoints()) points[i] << float(p.x()) << float(p.y());
+    }
+
+    std::vector<std::vector<qint64>> latency(consumers);
+    std::vector<quint64> lost(consumers, 0);
+    std::atomic<int> ready{ 0 };
+    std::vector<std::thread> readers;
+    for (int c = 0; c < consumers; ++c) {
+        readers.emplace_back([&, c]() {
+            CShmScanReader reader;
+            if (!reader.open(name, true)) {
+                ++ready;
+                return;
+            }
+            latency[c].reserve(scans);
+            ++ready;
+            CShmScanReader::Scan scan;
+            while (reader.waitNext(&scan, READ_TIMEOUT_US)) {
+                latency[c].push_back(ShmScan::steadyNs() - scan.publishNs);
+                if (scan.seq + 1 >= quint64(scans)) break;
+            }
+            lost[c] = reader.lost();
+        });
+    }
+    while (ready.load() < consumers) std::this_thread::yield();
+
+    QVector<double> publishNs;
+    for (int i = 0; i < scans; ++i) {
+        const QVector<float>& xy = points[i % points.size()];
+        const qint64 start = ShmScan::steadyNs();
+        writer.publish(0, xy.constData(), xy.size() / 2, in.payloads[i % in.payloads.size()]);
+        publishNs.append(double(ShmScan::steadyNs() - start));
+        std::this_thread::sleep_for(std::chrono::microseconds(SHM_PERIOD_US));
+    }
+    for (std::thread& t : readers) t.join();
+    writer.close();
+
+    std::vector<qint64> all;
+    quint64 lostTotal = 0;
+    for (int c = 0; c < consumers; ++c) {
+        all.insert(all.end(), latency[c].begin(), latency[c].end());
+        lostTotal += lost[c] + quint64(scans) - qMin<quint64>(quint64(scans), latency[c].size() + lost[c]);
+    }
+    if (all.empty()) return QJsonObject();
+    std::sort(all.begin(), all.end());
+    std::sort(publishNs.begin(), publishNs.end());
+    const double p50 = double(all[all.size() / 2]);
+    return QJsonObject{
+        { "nsPerScan", p50 }, { "scansPerSec", p50 > 0 ? 1e9 / p50 : 0.0 },
+        { "p99Ns", double(all[qMin(all.size() - 1, all.size() * 99 / 100)]) },
+        { "publishNs", publishNs[publishNs.size() / 2] },
+        { "consumers", consumers }, { "lost", double(lostTotal) } };
+}
+
+QJsonObject runStages(const Input& in, const Options& opt, bool synthetic)
+{
+    const int n = in.frames.size();
+    const LidarConfig& cfg = in.cfg;
+    QJsonObject stages;
+    auto put = [&](const char* stage, double ns) {
+        if (ns >= 0) stages[stage] = QJsonObject{ { "nsPerScan", ns }, { "scansPerSec", ns > 0 ? 1e9 / ns : 0.0 } };
+    };
+
+    QByteArray packed;
+    QVector<QByteArray> payloads = in.payloads;
+    put("pack", measure(n, opt.repeats, [&]() {
+        for (int i = 0; i < n; ++i) packed = Protocol::pack(Protocol::eCmd::setBulk, 0, 0, cfg.reqWordSize(), &payloads[i], nullptr);
+    }));
+
+    QByteArray payload;
+    put("unpack", measure(n, opt.repeats, [&]() {
+        for (int i = 0; i < n; ++i) Protocol::unpack(in.frames[i], nullptr, nullptr, nullptr, nullptr, &payload, nullptr);
+    }));
+
+    volatile quint16 crc = 0;
+    put("crc16", measure(n, opt.repeats, [&]() {
+        for (int i = 0; i < n; ++i) crc = MakeCRC16(const_cast<char*>(in.frames[i].constData()), in.frames[i].size());
+    }));
+    Q_UNUSED(crc);
+
+    CNullGetter null;
+    put("decode", measure(n, opt.repeats, [&]() {
+        for (int i = 0; i < n; ++i) decodeScanPayload(in.payloads[i], cfg.channels, &null);
+    }));
+
+    CScanFilter filter;
+    filter.setMode(CScanFilter::eMode::median, 5);
+    QVector<QByteArray> filtered = in.payloads;
+    put("filter", measure(n, opt.repeats, [&]() {
+        for (int i = 0; i < n; ++i) filter.apply(filtered[i], cfg.channels);
+    }));
+
+    CCloudPoints cloud(nullptr);
+    setupCloud(cloud, cfg);
+    QVector<QVector<QPointF>> scans(n);
+    put("transform", measure(n, opt.repeats, [&]() {
+        for (int i = 0; i < n; ++i) {
+            decodeScanPayload(in.payloads[i], cfg.channels, &cloud);
+            cloud.buildIndex();
+        }
+    }));
+    for (int i = 0; i < n; ++i) {
+        decodeScanPayload(in.payloads[i], cfg.channels, &cloud);
+        scans[i] = cloud.getPoints();
+    }
+
+    CMapRenderer map(cfg.channels, cfg.fov, cfg.resolution);
+    setupMap(map, cfg, opt.size);
+    QImage image(opt.size, QImage::Format_ARGB32_Premultiplied);
+    qint64 scanMs = 0; // 100 ms apart, as CRenderCli
+    put("render", measure(n, opt.repeats, [&]() {
+        for (int i = 0; i < n; ++i) {
+            map.lumos(scans[i], scanMs += 100);
+            map.render(image);
+        }
+    }));
+
+    CPointTableModel table;
+    table.setDistanceFormat(cfg.distanceRate, cfg.distanceUnit);
+    put("table", measure(n, opt.repeats, [&]() {
+        for (int i = 0; i < n; ++i) {
+            table.updateScan(in.payloads[i], cfg.channels);
+            for (int row = 0; row < qMin(opt.tableRows, table.rowCount()); ++row) {
+                for (int col = 0; col < CPointTableModel::COLUMN_COUNT; ++col) table.data(table.index(row, col));
+            }
+        }
+    }));
+
+    if (synthetic && opt.e2eScans > 0) put("e2e", endToEnd(in, opt));
+    if (synthetic && opt.shmScans > 0) {
+        for (int consumers : opt.shmConsumers) {
+            QJsonObject shm = shmLatency(in, consumers, opt.shmScans);
+            if (!shm.isEmpty()) stages[QString("shm_c%1").arg(consumers)] = shm;
+        }
+    }
+    return stages;
+}
+
+// Encode and decode the frames as CScanRecorder / CScanReader do (keyframe every chunk).
+QString codecBench(const QString& name, const QVector<QByteArray>& frames, quint64 durationNs)
+{
+    qint64 rawBytes = 0;
+    for (const QByteArray& f : frames) rawBytes += f.size();
+
+    QVector<int> sizes;
+    sizes.reserve(frames.size());
+    QByteArray coded;
+    coded.reserve(int(qMin<qint64>(rawBytes + frames.size() * CScanCodec::HEADER_SIZE, INT_MAX / 2)));
+
+    QElapsedTimer stopwatch;
+    stopwatch.start();
+    for (int i = 0; i < frames.size(); ++i) {
+        bool key = (i % CScanCodec::KEYFRAME_INTERVAL) == 0 || frames[i].size() != frames[i - 1].size();
+        sizes.append(CScanCodec::encode((const uchar*)frames[i].constData(), frames[i].size(),
+            key ? nullptr : (const uchar*)frames[i - 1].constData(), coded));
+    }
+    qint64 encodeNs = qMax<qint64>(1, stopwatch.nsecsElapsed());
+
+    QByteArray decoded;
+    bool ok = true;
+    stopwatch.start();
+    const uchar* in = (const uchar*)coded.constData();
+    for (int i = 0; i < frames.size(); ++i) {
+        bool key = (i % CScanCodec::KEYFRAME_INTERVAL) == 0 || frames[i].size() != frames[i - 1].size();
+        decoded.resize(frames[i].size());
+        uchar* o = (uchar*)decoded.data();
+        ok &= CScanCodec::decode(in, sizes[i], key ? nullptr : o, o, decoded.size());
+        in += sizes[i];
+    }
+    qint64 decodeNs = qMax<qint64>(1, stopwatch.nsecsElapsed());
+    ok &= frames.isEmpty() || decoded == frames.last();
+
+    QString report = QString("%1: %2 frames, %3 MB -> %4 MB (x%5), encode %6 MB/s, decode %7 MB/s%8")
+        .arg(name).arg(frames.size())
+        .arg(rawBytes / 1e6, 0, 'f', 2).arg(coded.size() / 1e6, 0, 'f', 2)
+        .arg(coded.isEmpty() ? 0.0 : (double)rawBytes / coded.size(), 0, 'f', 2)
+        .arg(rawBytes * 1e3 / encodeNs, 0, 'f', 0)
+        .arg(rawBytes * 1e3 / decodeNs, 0, 'f', 0)
+        .arg(ok ? "" : "  ROUND TRIP FAILED");
+    if (durationNs > 0)
+        report += QString(", decode x%1 real time").arg((double)durationNs / decodeNs, 0, 'f', 0);
+    return report;
+}
+
+// 60 s of frames at `rate` through push(), then one dump (plain and coded) to a temp file.
+QString blackBoxBench(const LidarConfig& cfg, int rate)
+{
+    const QVector<QByteArray> frames = syntheticInput(cfg, 64).payloads;
+    const int count = CBlackBox::DEFAULT_SECONDS * rate;
+
+    CBlackBox box;
+    box.allocate(cfg.reqWordSize() * 2 + 64, qMax<int>(CBlackBox::DEFAULT_MEGABYTES,
+        int((qint64)count * (cfg.reqWordSize() * 2 + 64) / (1024 * 1024) + 1)));
+    box.setConfig(cfg.toJson(), cfg.hash());
+    box.setArmed(true);
+
+    QElapsedTimer stopwatch;
+    stopwatch.start();
+    for (int i = 0; i < count; ++i) box.push(frames[i % frames.size()]);
+    double pushNs = (double)stopwatch.nsecsElapsed() / count;
+
+    QString report = QString("%1 frames, push %2 ns/frame").arg(count).arg(pushNs, 0, 'f', 0);
+    const QString path = QDir::temp().absoluteFilePath("lumomap_blackbox_bench.lrec");
+    for (int coded = 0; coded < 2; ++coded) {
+        box.setCompressed(coded);
+        stopwatch.start();
+        box.trigger(path, "bench");
+        box.waitForDump();
+        report += QString(", dump%1 %2 ms (%3 MB)").arg(coded ? " coded" : "")
+            .arg(stopwatch.elapsed()).arg(QFileInfo(path).size() / 1e6, 0, 'f', 1);
+    }
+    QFile::remove(path);
+    return report;
+}
+
+// The replay path at speed 0: open (index), then frame -> Protocol::unpack -> decodeScanPayload.
+QString replayBench(const QString& path, const LidarConfig& cfg, quint16 port)
+{
+    const int frameBytes = cfg.reqWordSize() * 2 + 11;
+    std::unique_ptr<IFrameSource> source;
+    if (CPcapReader::isCapture(path)) source.reset(new CPcapReader(port, frameBytes));
+    else source.reset(new CScanReader);
+
+    QElapsedTimer stopwatch;
+    stopwatch.start();
+    if (!source->open(path)) return "Couldn't open " + path;
+    qint64 openMs = stopwatch.elapsed();
+
+    CCloudPoints cloud(nullptr);
+    setupCloud(cloud, cfg);
+
+    IFrameSource::Frame frame;
+    QByteArray payload;
+    qint64 bytes = 0;
+    int decoded = 0;
+    stopwatch.start();
+    for (int i = 0; i < source->frameCount(); ++i) {
+        if (source->frameSize(i) < cfg.reqWordSize() * 2 || !source->frame(i, &frame)) continue;
+        bytes += frame.data.size();
+        if (!Protocol::unpack(frame.data, nullptr, nullptr, nullptr, nullptr, &payload, nullptr)) continue;
+        decodeScanPayload(payload, cfg.channels, &cloud);
+        ++decoded;
+    }
+    qint64 runNs = qMax<qint64>(1, stopwatch.nsecsElapsed());
+
+    return QString("'%1' (%2): %3 of %4 frames decoded, open %5 ms, %6 fps, %7 MB/s, x%8 real time")
+        .arg(path).arg(cfg.name).arg(decoded).arg(source->frameCount()).arg(openMs)
+        .arg(decoded * 1e9 / runNs, 0, 'f', 0)
+        .arg(bytes * 1e3 / runNs, 0, 'f', 0)
+        .arg((double)source->durationNs() / runNs, 0, 'f', 0);
+}
+
+// CSynthScene (scene.json, or the default scene) frames per second.
+QString synthBench(const LidarConfig& cfg, int frames)
+{
+    CSynthScene scene;
+    scene.setScene(CSynthScene::loadScene());
+    scene.setProfile(cfg.channels, cfg.resolution, cfg.mesuresPerScan, cfg.distanceRate * cfg.unitToMeter());
+    QByteArray buffer(scene.payloadBytes(), 0);
+    QElapsedTimer stopwatch;
+    stopwatch.start();
+    for (int i = 0; i < frames; ++i) scene.generate((uchar*)buffer.data());
+    double sec = qMax<qint64>(1, stopwatch.nsecsElapsed()) / 1e9;
+    return QString("%1 measures x %2 ch, %3 frames/s (%4 MB/s)")
+        .arg(cfg.mesuresPerScan).arg(cfg.channels)
+        .arg(frames / sec, 0, 'f', 0).arg(frames * (double)buffer.size() / sec / 1e6, 0, 'f', 0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("LumoBench");
+    QTextStream out(stdout);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("LumoMap pipeline benchmarks");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "config", "LiDAR profile file.", "path", "config.json" },
+        { "profile", "Profile index in config.json, or 'all'.", "index", "all" },
+        { "input", "Also run on a recording or capture (the file for --codec-bench / --replay-bench).", "path" },
+        { "frames", "Scans per input.", "count", "64" },
+        { "repeats", "Runs per stage (median).", "count", "5" },
+        { "size", "Render size.", "WxH", "1920x1080" },
+        { "table-rows", "Visible Point Viewer rows.", "rows", "40" },
+        { "e2e-scans", "Loopback round trips per run; 0 = skip.", "count", "200" },
+        { "shm-consumers", "Reader counts for the shared-memory ring.", "N,N..", "1,2,4,8" },
+        { "shm-scans", "Scans through the ring per reader count; 0 = skip.", "count", "500" },
+        { "out", "Results file.", "path", "bench_results.json" },
+        { "baseline", "Baseline to compare with.", "path", "bench_baseline.json" },
+        { "threshold", "Allowed slowdown against the baseline.", "percent", "15" },
+        { "save-baseline", "Write the results as the baseline instead of comparing." },
+        { "check", "Fail (exit 3) when there is no baseline to compare with." },
+        { "codec-bench", "Recording codec ratio and MB/s instead of the stages." },
+        { "blackbox-bench", "Black box push cost and 60 s dump time instead of the stages." },
+        { "rate", "Scans per second for --blackbox-bench.", "hz", "20" },
+        { "replay-bench", "Frames per second through index, unpack and decode of --input." },
+        { "port", "Sensor UDP port in a capture.", "port", QString::number(CPcapReader::DEFAULT_PORT) },
+        { "synth-bench", "Synthetic scene frames per second instead of the stages." },
+    });
+    parser.process(app);
+
+    QJsonArray types = LidarConfig::loadTypes(parser.value("config"));
+    if (types.isEmpty()) types = LidarConfig::defaultTypes();
+    QList<int> profiles;
+    if (parser.value("profile") == "all") {
+        for (int i = 0; i < types.count(); ++i) profiles.append(i);
+    }
+    else {
+        int index = parser.value("profile").toInt();
+        if (index < 0 || index >= types.count()) {
+            out << "Invalid profile index: " << index << Qt::endl;
+            return 1;
+        }
+        profiles.append(index);
+    }
+
+    const int frames = qMax(1, parser.value("frames").toInt());
+
+    if (parser.isSet("codec-bench")) {
+        if (parser.isSet("input")) {
+            CScanReader reader;
+            if (!reader.open(parser.value("input"))) {
+                out << "Couldn't open recording: " << parser.value("input") << Qt::endl;
+                return 1;
+            }
+            QVector<QByteArray> recorded;
+            IFrameSource::Frame frame;
+            for (int i = 0; i < reader.frameCount(); ++i) {
+                if (reader.frame(i, &frame)) recorded.append(QByteArray(frame.data.constData(), frame.data.size()));
+            }
+            out << codecBench(QString("'%1'").arg(parser.value("input")), recorded, reader.durationNs()) << Qt::endl;
+            return 0;
+        }
+        for (int index : profiles) {
+            LidarConfig cfg = LidarConfig::fromJson(types[index].toObject());
+            out << codecBench(QString("Profile %1 '%2' synthetic").arg(index).arg(cfg.name),
+                syntheticInput(cfg, frames).payloads, 0) << Qt::endl;
+        }
+        return 0;
+    }
+
+    if (parser.isSet("replay-bench")) {
+        LidarConfig cfg = LidarConfig::fromJson(types[profiles.first()].toObject());
+        QString report = replayBench(parser.value("input"), cfg, (quint16)parser.value("port").toUInt());
+        out << report << Qt::endl;
+        return report.startsWith("Couldn't") ? 1 : 0;
+    }
+
+    if (parser.isSet("synth-bench") || parser.isSet("blackbox-bench")) {
+        const int rate = qMax(1, parser.value("rate").toInt());
+        for (int index : profiles) {
+            LidarConfig cfg = LidarConfig::fromJson(types[index].toObject());
+            out << QString("Profile %1 '%2': ").arg(index).arg(cfg.name)
+                << (parser.isSet("synth-bench") ? synthBench(cfg, frames) : blackBoxBench(cfg, rate)) << Qt::endl;
+        }
+        return 0;
+    }
+
+    Options opt;
+    opt.repeats = qMax(1, parser.value("repeats").toInt());
+    QStringList wh = parser.value("size").split('x');
+    opt.size = QSize(wh.value(0).toInt(), wh.value(1).toInt());
+    if (opt.size.isEmpty()) opt.size = QSize(1920, 1080);
+    opt.tableRows = qMax(0, parser.value("table-rows").toInt());
+    opt.e2eScans = qMax(0, parser.value("e2e-scans").toInt());
+    for (const QString& n : parser.value("shm-consumers").split(',', Qt::SkipEmptyParts)) {
+        if (n.toInt() > 0) opt.shmConsumers.append(n.toInt());
+    }
+    opt.shmScans = qMax(0, parser.value("shm-scans").toInt());
+
+    QVector<Input> inputs;
+    for (int index : profiles) inputs.append(syntheticInput(LidarConfig::fromJson(types[index].toObject()), frames));
+    if (parser.isSet("input")) {
+        Input recorded;
+        if (!recordedInput(parser.value("input"), LidarConfig::fromJson(types[profiles.first()].toObject()), frames, &recorded)) {
+            out << "Couldn't read scans from " << parser.value("input") << Qt::endl;
+            return 1;
+        }
+        inputs.append(recorded);
+    }
+
+    QJsonObject results;
+    for (const Input& in : inputs) {
+        const bool synthetic = in.name.endsWith("/synthetic");
+        QJsonObject stages = runStages(in, opt, synthetic);
+        results[in.name] = stages;
+        out << in.name << " (" << in.frames.size() << " scans)" << Qt::endl;
+        for (auto it = stages.constBegin(); it != stages.constEnd(); ++it) {
+            double ns = it.value().toObject()["nsPerScan"].toDouble();
+            out << QString("  %1 %2 us/scan  %3 scans/s").arg(it.key(), -10)
+                .arg(ns / 1000.0, 10, 'f', 2).arg(ns > 0 ? 1e9 / ns : 0.0, 10, 'f', 0) << Qt::endl;
+        }
+    }
+
+    QJsonObject report;
+    report["host"] = QSysInfo::machineHostName();
+    report["cpu"] = QSysInfo::currentCpuArchitecture();
+    report["os"] = QSysInfo::prettyProductName();
+    report["qt"] = QString(qVersion());
+    report["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    report["frames"] = frames;
+    report["repeats"] = opt.repeats;
+    report["size"] = parser.value("size");
+    report["results"] = results;
+
+    auto writeJson = [&](const QString& path, const QJsonObject& json) {
+        QFile file(path);
+        bool ok = file.open(QIODevice::WriteOnly) && file.write(QJsonDocument(json).toJson()) > 0;
+        if (!ok) out << "Couldn't write " << path << Qt::endl;
+        return ok;
+    };
+    if (!writeJson(parser.value("out"), report)) return 1;
+
+    if (parser.isSet("save-baseline")) {
+        report["thresholdPercent"] = parser.value("threshold").toDouble();
+        if (!writeJson(parser.value("baseline"), report)) return 1;
+        out << "Baseline saved to " << parser.value("baseline") << Qt::endl;
+        return 0;
+    }
+
+    const bool check = parser.isSet("check");
+    QFile baselineFile(parser.value("baseline"));
+    if (!baselineFile.open(QIODevice::ReadOnly)) {
+        out << "No baseline (" << parser.value("baseline") << "), nothing compared; create one with --save-baseline" << Qt::endl;
+        return check ? 3 : 0;
+    }
+    const QJsonObject baseline = QJsonDocument::fromJson(baselineFile.readAll()).object();
+    if (baseline["results"].toObject().isEmpty()) {
+        out << "Baseline " << parser.value("baseline") << " has no results" << Qt::endl;
+        return check ? 3 : 0;
+    }
+    const double threshold = (parser.isSet("threshold") ? parser.value("threshold").toDouble()
+        : baseline["thresholdPercent"].toDouble(parser.value("threshold").toDouble())) / 100.0;
+
+    // Only stages present in both are compared; a new stage or profile is not a failure.
+    int regressions = 0, compared = 0;
+    const QJsonObject base = baseline["results"].toObject();
+    for (auto input = results.constBegin(); input != results.constEnd(); ++input) {
+        const QJsonObject baseStages = base[input.key()].toObject();
+        const QJsonObject stages = input.value().toObject();
+        for (auto it = stages.constBegin(); it != stages.constEnd(); ++it) {
+            double before = baseStages[it.key()].toObject()["nsPerScan"].toDouble();
+            if (before <= 0) continue;
+            double now = it.value().toObject()["nsPerScan"].toDouble();
+            ++compared;
+            if (now > before * (1.0 + threshold)) {
+                ++regressions;
+                out << QString("REGRESSION %1 %2: %3 -> %4 us/scan (+%5%)").arg(input.key()).arg(it.key())
+                    .arg(before / 1000.0, 0, 'f', 2).arg(now / 1000.0, 0, 'f', 2)
+                    .arg((now / before - 1.0) * 100.0, 0, 'f', 1) << Qt::endl;
+            }
+        }
+    }
+    out << QString("%1 of %2 stages within %3% of the baseline")
+        .arg(compared - regressions).arg(compared).arg(threshold * 100.0, 0, 'f', 0) << Qt::endl;
+    if (regressions) return 2;
+    return (check && compared == 0) ? 3 : 0;
+}
@@ -0,0 +1,37 @@
+# LumoBench: pipeline stage benchmarks (offscreen) with a JSON baseline check
+QT += core gui network concurrent serialport
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+TARGET = LumoBench
+
+HEADERS += \
+    CComm.h \
+    CShmScanRing.h \
+    CScanFilter.h \
+    CBlackBox.h \
+    CEmuDevice.h \
+    CCloudPoints.h \
+    CScanIndex.h \
+    CMapRenderer.h \
+    CPointRaster.h \
+    CPointTableModel.h \
+    CSynthScene.h \
+    CScanRecord.h \
+    CScanCodec.h \
+    CPcapReader.h \
+    CLidarConfig.h \
+    CProtocol.h \
+    crc16.h
+SOURCES += \
+    CComm.cpp \
+    CLumoBench.cpp
+win32-msvc*: QMAKE_CXXFLAGS += /utf-8
+unix:!macx: LIBS += -lrt
+
+CONFIG(debug, debug|release) {
+    DESTDIR = antiGravity/debug
+}
+CONFIG(release, debug|release) {
+    DESTDIR = antiGravity/release
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * LumoDaemon: headless acquisition (QtCore / QtNetwork / QtSerialPort only).
+ *
+ *   LumoDaemon [--config config.json] [--init init.json]
+ *              [--sensor TYPE,ADDRESS,NUMBER[,PROFILE[,INTERVAL]]]...
+ *              [--publish socket|shm|multicast[:GROUP:PORT]|file:DIR]...
+ *              [--stages transform|raw]
+ *              [--stats S] [--duration S]
+ *
+ * Sensors come from --sensor, else from init.json: its "sensors" array
+ * ({ name, commType, ip, port, model, interval, virtualHz }), else the single
+ * sensor the viewer last used (commType, ip, port, lastModelIndex, interval).
+ * Each sensor runs on its own thread; see CScanSinks.h for the outputs.
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QThread>
+#include <QFile>
+#include <csignal>
+
+#include "CAcqSession.h"
+#include "CScanSinks.h"
+
+namespace {
+
+volatile std::sig_atomic_t g_quit = 0;
+
+struct SensorSpec {
+    QString name;
+    int profile;
+    CAcqSession::Link link;
+};
+
+// init.json entry (viewer keys) -> sensor.
+SensorSpec fromSettings(const QJsonObject& s, int index, int defaultProfile)
+{
+    SensorSpec spec;
+    spec.link.commType = s["commType"].toString("TCP").toUpper();
+    spec.link.address = (spec.link.commType == "REPLAY" && s.contains("replayFile"))
+        ? s["replayFile"].toString() : s["ip"].toString("127.0.0.1");
+    spec.link.number = s["port"].toVariant().toInt();
+    if (spec.link.commType == "COM") spec.link.number = s["baud"].toVariant().toInt();
+    spec.link.intervalMs = s["interval"].toVariant().toInt();
+    if (spec.link.intervalMs <= 0) spec.link.intervalMs = 100;
+    spec.link.virtualHz = s["virtualHz"].toDouble(20);
+    spec.profile = s.contains("model") ? s["model"].toInt() : s["lastModelIndex"].toInt(defaultProfile);
+    spec.name = s["name"].toString(QString("sensor%1").arg(index));
+    return spec;
+}
+
+// TYPE,ADDRESS,NUMBER[,PROFILE[,INTERVAL]]
+bool fromArgument(const QString& arg, int index, SensorSpec* spec)
+{
+    QStringList f = arg.split(',');
+    if (f.size() < 3) return false;
+    spec->link.commType = f[0].toUpper();
+    spec->link.address = f[1];
+    spec->link.number = f[2].toInt();
+    spec->profile = f.value(3, "0").toInt();
+    spec->link.intervalMs = f.value(4, "100").toInt();
+    spec->name = QString("sensor%1").arg(index);
+    return true;
+}
+
+// VmRSS on Linux, -1 elsewhere.
+qint64 residentKb()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text)) return -1;
+    for (const QByteArray& line : status.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+    }
+    return -1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QElapsedTimer startup;
+    startup.start();
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("LumoDaemon");
+    QTextStream out(stdout);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("LumoMap headless acquisition");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "config", "LiDAR profile file.", "path", "config.json" },
+        { "init", "Viewer settings (sensor list).", "path", "init.json" },
+        { "sensor", "TYPE,ADDRESS,NUMBER[,PROFILE[,INTERVAL]]; TYPE = TCP, UDP, COM, VIRTUAL or REPLAY.", "spec" },
+        { "publish", "socket, shm, multicast[:GROUP:PORT] or file:DIR (repeatable).", "sink" },
+        { "shm-slots", "Scans kept in each shared-memory ring.", "count", "64" },
+        { "mcast-ttl", "Multicast hops (1 = local segment).", "ttl", "1" },
+        { "mcast-interface", "Multicast from this interface (e.g. lo).", "name" },
+        { "mcast-datagram", "Largest datagram, bytes.", "bytes", QString::number(ScanMulticast::DEFAULT_DATAGRAM_BYTES) },
+        { "stages", "transform (decode to meters) or raw (payload only).", "stages", "transform" },
+        { "stats", "Print totals every S seconds, 0 = never.", "s", "10" },
+        { "duration", "Stop after S seconds, 0 = run until interrupted.", "s", "0" },
+    });
+    parser.process(app);
+
+    QJsonArray types = LidarConfig::loadTypes(parser.value("config"));
+    if (types.isEmpty()) types = LidarConfig::defaultTypes();
+
+    QVector<SensorSpec> specs;
+    for (const QString& arg : parser.values("sensor")) {
+        SensorSpec spec;
+        if (!fromArgument(arg, specs.size(), &spec)) {
+            out << "Invalid --sensor " << arg << Qt::endl;
+            return 1;
+        }
+        specs.append(spec);
+    }
+    if (specs.isEmpty()) {
+        QFile file(parser.value("init"));
+        QJsonObject init = file.open(QIODevice::ReadOnly) ? QJsonDocument::fromJson(file.readAll()).object() : QJsonObject();
+        if (init["sensors"].isArray()) {
+            for (const QJsonValue& v : init["sensors"].toArray()) specs.append(fromSettings(v.toObject(), specs.size(), 0));
+        }
+        else if (!init.isEmpty()) {
+            specs.append(fromSettings(init, 0, 0));
+        }
+    }
+    if (specs.isEmpty()) {
+        out << "No sensors: use --sensor or an init.json" << Qt::endl;
+        return 1;
+    }
+
+    QStringList publish = parser.values("publish");
+    if (publish.isEmpty()) publish << "socket";
+    const bool transform = parser.value("stages") != "raw";
+
+    // nullptr for an invalid spec
+    auto makeSink = [&](const QString& p) -> std::shared_ptr<IScanSink> {
+        if (p == "socket") return std::make_shared<CLocalSocketSink>();
+        if (p == "shm") return std::make_shared<CShmSink>(parser.value("shm-slots").toInt());
+        if (p.startsWith("file:")) return std::make_shared<CRecordSink>(p.mid(5));
+        if (p == "multicast" || p.startsWith("multicast:")) {
+            // one group for all sensors; receivers tell them apart by the sensor field
+            QStringList f = p.split(':');
+            QHostAddress group(f.value(1, ScanMulticast::defaultGroup().toString()));
+            quint16 port = quint16(f.value(2, QString::number(ScanMulticast::DEFAULT_PORT)).toUInt());
+            if (!group.isMulticast() || !port) return nullptr;
+            return std::make_shared<CMulticastSink>(group, port, parser.value("mcast-ttl").toInt(),
+                parser.value("mcast-datagram").toInt(), parser.value("mcast-interface"));
+        }
+        return nullptr;
+    };
+    for (const QString& p : publish) {
+        if (!makeSink(p)) {
+            out << "Invalid --publish " << p << Qt::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::unique_ptr<QThread>> threads;
+    QVector<CAcqSession*> sessions;
+    for (int i = 0; i < specs.size(); ++i) {
+        const SensorSpec& spec = specs[i];
+        LidarConfig cfg = LidarConfig::fromJson(types[qBound(0, spec.profile, types.count() - 1)].toObject());
+        CAcqSession* session = new CAcqSession(i, spec.name, cfg, spec.link);
+        session->setTransform(transform);
+        for (const QString& p : publish) session->addSink(makeSink(p));
+
+        threads.emplace_back(new QThread);
+        threads.back()->setObjectName(spec.name);
+        session->moveToThread(threads.back().get());
+        QObject::connect(threads.back().get(), &QThread::finished, session, &QObject::deleteLater);
+        threads.back()->start();
+        QMetaObject::invokeMethod(session, "start", Qt::QueuedConnection);
+        sessions.append(session);
+
+        out << QString("%1: %2 %3:%4 '%5', every %6 ms -> %7").arg(spec.name).arg(spec.link.commType)
+            .arg(spec.link.address).arg(spec.link.number).arg(cfg.name).arg(spec.link.intervalMs)
+            .arg(publish.join(", ")) << Qt::endl;
+    }
+    out << QString("Ready in %1 ms, %2 KB resident").arg(startup.elapsed()).arg(residentKb()) << Qt::endl;
+
+    // Totals since the last report
+    QVector<quint64> lastScans(sessions.size(), 0);
+    QElapsedTimer interval;
+    interval.start();
+    QTimer report;
+    QObject::connect(&report, &QTimer::timeout, [&]() {
+        double sec = qMax<qint64>(1, interval.restart()) / 1000.0;
+        for (int i = 0; i < sessions.size(); ++i) {
+            const CAcqSession::Stats& s = sessions[i]->stats();
+            quint64 scans = s.scans.load();
+            out << QString("%1: %2 scans/s, %3 failed, %4 reconnects, %5 MB total")
+                .arg(sessions[i]->name()).arg((scans - lastScans[i]) / sec, 0, 'f', 1)
+                .arg(s.failures.load()).arg(s.reconnects.load()).arg(s.bytes.load() / 1e6, 0, 'f', 1) << Qt::endl;
+            lastScans[i] = scans;
+        }
+        out << QString("%1 KB resident").arg(residentKb()) << Qt::endl;
+    });
+    if (parser.value("stats").toInt() > 0) report.start(parser.value("stats").toInt() * 1000);
+    if (parser.value("duration").toInt() > 0) QTimer::singleShot(parser.value("duration").toInt() * 1000, &app, &QCoreApplication::quit);
+
+    std::signal(SIGINT, [](int) { g_quit = 1; });
+    std::signal(SIGTERM, [](int) { g_quit = 1; });
+    QTimer quitPoll;
+    QObject::connect(&quitPoll, &QTimer::timeout, &app, [&]() { if (g_quit) app.quit(); });
+    quitPoll.start(200);
+
+    int code = app.exec();
+
+    // A scan in progress returns early; each session is deleted on its thread when the loop ends.
+    sessions.clear();
+    for (const std::unique_ptr<QThread>& thread : threads) {
+        thread->requestInterruption();
+        thread->quit();
+    }
+    for (const std::unique_ptr<QThread>& thread : threads) thread->wait();
+    return code;
+}
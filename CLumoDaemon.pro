@@ -0,0 +1,37 @@
+# LumoDaemon: headless acquisition (no widgets), one thread per sensor
+QT += core network concurrent serialport
+QT -= gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+TARGET = LumoDaemon
+
+HEADERS += \
+    CAcqSession.h \
+    CScanSinks.h \
+    CComm.h \
+    CShmScanRing.h \
+    CScanMulticast.h \
+    CCommReplay.h \
+    CCloudPoints.h \
+    CScanIndex.h \
+    CSynthScene.h \
+    CStageTimer.h \
+    CScanRecord.h \
+    CScanCodec.h \
+    CPcapReader.h \
+    CLidarConfig.h \
+    CProtocol.h \
+    crc16.h
+SOURCES += \
+    CComm.cpp \
+    CLumoDaemon.cpp
+win32-msvc*: QMAKE_CXXFLAGS += /utf-8
+unix:!macx: LIBS += -lrt
+
+CONFIG(debug, debug|release) {
+    DESTDIR = antiGravity/debug
+}
+CONFIG(release, debug|release) {
+    DESTDIR = antiGravity/release
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * LumoEmu: emulated LumoMap sensors on one event loop.
+ *
+ *   LumoEmu [--sensors N] [--transport tcp|udp|pty] [--bind ADDR] [--base-port P]
+ *           [--profile N] [--scene scene.json] [--rate HZ] [--input file.lrec|file.pcap[ng]]
+ *           [--latency MS] [--jitter MS] [--loss PERCENT] [--bandwidth KB/s] [--stats S]
+ *
+ * Sensor i listens on base-port + i (tcp/udp) or on its own pty (printed at
+ * start; use it as the Serial port name). All sensors share one scan source.
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <vector>
+
+#include "CEmuDevice.h"
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("LumoEmu");
+    QTextStream out(stdout);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("LumoMap sensor emulator");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "sensors", "Emulated sensors.", "count", "1" },
+        { "transport", "tcp, udp or pty.", "transport", "tcp" },
+        { "bind", "Listen address (tcp/udp).", "address", "127.0.0.1" },
+        { "base-port", "Port of sensor 0; sensor i uses base-port + i.", "port",
+          QString::number(CPcapReader::DEFAULT_PORT) },
+        { "config", "LiDAR profile file.", "path", "config.json" },
+        { "profile", "Profile index in config.json.", "index", "0" },
+        { "scene", "Synthetic scene.", "path", "scene.json" },
+        { "rate", "Scans per second (default: scene or recording rate).", "hz" },
+        { "input", "Serve a recording (.lrec) or capture (.pcap/.pcapng) in a loop.", "path" },
+        { "port", "Sensor UDP port in a capture.", "port", QString::number(CPcapReader::DEFAULT_PORT) },
+        { "latency", "Added reply latency.", "ms", "0" },
+        { "jitter", "Uniform extra latency, 0..ms.", "ms", "0" },
+        { "loss", "Lost replies (datagrams on udp).", "percent", "0" },
+        { "bandwidth", "Link limit per sensor, 0 = unlimited.", "KB/s", "0" },
+        { "mtu", "UDP datagram payload.", "bytes", QString::number(CEmuDevice::DEFAULT_DATAGRAM_BYTES) },
+        { "stats", "Print totals every S seconds, 0 = never.", "s", "5" },
+    });
+    parser.process(app);
+
+    QJsonArray types = LidarConfig::loadTypes(parser.value("config"));
+    if (types.isEmpty()) types = LidarConfig::defaultTypes();
+    int index = qBound(0, parser.value("profile").toInt(), types.count() - 1);
+    LidarConfig cfg = LidarConfig::fromJson(types[index].toObject());
+
+    CEmuScanSource source;
+    if (parser.isSet("input")) {
+        if (!source.openRecording(parser.value("input"), cfg, (quint16)parser.value("port").toUInt())) {
+            out << "Couldn't open " << parser.value("input") << " (or no scans of '" << cfg.name << "')" << Qt::endl;
+            return 1;
+        }
+    }
+    else {
+        source.openSynth(cfg, CSynthScene::loadScene(parser.value("scene")));
+    }
+    if (parser.isSet("rate")) source.setRate(parser.value("rate").toDouble());
+
+    const QString transportName = parser.value("transport");
+    CEmuDevice::eTransport transport = CEmuDevice::eTransport::tcp;
+    if (transportName == "udp") transport = CEmuDevice::eTransport::udp;
+    else if (transportName == "pty") transport = CEmuDevice::eTransport::pty;
+    else if (transportName != "tcp") {
+        out << "Unknown transport: " << transportName << Qt::endl;
+        return 1;
+    }
+
+    CEmuDevice::Impairment imp;
+    imp.latencyMs = qMax(0, parser.value("latency").toInt());
+    imp.jitterMs = qMax(0, parser.value("jitter").toInt());
+    imp.loss = qBound(0.0, parser.value("loss").toDouble() / 100.0, 1.0);
+    imp.bandwidth = qMax<qint64>(0, parser.value("bandwidth").toLongLong() * 1024);
+
+    const int sensors = qMax(1, parser.value("sensors").toInt());
+    const QHostAddress address(parser.value("bind"));
+    const int basePort = parser.value("base-port").toInt();
+    if (transport != CEmuDevice::eTransport::pty && basePort + sensors - 1 > 65535) {
+        out << "Ports " << basePort << ".." << basePort + sensors - 1 << " out of range" << Qt::endl;
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<CEmuDevice>> devices;
+    devices.reserve(sensors);
+    for (int i = 0; i < sensors; ++i) {
+        devices.emplace_back(new CEmuDevice(i, &source));
+        CEmuDevice* device = devices.back().get();
+        device->setImpairment(imp);
+        device->setDatagramBytes(parser.value("mtu").toInt());
+        if (!device->listen(transport, address, quint16(basePort + i))) {
+            out << "Sensor " << i << ": " << device->errorString() << Qt::endl;
+            return 1;
+        }
+        out << "Sensor " << i << ": " << transportName << " " << device->endpoint() << Qt::endl;
+    }
+    out << QString("'%1', %2 words/scan at %3 Hz, %4 sensor(s)")
+        .arg(cfg.name).arg(source.reqWordSize()).arg(source.rate(), 0, 'f', 1).arg(sensors) << Qt::endl;
+
+    // Totals since the last report
+    CEmuDevice::Stats last;
+    QElapsedTimer interval;
+    interval.start();
+    QTimer report;
+    QObject::connect(&report, &QTimer::timeout, [&]() {
+        CEmuDevice::Stats total;
+        int clients = 0;
+        for (const auto& device : devices) {
+            const CEmuDevice::Stats& s = device->stats();
+            total.requests += s.requests;
+            total.replies += s.replies;
+            total.dropped += s.dropped;
+            total.badRequests += s.badRequests;
+            total.bytesOut += s.bytesOut;
+            clients += device->clients();
+        }
+        double sec = qMax<qint64>(1, interval.restart()) / 1000.0;
+        out << QString("%1 req/s, %2 replies/s, %3 MB/s, %4 dropped, %5 bad, %6 tcp clients")
+            .arg((total.requests - last.requests) / sec, 0, 'f', 0)
+            .arg((total.replies - last.replies) / sec, 0, 'f', 0)
+            .arg((total.bytesOut - last.bytesOut) / sec / (1024.0 * 1024.0), 0, 'f', 2)
+            .arg(total.dropped - last.dropped)
+            .arg(total.badRequests - last.badRequests)
+            .arg(clients) << Qt::endl;
+        last = total;
+    });
+    if (parser.value("stats").toInt() > 0) report.start(parser.value("stats").toInt() * 1000);
+
+    return app.exec();
+}
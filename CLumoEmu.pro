@@ -0,0 +1,27 @@
+# LumoEmu: emulated sensors (TCP / UDP / pty) for testing and scaling benchmarks
+QT += core network
+QT -= gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+TARGET = LumoEmu
+
+HEADERS += \
+    CEmuDevice.h \
+    CSynthScene.h \
+    CScanRecord.h \
+    CScanCodec.h \
+    CPcapReader.h \
+    CLidarConfig.h \
+    CProtocol.h \
+    crc16.h
+SOURCES += \
+    CLumoEmu.cpp
+win32-msvc*: QMAKE_CXXFLAGS += /utf-8
+
+CONFIG(debug, debug|release) {
+    DESTDIR = antiGravity/debug
+}
+CONFIG(release, debug|release) {
+    DESTDIR = antiGravity/release
+}
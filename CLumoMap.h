@@ -23,172 +23,216 @@
 #include <QString>
 #include <QMap>
 
+#include "CMapRenderer.h"
+#include "CRenderGovernor.h"
+#include "CStageTimer.h"
+
 class CLumoMap : public QWidget
 {
     Q_OBJECT
 
 public:
 
-    struct HighlightData {
-        QPointF pos;
-        bool active;
-    };
+    typedef CMapRenderer::HighlightData HighlightData;
+    typedef CMapRenderer::ePersistence ePersistence;
+    typedef CMapRenderer::eRasterBackend eRasterBackend;
+    typedef CMapRenderer::eQuality eQuality;
+    enum { MAX_TRAIL_LENGTH = CMapRenderer::MAX_TRAIL_LENGTH };
 
     CLumoMap(QWidget* parent, int channels, int fov, float resolution)
-        : QWidget(parent), m_fov(fov), m_channels(channels), m_resolution(resolution)
+        : QWidget(parent), m_map(channels, fov, resolution),
+          m_governor(CMapRenderer::MAX_QUALITY_LEVEL)
     {
         setMouseTracking(true);
         setAttribute(Qt::WA_OpaquePaintEvent);
         setMinimumSize(800, 600);
         setCursor(Qt::CrossCursor);
 
-        penThin = QPen(lineThin.color, lineThin.thickness, lineThin.pattern);
-        penThick = QPen(lineThick.color, lineThick.thickness, lineThick.pattern);
-        penGrid = QPen(lineThin.color, lineThin.thickness, lineThick.pattern);
-        penFoV = QPen(Qt::darkRed, 1.0, Qt::SolidLine);
-        penHighlight = QPen(Qt::yellow, 2.0, Qt::SolidLine);
-
-        m_currentScanIndex = 0;
-
-        m_fadeEnabled = true;
-        m_angleOffset = 0.0f;
-        m_isClockwise = true;
-        m_distanceUnit = "cm";
+        // The decay trail fades per displayed frame, not per scan: it keeps fading between
+        // scans and after acquisition stops. Runs only while something is fading.
+        m_trailTimer.setInterval(CMapRenderer::TRAIL_TICK_MS);
+        connect(&m_trailTimer, &QTimer::timeout, this, [this]() {
+            QElapsedTimer workTimer;
+            workTimer.start();
+            if (m_map.advanceTrail()) {
+                m_frameWorkNs += workTimer.nsecsElapsed();
+                QWidget::update(m_map.takeDirtyRegion());
+            }
+            if (!m_map.hasTrail()) m_trailTimer.stop();
+        });
     }
     ~CLumoMap() {}
 
     void lumos(const QVector<QPointF>& newScan)
     {
-        if (m_fadeEnabled) {
-            m_currentScanIndex = (m_currentScanIndex + 1) % 3;
+        QElapsedTimer workTimer;
+        workTimer.start();
+        m_map.lumos(newScan);
+        m_frameWorkNs += workTimer.nsecsElapsed();
+        if (m_map.hasTrail() && !m_trailTimer.isActive()) m_trailTimer.start();
+
+        if (m_hoverActive) {
+            updateHover(m_hoverMousePos);
         }
-        else {
-            m_currentScanIndex = 0;
-            m_scanBuffer[1].clear();
-            m_scanBuffer[2].clear();
-        }
-        m_scanBuffer[m_currentScanIndex] = newScan;
 
-        QWidget::update();
+        // Only the area of the previous and new scans; the backing store keeps the rest.
+        QWidget::update(m_map.takeDirtyRegion());
         QCoreApplication::processEvents();
     }
 
     void setSettings(float pixelsPerMeter, int maxConcCircles)
     {
-        m_pixelsPerMeter = pixelsPerMeter;
-        m_maxConcCircles = maxConcCircles;
+        m_map.setSettings(pixelsPerMeter, maxConcCircles);
         QWidget::update();
     }
 
     void setHardwareProfile(int channels, int fov, float resolution) {
-        m_channels = channels;
-        m_fov = fov;
-        m_resolution = resolution;
+        m_map.setHardwareProfile(channels, fov, resolution);
     }
 
     void setMapOrientation(float angleOffset, bool isCCW)
     {
-        m_angleOffset = angleOffset;
-        m_isClockwise = isCCW;
+        m_map.setMapOrientation(angleOffset, isCCW);
     }
 
     void setFadeEnabled(bool enabled)
     {
-        m_fadeEnabled = enabled;
+        m_map.setFadeEnabled(enabled);
+        update();
+    }
+
+    void setPersistence(ePersistence mode)
+    {
+        m_map.setPersistence(mode);
+        update();
+    }
+
+    void setTrailLength(int scans)
+    {
+        m_map.setTrailLength(scans);
+    }
+
+    int getTrailLength() const { return m_map.getTrailLength(); }
+
+    void setRasterBackend(eRasterBackend backend)
+    {
+        m_map.setRasterBackend(backend);
         update();
     }
 
+    void setRasterThreads(int threads) {
+        m_map.setRasterThreads(threads);
+    }
+
     void setDistanceUnit(const QString& unit) {
-        m_distanceUnit = unit;
+        m_map.setDistanceUnit(unit);
     }
 
-    void setHighlight(QPointF pos, Qt::GlobalColor color)
+    // Quality governor: frame time above the budget lowers quality, headroom restores it.
+    void setAutoQuality(bool enabled)
     {
-        HighlightData data;
-        data.pos = pos;
-        data.active = true;
+        m_governor.setEnabled(enabled);
+        m_map.setQuality(eQuality::full);
+        update();
+    }
+
+    bool autoQuality() const { return m_governor.isEnabled(); }
 
-        m_highlights.insert(color, data);
+    void setFrameBudget(float ms) {
+        m_governor.setBudget(ms);
+    }
+
+    static QString qualityName(int level)
+    {
+        static const char* names[] = { "Full", "No AA", "No Trail", "Decimated" };
+        return names[qBound(0, level, (int)CMapRenderer::MAX_QUALITY_LEVEL)];
+    }
+
+    void setScanIndex(const CScanIndex* index) {
+        m_map.setScanIndex(index);
+    }
+
+    void setHighlight(QPointF pos, Qt::GlobalColor color)
+    {
+        m_map.setHighlight(pos, color);
         update();
     }
 
     void visibleHighlight(Qt::GlobalColor color, bool visible)
     {
-        if (m_highlights.contains(color)) {
-            m_highlights[color].active = visible;
-            update();
-        }
+        m_map.visibleHighlight(color, visible);
+        update();
     }
 
     void clearHighlights() {
-        m_highlights.clear();
+        m_map.clearHighlights();
         update();
     }
 
     void fadeAway(bool fadeEnabled) {
-        if (!fadeEnabled) {
-            onClearPoints();
-        }
-        else {
-            m_currentScanIndex = (m_currentScanIndex + 1) % 3;
-            m_scanBuffer[m_currentScanIndex].clear();
-            update();
-        }
+        QElapsedTimer workTimer;
+        workTimer.start();
+        m_map.fadeAway(fadeEnabled);
+        m_frameWorkNs += workTimer.nsecsElapsed();
+        if (m_map.hasTrail() && !m_trailTimer.isActive()) m_trailTimer.start();
+        update();
     }
 
     void setVisibleLayer(int layerIndex, bool value) {
-        m_visibleLayer[layerIndex] = value;
+        m_map.setVisibleLayer(layerIndex, value);
         update();
     }
 
-    float getZoomRate() const { return m_zoomRate; }
+    float getZoomRate() const { return m_map.getZoomRate(); }
     void setZoomRate(float rate) {
-        m_zoomRate = rate;
-        penThin = QPen(lineThin.color, lineThin.thickness / m_zoomRate, lineThin.pattern);
-        penThick = QPen(lineThick.color, lineThick.thickness / m_zoomRate, lineThick.pattern);
-        penGrid = QPen(lineThin.color, lineThin.thickness / m_zoomRate, lineThick.pattern);
-        penFoV = QPen(penFoV.color(), 1.0 / m_zoomRate, penFoV.style());
-        penHighlight.setWidthF(2.0 / m_zoomRate);
+        m_map.setZoomRate(rate);
         update();
     }
 
-    QPointF getCenterOffset() const { return m_centerOffset; }
+    QPointF getCenterOffset() const { return m_map.getCenterOffset(); }
     void setCenterOffset(const QPointF& offset) {
-        m_centerOffset = offset;
+        m_map.setCenterOffset(offset);
         update();
     }
 
+signals:
+    void pointPicked(int row);
+    // Quality level and frame times (average, decaying peak), at most twice a second.
+    void renderStats(int level, float avgMs, float peakMs);
+
 public slots:
     void onClearPoints() {
-        m_scanBuffer[0].clear();
-        m_scanBuffer[1].clear();
-        m_scanBuffer[2].clear();
+        m_map.clearPoints();
         update();
     }
 
 protected:
-    typedef struct distanceInfo {
-        QString info;
-        QRect textRect;
-    } distanceInfo;
-
     void paintEvent(QPaintEvent* event) override
     {
-        Q_UNUSED(event);
+        CStageScope timing(CStageTimer::eStage::paint);
+        QElapsedTimer paintTimer;
+        paintTimer.start();
 
         QPainter painter(this);
-        painter.setRenderHint(QPainter::Antialiasing, true);
-        painter.fillRect(rect(), Qt::black);
-
-        painter.translate(m_centerPoint + m_centerOffset);
-        painter.scale(m_zoomRate, m_zoomRate);
-
-        drawCrosshair(painter);
-        drawConcCircles(painter);
-        drawFieldOfView(painter);
-        drawLidarPoints(painter);
-        drawHighlight(painter);
-        drawInfo();
+        m_map.render(painter, event->rect());
+
+        // Frame time = scan work since the last paint (decay, splat) + this paint. A partial
+        // repaint is scaled up to the widget area (at most MAX_PARTIAL_SCALE times), so
+        // small dirty rects don't read as headroom.
+        const qint64 area = qint64(width()) * height();
+        const qint64 painted = qint64(event->rect().width()) * event->rect().height();
+        const double scale = (painted > 0 && painted < area) ? qMin<double>(MAX_PARTIAL_SCALE, double(area) / painted) : 1.0;
+        const float frameMs = float((m_frameWorkNs + paintTimer.nsecsElapsed() * scale) / 1e6);
+        m_frameWorkNs = 0;
+
+        // The new level takes effect from the next frame.
+        if (m_governor.addSample(frameMs)) {
+            m_map.setQuality((eQuality)m_governor.level());
+        }
+        if (!m_statsTimer.isValid() || m_statsTimer.elapsed() >= 500) {
+            m_statsTimer.start();
+            emit renderStats(m_governor.level(), m_governor.averageMs(), m_governor.peakMs());
+        }
     }
 
     void mousePressEvent(QMouseEvent* event) override
@@ -200,19 +244,24 @@ protected:
 
     void mouseMoveEvent(QMouseEvent* event) override
     {
-        if ((event->buttons() & Qt::LeftButton) == 0)
+        if ((event->buttons() & Qt::LeftButton) == 0) {
+            m_hoverActive = true;
+            m_hoverMousePos = event->pos();
+            if (updateHover(m_hoverMousePos))
+                update();
             return;
+        }
 
         QPoint currPos = event->pos();
         if (currPos.x() == m_lastMousePos.x() && currPos.y() == m_lastMousePos.y())
             return;
 
-        m_centerOffset += (currPos - m_lastMousePos);
+        m_map.setCenterOffset(m_map.getCenterOffset() + (currPos - m_lastMousePos));
         m_lastMousePos = currPos;
         update();
     }
 
-    void mouseReleaseEvent(QMouseEvent* event) override 
+    void mouseReleaseEvent(QMouseEvent* event) override
     {
         if (event->button() == Qt::LeftButton) {
             if (m_mousePressPos == m_lastMousePos) {
@@ -222,16 +271,28 @@ protected:
         }
     }
 
+    void leaveEvent(QEvent* event) override
+    {
+        Q_UNUSED(event);
+        m_hoverActive = false;
+        if (m_map.hoverRow() >= 0) {
+            m_map.setHoverRow(-1);
+            m_map.hoverInfo().info = "";
+            update();
+        }
+    }
+
     void wheelEvent(QWheelEvent* event) override
     {
         float numSteps = event->delta() / (8.0f * 20.0f);
         float scaleFactor = std::pow(1.125f, numSteps);
 
         QPointF mousePos = event->position();
-        QPointF scenePos = (mousePos - (m_centerPoint + m_centerOffset)) / m_zoomRate;
+        QPointF scenePos = m_map.mapToScene(mousePos);
 
-        float newZoomRate = m_zoomRate * scaleFactor;
-        QPointF newOffset = mousePos - (scenePos * newZoomRate) - m_centerPoint;
+        float newZoomRate = m_map.getZoomRate() * scaleFactor;
+        QPointF centerPoint = QPointF(width() / 2, height() / 2);
+        QPointF newOffset = mousePos - (scenePos * newZoomRate) - centerPoint;
 
         setCenterOffset(newOffset);
         setZoomRate(newZoomRate);
@@ -241,252 +302,69 @@ protected:
 
     void resizeEvent(QResizeEvent* event) override
     {
-        m_centerPoint = QPointF(width() / 2, height() / 2);
+        Q_UNUSED(event);
+        m_map.setViewportSize(size());
         update();
     }
 
 private:
 
-    QColor channelColor[5][3] = {
-        // Ch 1: Green
-        {QColor(0, 255, 0, 255),   QColor(0, 255, 0, 120),   QColor(0, 255, 0, 80)},
-        // Ch 2: Yellow
-        {QColor(255, 255, 0, 255), QColor(255, 255, 0, 120), QColor(255, 255, 0, 80)},
-        // Ch 3: Cyan
-        {QColor(0, 255, 255, 255), QColor(0, 255, 255, 120), QColor(0, 255, 255, 80)},
-        // Ch 4: Magenta
-        {QColor(255, 0, 255, 255), QColor(255, 0, 255, 120), QColor(255, 0, 255, 80)},
-        // Ch 5: Red
-        {QColor(255, 0, 0, 255),   QColor(255, 0, 0, 120),   QColor(255, 0, 0, 80)},
-    };
-
-    void drawLidarPoints(QPainter& painter)
-    {
-        const QVector<QPointF>& scan1 = m_scanBuffer[m_currentScanIndex];
-
-        if (!m_fadeEnabled) {
-            drawScan(painter, scan1, 0);
-            return;
-        }
-
-        const QVector<QPointF>& scan2 = m_scanBuffer[(m_currentScanIndex + 2) % 3];
-        const QVector<QPointF>& scan3 = m_scanBuffer[(m_currentScanIndex + 1) % 3];
-
-        drawScan(painter, scan3, 2);
-        drawScan(painter, scan2, 1);
-        drawScan(painter, scan1, 0);
-    }
-
-    void drawScan(QPainter& painter, const QVector<QPointF>& scan, int colorStep)
+    bool updateHover(const QPointF& mousePos)
     {
-        if (scan.isEmpty()) return;
+        int row = m_map.pickPoint(m_map.mapToScene(mousePos));
+        if (row == m_map.hoverRow()) return false;
 
-        if (m_channels == 1) {
-            painter.setPen(QPen(channelColor[0][colorStep], m_PointSize / m_zoomRate));
-            for (const QPointF& point : qAsConst(scan)) {
-                painter.drawPoint(point);
-            }
+        m_map.setHoverRow(row);
+        if (row >= 0) {
+            const CScanIndex::Entry& e = m_map.scanIndex()->entry(row);
+            m_map.hoverInfo().info = m_map.pointInfo(QPointF(e.x, e.y), row);
         }
         else {
-            int channel = 1;
-            for (const QPointF& point : qAsConst(scan)) {
-                if (m_visibleLayer[channel - 1]) {
-                    painter.setPen(QPen(channelColor[channel - 1][colorStep], m_PointSize / m_zoomRate));
-                    painter.drawPoint(point);
-                }
-                channel++;
-                if (channel > m_channels) channel = 1;
-            }
-        }
-    }
-
-
-    void drawCrosshair(QPainter& painter)
-    {
-        painter.setPen(penGrid);
-        qreal absX = abs(m_centerOffset.x());
-        qreal absY = abs(m_centerOffset.y());
-        qreal absW = absX >= absY ? absX : absY;
-        float m_sceneSizeMax = (absW + width()) / m_zoomRate;
-
-        painter.drawLine(-m_sceneSizeMax, 0, m_sceneSizeMax, 0);
-        painter.drawLine(0, -m_sceneSizeMax, 0, m_sceneSizeMax);
-    }
-
-    void drawFieldOfView(QPainter& painter)
-    {
-        painter.setPen(penFoV);
-
-        qreal absX = abs(m_centerOffset.x());
-        qreal absY = abs(m_centerOffset.y());
-        qreal absW = absX >= absY ? absX : absY;
-        float sceneSize = (absW + width()) / m_zoomRate;
-        if ((absW + height()) / m_zoomRate > sceneSize)
-            sceneSize = (absW + height()) / m_zoomRate;
-
-        float radStart = m_angleOffset * M_PI / 180.0;
-        float x1 = sceneSize * std::cos(radStart);
-        float y1 = -sceneSize * std::sin(radStart);
-        painter.drawLine(QPointF(0, 0), QPointF(x1, y1));
-
-        if (m_fov < 360) {
-            float endAngle = m_isClockwise ? (m_angleOffset - m_fov) : (m_angleOffset + m_fov);
-            float radEnd = endAngle * M_PI / 180.0;
-            float x2 = sceneSize * std::cos(radEnd);
-            float y2 = -sceneSize * std::sin(radEnd);
-            painter.drawLine(QPointF(0, 0), QPointF(x2, y2));
-        }
-    }
-
-    void drawHighlight(QPainter& painter)
-    {
-        if (m_highlights.isEmpty()) return;
-
-        float crossSize = 10.0f / m_zoomRate;
-
-        QMapIterator<Qt::GlobalColor, HighlightData> i(m_highlights);
-        while (i.hasNext()) {
-            i.next();
-            const HighlightData& data = i.value();
-
-            if (!data.active) continue;
-
-            // ŸԺ   (  )
-            penHighlight.setColor(i.key());
-            penHighlight.setWidthF(2.0 / m_zoomRate);
-            painter.setPen(penHighlight);
-
-            painter.drawLine(data.pos - QPointF(crossSize, 0), data.pos + QPointF(crossSize, 0));
-            painter.drawLine(data.pos - QPointF(0, crossSize), data.pos + QPointF(0, crossSize));
-        }
-    }
-
-    void drawConcCircles(QPainter& painter)
-    {
-        qreal absX = abs(m_centerOffset.x());
-        qreal absY = abs(m_centerOffset.y());
-        qreal absW = absX >= absY ? absX : absY;
-        float sceneSize = (absW + width()) / m_zoomRate;
-        if ((absW + height()) / m_zoomRate > sceneSize)
-            sceneSize = (absW + height()) / m_zoomRate;
-
-        int maxVisibleMeter = (int)(sceneSize / m_pixelsPerMeter) + 1;
-
-        for (int i = 1; i <= maxVisibleMeter; ++i) {
-            float radius = i * m_pixelsPerMeter;
-            int gridType = (i % m_concCircleStep);
-
-            if (gridType == 0) {
-                painter.setPen(penThick);
-            }
-            else if (i <= m_maxConcCircles) {
-                painter.setPen(penThin);
-            }
-            else {
-                continue;
-            }
-
-            painter.drawEllipse(QPointF(0, 0), radius, radius);
+            m_map.hoverInfo().info = "";
         }
+        return true;
     }
 
     void makeInfo(QPointF mousePos, QMouseEvent* event)
     {
-        QPointF sceneMousePos = (mousePos - (m_centerPoint + m_centerOffset)) / m_zoomRate;
-        float dx = sceneMousePos.x();
-        float dy = sceneMousePos.y();
-        float distance = std::sqrt(dx * dx + dy * dy);
-
-        float mapAngle = std::atan2(-dy, dx) * 180.0 / M_PI;
-
-        float rawAngle = mapAngle - m_angleOffset;
-        if (m_isClockwise) rawAngle = -rawAngle;
-
-        float distMeter = distance / m_pixelsPerMeter;
-        float distValue = distMeter;
-
-        if (m_distanceUnit == "cm") distValue *= 100.0f;
-        else if (m_distanceUnit == "mm") distValue *= 1000.0f;
+        QPointF sceneMousePos = m_map.mapToScene(mousePos);
+        int row = m_map.pickPoint(sceneMousePos);
+        if (row >= 0) {
+            const CScanIndex::Entry& e = m_map.scanIndex()->entry(row);
+            sceneMousePos = QPointF(e.x, e.y);
+        }
 
-        distanceInfo* distInfo;
+        CMapRenderer::distanceInfo* distInfo;
         if (event->modifiers() == Qt::ControlModifier) {
-            distInfo = &fixedInfo;
+            distInfo = &m_map.fixedInfo();
             setHighlight(sceneMousePos, Qt::yellow);
         }
         else if (event->modifiers() == Qt::NoModifier) {
-            distInfo = &nomalInfo;
+            distInfo = &m_map.normalInfo();
         }
         else {
-            fixedInfo.info = "";
-            nomalInfo.info = "";
+            m_map.fixedInfo().info = "";
+            m_map.normalInfo().info = "";
             clearHighlights();
             return;
         }
-        distInfo->info = QString("Dist: %1 %2\nAngle: %3\u00B0")
-            .arg(QLocale(QLocale::English).toString(distValue, 'f', 1))
-            .arg(m_distanceUnit)
-            .arg(QLocale(QLocale::English).toString(rawAngle, 'f', 2));
-    }
-
-    void drawInfo()
-    {
-        QPainter painter(this);
-        QRect textRect;
-        painter.setRenderHint(QPainter::Antialiasing);
-        painter.setFont(QFont("Arial", 12));
-        QTextOption textOption;
-        textOption.setWrapMode(QTextOption::WordWrap);
-
-        if (nomalInfo.info.length()) {
-            painter.setPen(Qt::white);
-            textRect = QRect(10, 10, 200, 60);
-            painter.drawText(textRect, nomalInfo.info, textOption);
-        }
-        if (fixedInfo.info.length()) {
-            painter.setPen(Qt::yellow);
-            textRect = QRect(10, 60, 200, 100);
-            painter.drawText(textRect, fixedInfo.info, textOption);
+        distInfo->info = m_map.pointInfo(sceneMousePos, row);
+        if (row >= 0) {
+            emit pointPicked(row);
         }
     }
 
-    QVector<QPointF> m_scanBuffer[3];
-    int m_currentScanIndex;
+    enum { MAX_PARTIAL_SCALE = 4 };
+
+    CMapRenderer m_map;
+    CRenderGovernor m_governor;
+    QElapsedTimer m_statsTimer;
+    qint64 m_frameWorkNs = 0;
+    QTimer m_trailTimer;
 
-    bool    m_visibleLayer[8];
-    QPointF m_centerOffset;
-    QPointF m_centerPoint;
     QPointF m_lastMousePos;
     QPointF m_mousePressPos;
-    int     m_PointSize = 2;
-
-    float   m_zoomRate = 1.000f;
-    float   m_pixelsPerMeter = 100.0f;
-    int     m_maxConcCircles = 100;
-    int     m_concCircleStep = 5;
-    int     m_channels = 1;
-    int     m_fov = 360;
-    float   m_resolution = 0.3f;
-
-    struct lineInfo {
-        double thickness;
-        Qt::GlobalColor color;
-        Qt::PenStyle pattern;
-    };
-    lineInfo lineThin = { 0.5, Qt::gray, Qt::SolidLine };
-    lineInfo lineThick = { 1, Qt::darkRed, Qt::SolidLine };
-    QPen penThin;
-    QPen penThick;
-    QPen penGrid;
-    QPen penFoV;
-    distanceInfo nomalInfo, fixedInfo;
-
-    QPen penHighlight;
-
-    QMap<Qt::GlobalColor, HighlightData> m_highlights;
-    bool    m_isHighlightActive; // (  Data.active )
-
-    bool  m_fadeEnabled;
-    float m_angleOffset;
-    bool  m_isClockwise;
-    QString m_distanceUnit;
-};
\ No newline at end of file
+
+    bool    m_hoverActive = false;
+    QPointF m_hoverMousePos;
+};
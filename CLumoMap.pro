@@ -14,7 +14,27 @@ HEADERS += \
     CMainWin.h \
     CProtocol.h \
     crc16.h \
-    CCopyTableWidget.h
+    CCopyTableWidget.h \
+    CPointRaster.h \
+    CScanIndex.h \
+    CLidarConfig.h \
+    CMapRenderer.h \
+    CRenderCli.h \
+    CRangeView.h \
+    CRenderGovernor.h \
+    CPointTableModel.h \
+    CPointExport.h \
+    CScanRecord.h \
+    CCommReplay.h \
+    CScanCodec.h \
+    CBlackBox.h \
+    CPcapReader.h \
+    CCloudConvert.h \
+    CSynthScene.h \
+    CStageTimer.h \
+    CPerfPanel.h \
+    CAcqSession.h \
+    CScanFilter.h
 SOURCES += \
            CLumoMap.cpp \
            CComm.cpp \
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * LumoRecv: reference receiver for LumoDaemon --publish multicast.
+ *
+ *   LumoRecv [--group 239.255.76.77] [--port 47800] [--interface lo]
+ *            [--config config.json] [--profile N] [--record DIR]
+ *            [--stats S] [--duration S]
+ *
+ * Reassembles scans, decodes them to points (with the --profile settings)
+ * and prints per sensor: scans/s, lost and bad, KB/s and the wall-clock age
+ * of a scan on arrival. --record DIR writes one .lrec per sensor.
+ *
+ * Loopback test on one host:
+ *   LumoDaemon --sensor VIRTUAL,virtual,0 --publish multicast --mcast-interface lo
+ *   LumoRecv --interface lo
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QDateTime>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDir>
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#include "CScanMulticast.h"
+#include "CCloudPoints.h"
+#include "CLidarConfig.h"
+#include "CProtocol.h"
+#include "CScanRecord.h"
+
+namespace {
+
+struct SensorView {
+    std::unique_ptr<CScanRecorder> recorder;
+    QVector<qint64> ageUs;          // since the last report
+    quint64 points = 0;
+    CScanMulticastReceiver::Stats last;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("LumoRecv");
+    QTextStream out(stdout);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("LumoMap scan multicast receiver");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "group", "Multicast group.", "address", ScanMulticast::defaultGroup().toString() },
+        { "port", "UDP port.", "port", QString::number(ScanMulticast::DEFAULT_PORT) },
+        { "interface", "Join on this interface (e.g. lo).", "name" },
+        { "config", "LiDAR profile file.", "path", "config.json" },
+        { "profile", "Profile used to decode and record.", "index", "0" },
+        { "record", "Write <DIR>/recv<sensor>_yyyyMMdd_hhmmss.lrec.", "dir" },
+        { "stats", "Print totals every S seconds.", "s", "1" },
+        { "duration", "Stop after S seconds, 0 = run until interrupted.", "s", "0" },
+    });
+    parser.process(app);
+
+    QJsonArray types = LidarConfig::loadTypes(parser.value("config"));
+    if (types.isEmpty()) types = LidarConfig::defaultTypes();
+    const LidarConfig cfg = LidarConfig::fromJson(types[qBound(0, parser.value("profile").toInt(), types.count() - 1)].toObject());
+
+    CCloudPoints cloud(nullptr, 1, cfg.mesuresPerScan * cfg.channels);
+    cloud.setOrientation(cfg.angleOffset, cfg.isClockwise);
+    cloud.setDistanceSettings(cfg.distanceRate, cfg.unitToMeter());
+
+    const QString recordDir = parser.value("record");
+    if (!recordDir.isEmpty() && !QDir().mkpath(recordDir)) {
+        out << "Couldn't create " << recordDir << Qt::endl;
+        return 1;
+    }
+
+    std::map<quint16, SensorView> views;
+    CScanMulticastReceiver receiver;
+    receiver.setHandler([&](const ScanMulticast::Scan& scan) {
+        SensorView& view = views[scan.sensor];
+        view.ageUs.append((QDateTime::currentMSecsSinceEpoch() * 1000000LL - scan.epochNs) / 1000);
+
+        if (scan.channels == cfg.channels) {
+            decodeScanPayload(scan.payload, scan.channels, &cloud);
+            view.points += cloud.getPoints().size();
+        }
+
+        if (recordDir.isEmpty()) return;
+        if (!view.recorder) {
+            view.recorder.reset(new CScanRecorder);
+            const QString path = QString("%1/recv%2_%3.lrec").arg(recordDir).arg(scan.sensor)
+                .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
+            if (!view.recorder->open(path, cfg.toJson(), scan.configHash)) out << "Couldn't write " << path << Qt::endl;
+        }
+        QByteArray payload = scan.payload;
+        view.recorder->write(Protocol::pack(Protocol::eCmd::setBulk, 0, 0, quint16(payload.size() / 2), &payload, nullptr),
+            scan.sensor, scan.configHash);
+    });
+
+    QHostAddress group(parser.value("group"));
+    if (!group.isMulticast() || !receiver.open(group, quint16(parser.value("port").toUInt()), parser.value("interface"))) {
+        out << "Couldn't join " << parser.value("group") << ":" << parser.value("port") << Qt::endl;
+        return 1;
+    }
+    out << "Listening on " << group.toString() << ":" << parser.value("port") << Qt::endl;
+
+    QElapsedTimer interval;
+    interval.start();
+    QTimer report;
+    QObject::connect(&report, &QTimer::timeout, [&]() {
+        const double sec = qMax<qint64>(1, interval.restart()) / 1000.0;
+        for (quint16 sensor : receiver.sensors()) {
+            SensorView& view = views[sensor];
+            const CScanMulticastReceiver::Stats s = receiver.stats(sensor);
+            qint64 p50 = 0, p99 = 0;
+            if (!view.ageUs.isEmpty()) {
+                std::sort(view.ageUs.begin(), view.ageUs.end());
+                p50 = view.ageUs[view.ageUs.size() / 2];
+                p99 = view.ageUs[qMin(view.ageUs.size() - 1, view.ageUs.size() * 99 / 100)];
+            }
+            out << QString("sensor %1: %2 scans/s, %3 lost, %4 bad, %5 KB/s, %6 points/scan, age p50 %7 us p99 %8 us")
+                .arg(sensor).arg((s.scans - view.last.scans) / sec, 0, 'f', 1).arg(s.lost).arg(s.bad)
+                .arg((s.bytes - view.last.bytes) / sec / 1024.0, 0, 'f', 1)
+                .arg(s.scans > view.last.scans ? double(view.points) / (s.scans - view.last.scans) : 0.0, 0, 'f', 0)
+                .arg(p50).arg(p99) << Qt::endl;
+            view.last = s;
+            view.ageUs.clear();
+            view.points = 0;
+        }
+    });
+    if (parser.value("stats").toInt() > 0) report.start(parser.value("stats").toInt() * 1000);
+    if (parser.value("duration").toInt() > 0) QTimer::singleShot(parser.value("duration").toInt() * 1000, &app, &QCoreApplication::quit);
+
+    int code = app.exec();
+    for (auto& view : views) {
+        if (view.second.recorder) view.second.recorder->close();
+    }
+    return code;
+}
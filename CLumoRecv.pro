@@ -0,0 +1,27 @@
+# LumoRecv: reference receiver for the scan multicast (LumoDaemon --publish multicast)
+QT += core network
+QT -= gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+TARGET = LumoRecv
+
+HEADERS += \
+    CScanMulticast.h \
+    CCloudPoints.h \
+    CScanIndex.h \
+    CScanRecord.h \
+    CScanCodec.h \
+    CLidarConfig.h \
+    CProtocol.h \
+    crc16.h
+SOURCES += \
+    CLumoRecv.cpp
+win32-msvc*: QMAKE_CXXFLAGS += /utf-8
+
+CONFIG(debug, debug|release) {
+    DESTDIR = antiGravity/debug
+}
+CONFIG(release, debug|release) {
+    DESTDIR = antiGravity/release
+}
@@ -31,6 +31,7 @@
 #include <QPushButton>
 #include <QHeaderView>
 #include <QCheckBox>
+#include <QSpinBox>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -39,38 +40,45 @@
 #include <QDebug>
 #include <QMessageBox>
 #include <QLabel>
+#include <QLineEdit>
+#include <QSlider>
+#include <QFileDialog>
+#include <QDoubleSpinBox>
+#include <QLocalServer>
+#include <QLocalSocket>
 
 #include "CLumoMap.h"
 #include "CCloudPoints.h"
 #include "CComm.h"
 #include "CProtocol.h"
 #include "CCopyTableWidget.h"
-
-
-class CMainWin : public QMainWindow, public ICloudPointGetter {
+#include "CLidarConfig.h"
+#include "CRenderCli.h"
+#include "CRangeView.h"
+#include "CPointTableModel.h"
+#include "CScanRecord.h"
+#include "CCommReplay.h"
+#include "CBlackBox.h"
+#include "CCloudConvert.h"
+#include "CSynthScene.h"
+#include "CStageTimer.h"
+#include "CPerfPanel.h"
+#include "CScanFilter.h"
+#include "CAcqSession.h"
+
+
+class CMainWin : public QMainWindow {
     Q_OBJECT
-        Q_INTERFACES(ICloudPointGetter)
 
 public:
-    // [신규] 설정값 구조체 정의
-    struct LidarConfig {
-        QString name;
-        int channels;
-        int fov;
-        float resolution;
-        bool isClockwise;
-        float angleOffset;
-        float distanceRate;
-        QString distanceUnit;
-        int mesuresPerScan;
-    };
-
     CMainWin(QWidget* parent = nullptr) : QMainWindow(parent) {
 
         loadConfig();
         m_settings = loadAppSettings();
 
         createPointViewerDock();
+        createRangeViewDock();
+        createPerfDock();
         setUI();
 
         int modelIndex = m_settings["lastModelIndex"].toInt(0);
@@ -83,6 +91,11 @@ public:
 
         cloudPoints = new CCloudPoints(this);
         lumoMap = new CLumoMap(this, channels, fov, res);
+        lumoMap->setScanIndex(&cloudPoints->getIndex());
+        connect(lumoMap, &CLumoMap::pointPicked, this, &CMainWin::onMapPointPicked);
+        connect(lumoMap, &CLumoMap::renderStats, this, &CMainWin::onRenderStats);
+        connect(interval, &QLineEdit::textChanged, this, &CMainWin::onIntervalChanged);
+        onIntervalChanged(interval->text());
         
         applyAppSettings(m_settings);
 
@@ -99,28 +112,8 @@ public:
         runRepeat = false;
         if (comm)
             comm->close();
-    }
-
-public:
-    // ICloudPointGetter 구현
-    void clearPoints() override {
-        m_pointTable->clearContents();
-        m_pointTable->setRowCount(0);
-        m_pointTableCaptureRow = 0;
-    }
-
-    void setPoint(quint16 angle, quint16 distance, int layerNo) override {
-        m_pointTable->insertRow(m_pointTableCaptureRow);
-
-        // [수정] Rate 적용하여 단위 값으로 변환 (예: Raw 100 * 0.1 = 10.0 cm)
-        float finalDist = distance * m_curConfig.distanceRate;
-        // 정수면 소수점 없이, 실수면 소수점 1자리 표시
-        int decimals = (m_curConfig.distanceRate == (int)m_curConfig.distanceRate) ? 0 : 1;
-
-        m_pointTable->setItem(m_pointTableCaptureRow, 0, new QTableWidgetItem(QString::number(angle / 100.0, 'f', 2)));
-        m_pointTable->setItem(m_pointTableCaptureRow, 1, new QTableWidgetItem(QString::number(finalDist, 'f', decimals)));
-        m_pointTable->setItem(m_pointTableCaptureRow, 2, new QTableWidgetItem(QString::number(layerNo + 1)));
-        m_pointTableCaptureRow++;
+        m_recorder.close();
+        m_blackBox.waitForDump();
     }
 
 public slots:
@@ -135,6 +128,8 @@ public slots:
             chkCommType->setEnabled(false);
             connStringAction->setEnabled(false);
             connNumAction->setEnabled(false);
+            replayPathAction->setEnabled(false);
+            replayBrowseAction->setEnabled(false);
             lidarCfgsAction->setEnabled(false);
         case Comm::eStatus::ready:
             connStatus->setStyleSheet("color: white; background-color: darkBlue");
@@ -169,6 +164,8 @@ public slots:
             comPortsAction->setEnabled(true);
             connStringAction->setEnabled(true);
             connNumAction->setEnabled(true);
+            replayPathAction->setEnabled(true);
+            replayBrowseAction->setEnabled(true);
             lidarCfgsAction->setEnabled(true);
             this->setWindowTitle("LumoMap");
             break;
@@ -244,26 +241,45 @@ protected slots:
         stopwatch.start();
         if (!comm)
             return;
+        {
+            CStageScope scanTiming(CStageTimer::eStage::scan);
 
-        if (comm->inbox()) {
-            qDebug() << "What!!!!!!!!!!!!!!!!!!!!";
-            comm->recv(buff, 0);
-            buff.clear();
-            goto DoAgain;
-        }
+            if (comm->inbox()) {
+                qDebug() << "What!!!!!!!!!!!!!!!!!!!!";
+                comm->recv(buff, 0);
+                buff.clear();
+                goto DoAgain;
+            }
 
-        onAlert(nullptr, 0, "");
-        bool isOK = false;
+            onAlert(nullptr, 0, "");
+            bool isOK = false;
 
-        isOK = runProtocol(Protocol::eCmd::getBulk, true, true, 4, 0, reqWrdSize, &buff);
+            isOK = runProtocol(Protocol::eCmd::getBulk, true, true, 4, 0, reqWrdSize, &buff);
 
-        if (!isOK) {
-            lumoMap->fadeAway(m_fadeEnabled);
-        }
-        else {
-            processPayload(buff, cloudPoints);
-            lumoMap->lumos(cloudPoints->getPoints());
-        }
+            if (!isOK) {
+                lumoMap->fadeAway(m_fadeEnabled);
+            }
+            else {
+                // Guard Zone은 필터 전 원본으로 (필터가 침입을 가리지 않도록)
+                if (m_blackBox.isArmed() && m_guardRaw > 0)
+                    checkGuardZone(buff);
+                if (m_filterCheck->isChecked()) {
+                    CStageScope timing(CStageTimer::eStage::filter);
+                    m_scanFilter.apply(buff, m_curConfig.channels);
+                }
+                {
+                    CStageScope timing(CStageTimer::eStage::process);
+                    processPayload(buff, cloudPoints);
+                    cloudPoints->buildIndex();
+                }
+                m_scanNo++;
+                if (m_rangeViewDock->isVisible())
+                    m_rangeView->pushScan(buff);
+                updateLivePoints();
+                CStageScope timing(CStageTimer::eStage::lumos);
+                lumoMap->lumos(cloudPoints->getPoints());
+            }
+        } // cool time below is not part of the scan
 
         comm->doEvents();
         if (!runRepeat) {
@@ -296,29 +312,234 @@ protected slots:
     void onFadeToggle(bool checked) {
         m_fadeEnabled = checked;
         lumoMap->setFadeEnabled(checked);
+        m_persistenceMode->setEnabled(checked);
+        m_trailSpin->setEnabled(checked);
+    }
+
+    // 잔상 방식: Decay (감쇠 누적 이미지) | Buffered (최근 3 scan), Fade Effect 해제 = off
+    void onPersistenceChanged(int index) {
+        lumoMap->setPersistence(index == 1 ? CLumoMap::ePersistence::buffered : CLumoMap::ePersistence::decay);
+    }
+
+    void onTrailChanged(int scans) {
+        lumoMap->setTrailLength(scans);
+    }
+
+    void onAutoQualityToggle(bool checked) {
+        lumoMap->setAutoQuality(checked);
     }
 
+    // 콤보 순서: Median 3, Median 5, Spike 3, Spike 5. 모드가 바뀌면 history는 새로 쌓음
+    void onFilterChanged() {
+        const int index = m_filterMode->currentIndex();
+        m_scanFilter.setMode(index >= 2 ? CScanFilter::eMode::spike : CScanFilter::eMode::median, index % 2 ? 5 : 3);
+        m_filterMode->setEnabled(m_filterCheck->isChecked());
+        m_filterStats->setVisible(m_filterCheck->isChecked());
+        m_filterStats->clear();
+    }
+
+    // 렌더 예산: scan 주기의 절반 (최대 33ms), 나머지는 통신/디코딩 몫
+    void onIntervalChanged(const QString& text) {
+        float ms = text.toFloat();
+        lumoMap->setFrameBudget(ms > 0 ? qMin(33.0f, ms * 0.5f) : 33.0f);
+    }
+
+    void onRenderStats(int level, float avgMs, float peakMs) {
+        m_renderStats->setText(QString("%1  %2 / %3 ms")
+            .arg(m_autoQualityCheck->isChecked() ? CLumoMap::qualityName(level) : QString("Fixed"))
+            .arg(avgMs, 0, 'f', 1)
+            .arg(peakMs, 0, 'f', 1));
+        if (m_filterCheck->isChecked())
+            m_filterStats->setText(QString("Filter %1 us").arg(m_scanFilter.costUs(), 0, 'f', 1));
+    }
+
+    // 캡처는 payload 공유(refcount)만 하고, 셀 텍스트는 model data()에서 보이는 행만 생성
     void onCapturePoints() {
-        m_pointTable->clearContents();
-        m_pointTable->setRowCount(0);
+        if (buff.isEmpty()) {
+            m_pointModel->clear();
+            return;
+        }
+
+        m_pointModel->capture(currentPayload(), m_curConfig.channels);
+        m_capturedScanNo = m_scanNo;
+    }
 
-        if (buff.isEmpty()) return;
+    // 수신 frame 녹화 (unpack 전 raw frame, .lrec)
+    void onRecordToggle(bool checked) {
+        if (!checked) {
+            if (!m_recorder.isOpen()) return;
+            int frames = m_recorder.frameCount();
+            double mb = m_recorder.bytesWritten() / (1024.0 * 1024.0);
+            double ratio = m_recorder.bytesWritten() ? (double)m_recorder.rawBytes() / m_recorder.bytesWritten() : 0.0;
+            QString path = m_recorder.fileName();
+            m_recorder.close();
+            m_recordAction->setText("Record");
+            m_recordCompressCheck->setEnabled(true);
+            m_statusBar->showMessage(QString("Recorded %1 frame(s), %2 MB (x%3): %4")
+                .arg(frames).arg(mb, 0, 'f', 1).arg(ratio, 0, 'f', 1).arg(path), waitForMsgDone);
+            return;
+        }
 
-        QByteArray payload;
-        if (!ptc.unpack(buff, nullptr, nullptr, nullptr, nullptr, &payload, nullptr))
-        {
-            payload = buff;
+        QString path = QFileDialog::getSaveFileName(this, "Record",
+            QDateTime::currentDateTime().toString("'rec_'yyyyMMdd_hhmmss'.lrec'"),
+            "LiDAR recording (*.lrec)");
+        m_recorder.setCompressed(m_recordCompressCheck->isChecked());
+        if (path.isEmpty() || !m_recorder.open(path, m_curConfig.toJson(), m_configHash)) {
+            if (!path.isEmpty()) onAlert(nullptr, 0, "Couldn't open " + path);
+            QSignalBlocker blocker(m_recordAction);
+            m_recordAction->setChecked(false);
+            return;
+        }
+        m_recordAction->setText("Stop Rec");
+        m_recordCompressCheck->setEnabled(false);
+    }
+
+    // Black Box: 최근 N초 frame 을 메모리 ring 에 유지, trigger 시 .lrec 로 dump
+    void onBlackBoxToggle(bool checked) {
+        m_blackBox.setArmed(checked);
+        m_dumpAction->setEnabled(checked);
+        m_guardTripped = false;
+    }
+
+    // dump 파일 경로, 시작 못 하면 빈 문자열
+    QString triggerBlackBox(const QString& reason) {
+        if (!m_blackBox.isArmed()) return QString();
+        QDir().mkpath("blackbox");
+        QString path = QDir("blackbox").absoluteFilePath(
+            QDateTime::currentDateTime().toString("'bb_'yyyyMMdd_hhmmss_zzz'.lrec'"));
+        m_blackBox.setCompressed(m_recordCompressCheck->isChecked());
+        if (!m_blackBox.trigger(path, reason)) return QString();
+        m_statusBar->showMessage(QString("Black box: dumping (%1)...").arg(reason));
+        return path;
+    }
+
+    void onBlackBoxDumped(const QString& path, int frames, qint64 elapsedMs, const QString& reason) {
+        // dump 중 프로파일이 바뀌었으면 이제 ring 을 다시 잡는다
+        if (m_blackBoxPendingBytes > 0 && m_blackBox.allocate(m_blackBoxPendingBytes))
+            m_blackBoxPendingBytes = 0;
+        if (frames < 0) {
+            onAlert(nullptr, 0, "Black box: couldn't write " + path);
+            return;
+        }
+        m_statusBar->showMessage(QString("Black box (%1): %2 frame(s) in %3 ms: %4")
+            .arg(reason).arg(frames).arg(elapsedMs).arg(path), waitForMsgDone);
+    }
+
+    void onGuardChanged() {
+        float rawToMeter = m_curConfig.distanceRate * m_curConfig.unitToMeter();
+        m_guardRaw = (rawToMeter > 0) ? int(m_guardSpin->value() / rawToMeter) : 0;
+        m_guardTripped = false;
+    }
+
+    // 보호 구역 침입: 0(무응답) 이 아닌 거리가 Guard 이내 -> 진입 시점에 한 번 trigger
+    void checkGuardZone(const QByteArray& payload) {
+        const int channels = m_curConfig.channels;
+        const int packetSize = 2 + channels * 2;
+        const quint8* p = (const quint8*)payload.constData();
+        bool inside = false;
+        for (int off = 0; off + packetSize <= payload.size() && !inside; off += packetSize) {
+            for (int j = 0; j < channels; ++j) {
+                int d = (p[off + 2 + j * 2] << 8) | p[off + 3 + j * 2];
+                if (d > 0 && d < m_guardRaw) {
+                    inside = true;
+                    break;
+                }
+            }
+        }
+        if (inside && !m_guardTripped) triggerBlackBox("zone");
+        m_guardTripped = inside;
+    }
+
+    // IPC: QLocalSocket 으로 "dump [reason]\n" -> "ok <path>\n" | "busy\n"
+    void onBlackBoxClient() {
+        while (QLocalSocket* socket = m_blackBoxServer->nextPendingConnection()) {
+            connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+                while (socket->canReadLine()) {
+                    QString line = QString::fromUtf8(socket->readLine()).trimmed();
+                    if (!line.startsWith("dump")) {
+                        socket->write("error unknown command\n");
+                        continue;
+                    }
+                    QString reason = line.mid(4).trimmed();
+                    QString path = triggerBlackBox(reason.isEmpty() ? "ipc" : reason);
+                    socket->write(path.isEmpty() ? QByteArray("busy\n") : "ok " + path.toUtf8() + "\n");
+                }
+            });
+        }
+    }
+
+    // Replay: 녹화 파일 선택
+    void onReplayBrowse() {
+        QString path = QFileDialog::getOpenFileName(this, "Replay", replayPath->text(),
+            "LiDAR recording (*.lrec);;Packet capture (*.pcap *.pcapng *.cap)");
+        if (!path.isEmpty()) replayPath->setText(path);
+    }
+
+    void onReplaySpeedChanged() {
+        if (CommReplay* replay = qobject_cast<CommReplay*>(comm))
+            replay->setSpeed(replaySpeed->currentData().toDouble());
+    }
+
+    void onReplaySeek(int index) {
+        if (CommReplay* replay = qobject_cast<CommReplay*>(comm)) {
+            replay->seek(index);
+            updateReplayTime(index, replay->frameCount());
+        }
+    }
+
+    void onReplayFramePlayed(int index, int count) {
+        if (!replaySeek->isSliderDown()) {
+            QSignalBlocker blocker(replaySeek);
+            replaySeek->setValue(index);
+        }
+        updateReplayTime(index, count);
+    }
+
+    void onReplayFinished() {
+        onAlert(nullptr, 0, "End of recording");
+        if (btnRunRepeat->isChecked()) btnRunRepeat->setChecked(false);
+    }
+
+    void onLiveToggle(bool checked) {
+        m_btnCapture->setEnabled(!checked);
+        m_liveTimer.invalidate();
+        if (checked && !buff.isEmpty()) {
+            onCapturePoints();
         }
+    }
 
-        processPayload(payload, this);
+    // Live 모드: 보이는 동안만, 최대 LIVE_UPDATE_MS 간격으로 최신 scan 반영 (행 단위 dataChanged)
+    void updateLivePoints() {
+        if (!m_liveCheck->isChecked() || !m_pointTable->isVisible() || isMinimized()) return;
+        if (m_liveTimer.isValid() && m_liveTimer.elapsed() < LIVE_UPDATE_MS) return;
+        m_liveTimer.start();
+
+        m_pointModel->updateScan(currentPayload(), m_curConfig.channels);
+        m_capturedScanNo = m_scanNo;
+
+        // 현재 행의 하이라이트를 새 값 위치로 이동
+        QModelIndex current = m_pointTable->selectionModel()->currentIndex();
+        if (current.isValid()) onPointHighlight(current.row(), 0);
+    }
+
+    // 맵에서 선택된 점 -> Point Viewer 행 선택 (캡처한 scan과 같을 때만)
+    void onMapPointPicked(int row) {
+        if (m_capturedScanNo != m_scanNo || row >= m_pointModel->rowCount()) {
+            onAlert(nullptr, 0, QString("Point row %1 (current scan not captured)").arg(row + 1));
+            return;
+        }
+        m_pointTable->selectRow(row);
+        m_pointTable->scrollTo(m_pointModel->index(row, 0));
     }
 
     void onPointHighlight(int row, int column) {
         Q_UNUSED(column);
-        if (row < 0 || row >= m_pointTable->rowCount()) return;
+        CPointTableModel::Point pt;
+        if (!m_pointModel->point(row, &pt)) return;
 
-        float angle = m_pointTable->item(row, 0)->text().toFloat();
-        float dist = m_pointTable->item(row, 1)->text().toFloat(); // (이미 Rate가 적용된 값)
+        float angle = pt.angle / 100.0f;
+        float dist = pt.distance * m_pointModel->distanceRate(); // Unit 단위
 
         float fAngle = angle;
 
@@ -339,17 +560,34 @@ protected slots:
     }
 
     void onPointSelectionChanged() {
-        int rowCount = m_pointTable->selectionModel()->selectedRows().count();
+        // 행 단위 선택이므로 range 높이 합 (selectedRows()는 행마다 index 생성)
+        int rowCount = 0;
+        const QItemSelection selection = m_pointTable->selectionModel()->selection();
+        for (const QItemSelectionRange& range : selection) {
+            rowCount += range.height();
+        }
         m_selectionCountLabel->setText(QString("%1 point(s) selected").arg(rowCount));
     }
 
-    void onCurrentPointChanged(QTableWidgetItem* current, QTableWidgetItem* previous) {
+    void onCurrentPointChanged(const QModelIndex& current, const QModelIndex& previous) {
         Q_UNUSED(previous);
-        if (!current) return;
-        onPointHighlight(current->row(), 0);
+        if (!current.isValid()) return;
+        onPointHighlight(current.row(), 0);
     }
 private:
-    int m_pointTableCaptureRow;
+    enum { LIVE_UPDATE_MS = 100 };
+
+    QByteArray currentPayload() {
+        QByteArray payload;
+        if (!ptc.unpack(buff, nullptr, nullptr, nullptr, nullptr, &payload, nullptr))
+        {
+            payload = buff;
+        }
+        return payload;
+    }
+
+    quint64 m_scanNo = 0;
+    quint64 m_capturedScanNo = ~0ULL;
     QByteArray buff;
     QMutex runMtx;
     CCloudPoints* cloudPoints;
@@ -359,7 +597,7 @@ private:
     QLabel* connStatus;
     QString ipAddress;
     int port;
-    enum class eCommType { None, TCP, UDP, COM };
+    enum class eCommType { None, TCP, UDP, COM, Virtual, Replay };
     eCommType m_commType = eCommType::TCP;
     QLineEdit* connString;
     QLineEdit* connNum;
@@ -381,7 +619,20 @@ private:
     QAction* chkTCP;
     QAction* chkUDP;
     QAction* chkSerial;
+    QAction* chkVirtual;
+    QAction* chkReplay;
     QActionGroup* chkCommType;
+    QLineEdit* replayPath;
+    QAction* replayPathAction;
+    QAction* replayBrowseAction;
+    QToolBar* replayToolBar;
+    QComboBox* replaySpeed;
+    QSlider* replaySeek;
+    QLabel* replayTime;
+    QSpinBox* virtualRate;
+    QAction* virtualRateAction;
+    CSynthScene m_synth;
+    QByteArray m_virtualPayload;
     QStatusBar* m_statusBar;
     Comm* comm = nullptr;
     bool isCOM = false;
@@ -389,7 +640,6 @@ private:
     bool runRepeat = false;
     bool isRunning = false;
     int reqWrdSize = 2400;
-    bool virtualDataEnabled = false;
     Protocol ptc;
     const quint32 waitForComm = 1000;
     const quint32 waitForConn = 1000;
@@ -397,29 +647,99 @@ private:
 
     // [신규] 설정값 구조체 인스턴스
     LidarConfig m_curConfig;
+    quint32 m_configHash = 0;
+    CScanRecorder m_recorder;
+    QAction* m_recordAction;
+    QCheckBox* m_recordCompressCheck;
+    CBlackBox m_blackBox;
+    QAction* m_blackBoxAction;
+    QAction* m_dumpAction;
+    QDoubleSpinBox* m_guardSpin;
+    QLocalServer* m_blackBoxServer;
+    int m_blackBoxPendingBytes = 0;     // allocate 가 dump 중이라 미뤄진 frame 크기
+    int m_guardRaw = 0;
+    bool m_guardTripped = false;
     QJsonObject m_settings;
     QDockWidget* m_pointViewerDock;
     CCopyTableWidget* m_pointTable;
+    CPointTableModel* m_pointModel;
     QLabel* m_selectionCountLabel;
     QPushButton* m_btnClear;
     QPushButton* m_btnCapture;
+    QCheckBox* m_liveCheck;
+    QElapsedTimer m_liveTimer;
     QCheckBox* m_fadeCheck;
+    QComboBox* m_persistenceMode;
+    QSpinBox* m_trailSpin;
+    QCheckBox* m_autoQualityCheck;
+    QCheckBox* m_filterCheck;
+    QComboBox* m_filterMode;
+    QLabel* m_filterStats;
+    CScanFilter m_scanFilter;
+    QLabel* m_renderStats;
     QAction* m_viewPointsAction;
+    QDockWidget* m_rangeViewDock;
+    CRangeView* m_rangeView;
+    QDockWidget* m_perfDock;
+    CPerfPanel* m_perfPanel;
     bool m_fadeEnabled;
 
     QJsonArray m_lidarConfigArray;
 
-    bool runProtocolVirtual(QByteArray* recvData) {
-        if (!recvData) return false;
-        // m_curConfig 사용, 페이로드 생성 요청
-        QByteArray payload = cloudPoints->generateVirtualPayload(
-            m_curConfig.channels, m_curConfig.resolution, m_curConfig.mesuresPerScan);
+    // Virtual 소스: 요청마다 합성 장면 (CSynthScene) ray-cast frame 생성 (setBulk 로 pack)
+    QByteArray makeVirtualFrame() {
+        if (m_virtualPayload.isEmpty()) return QByteArray();
+        m_synth.generate((uchar*)m_virtualPayload.data());
+        return ptc.pack(Protocol::eCmd::setBulk, 0, 0, reqWrdSize, &m_virtualPayload, nullptr);
+    }
+
+    void onVirtualRateChanged(int hz) {
+        m_synth.setRate(hz);
+        if (CommVirtual* virt = qobject_cast<CommVirtual*>(comm))
+            virt->setFrameRate(hz);
+    }
 
-        if (payload.isEmpty()) return false;
+    // 녹화 당시 프로파일로 전환 (같은 hash 의 모델이 있을 때, pcap 은 현재 프로파일 유지)
+    void onReplayOpened(CommReplay* replay) {
+        LidarConfig recorded = LidarConfig::fromJson(replay->recordedConfig());
+        int match = -1;
+        for (int i = 0; i < m_lidarConfigArray.count() && replay->recordedConfigHash(); ++i) {
+            if (LidarConfig::fromJson(m_lidarConfigArray[i].toObject()).hash() == replay->recordedConfigHash()) {
+                match = i;
+                break;
+            }
+        }
+        if (match >= 0 && lidarCfgs->findData(match) >= 0) {
+            lidarCfgs->setCurrentIndex(lidarCfgs->findData(match));
+        }
+        else if (replay->recordedConfigHash() && replay->recordedConfigHash() != m_configHash) {
+            onAlert(nullptr, 0, QString("Recorded with '%1'; profile not found, using '%2'")
+                .arg(recorded.name).arg(m_curConfig.name));
+        }
 
-        // Pack (setBulk)
-        *recvData = ptc.pack(Protocol::eCmd::setBulk, 0, 0, reqWrdSize, &payload, nullptr);
-        return !recvData->isEmpty();
+        replay->setMinFrameSize(reqWrdSize * 2);
+        replay->setSpeed(replaySpeed->currentData().toDouble());
+        {
+            QSignalBlocker blocker(replaySeek);
+            replaySeek->setRange(0, qMax(0, replay->frameCount() - 1));
+            replaySeek->setValue(0);
+        }
+        updateReplayTime(0, replay->frameCount());
+        connect(replay, &CommReplay::framePlayed, this, &CMainWin::onReplayFramePlayed, Qt::UniqueConnection);
+        connect(replay, &CommReplay::finished, this, &CMainWin::onReplayFinished, Qt::UniqueConnection);
+    }
+
+    void updateReplayTime(int index, int count) {
+        CommReplay* replay = qobject_cast<CommReplay*>(comm);
+        if (!replay) return;
+        auto mmss = [](quint64 ns) {
+            qint64 s = (qint64)(ns / 1000000000ULL);
+            return QString("%1:%2").arg(s / 60).arg(s % 60, 2, 10, QChar('0'));
+        };
+        replayTime->setText(QString(" %1 / %2  (%3/%4) ")
+            .arg(mmss(replay->frameTimeNs(index) - replay->frameTimeNs(0)))
+            .arg(mmss(replay->durationNs()))
+            .arg(index + 1).arg(count));
     }
 
     bool runProtocol(Protocol::eCmd cmd, bool needRecv = false, bool needUnpack = false,
@@ -430,37 +750,23 @@ private:
         bool isOK = false;
         QByteArray sendBuff;
 
-        if (virtualDataEnabled) {
-            isOK = runProtocolVirtual(recvData);
-            if (!isOK) return false;
-        }
-        else {
-            if (!comm) return false;
-            if (!comm->isIdle()) return false;
-
-            sendBuff = ptc.pack(cmd, dataType, startAddr, reqWordCnt);
-            isOK = comm->send(sendBuff, 1000);
-            if (!isOK) return false;
-
-            sendBuff.clear();
-            comm->waitForReady();
-            if (!needRecv) return true;
-
-            for (int i = 0; i < 50; i++) {
-                comm->doEvents();
-                isOK = comm->inbox(30);
-                if (isOK) break;
-                comm->doEvents();
-            }
+        if (!comm) return false;
+        if (!comm->isIdle()) return false;
 
-            int recvTimeout = isOK ? 300 : 100;
-            int expectedBytes = (reqWrdSize * 2) + 11;
+        // 송수신 절차는 headless daemon 과 공용 (CAcqSession::exchange)
+        sendBuff = ptc.pack(cmd, dataType, startAddr, reqWordCnt);
+        int expectedBytes = (reqWrdSize * 2) + 11;
+        isOK = CAcqSession::exchange(comm, sendBuff, needRecv ? recvData : nullptr, expectedBytes);
+        if (!isOK) return false;
+        if (!needRecv) return true;
 
-            isOK = comm->recv(*recvData, recvTimeout, expectedBytes);
-            if (!isOK) return false;
+        if (recvData && m_recorder.isOpen()) {
+            m_recorder.write(*recvData, 0, m_configHash);
         }
+        if (recvData) m_blackBox.push(*recvData);
 
         if (needUnpack) {
+            CStageScope timing(CStageTimer::eStage::unpack);
             QByteArray payload;
             isOK = ptc.unpack(*recvData, recvCmd, recvDataType, nullptr, nullptr, &payload, nullptr);
             if (isOK) {
@@ -478,48 +784,20 @@ private:
         } bytes;
     } wordBytes;
 
-    void processPayload(QByteArray& payload, ICloudPointGetter* processor)
+    void processPayload(const QByteArray& payload, ICloudPointGetter* processor)
     {
-        if (!processor) return;
-
-        processor->clearPoints();
-
-        // 패킷 크기: Angle(2) + (Channels * Dist(2))
-        int numChannels = m_curConfig.channels;
-        int packetSize = 2 + (numChannels * 2);
-
-        int cnt = payload.count() / packetSize;
-        if (cnt <= 0) return;
-
-        quint16 wdAngle, wdDist;
-
-        const quint8* dataPtr = (const quint8*)payload.constData();
-
-        for (int i = 0; i < cnt; i++) {
-            int offset = i * packetSize;
-
-            // Big Endian (MSB first)
-            quint8 angleHi = dataPtr[offset];
-            quint8 angleLo = dataPtr[offset + 1];
-            wdAngle = (quint16)((angleHi << 8) | angleLo);
-
-            for (int j = 0; j < numChannels; j++) {
-                int distOffset = offset + 2 + (j * 2);
-
-                // Distance (2 bytes) - Big Endian
-                quint8 distHi = dataPtr[distOffset];
-                quint8 distLo = dataPtr[distOffset + 1];
-                wdDist = (quint16)((distHi << 8) | distLo);
-
-                processor->setPoint(wdAngle, wdDist, j);
-            }
-        }
+        decodeScanPayload(payload, m_curConfig.channels, processor);
     }
 
     void clickCommType() {
         isCOM = (chkSerial->isChecked());
-        connStringAction->setVisible(!isCOM);
-        connNumAction->setVisible(!isCOM);
+        bool isNet = chkTCP->isChecked() || chkUDP->isChecked();
+        connStringAction->setVisible(isNet);
+        connNumAction->setVisible(isNet);
+        replayPathAction->setVisible(chkReplay->isChecked());
+        replayBrowseAction->setVisible(chkReplay->isChecked());
+        virtualRateAction->setVisible(chkVirtual->isChecked());
+        replayToolBar->setVisible(chkReplay->isChecked());
         if (isCOM) {
             comPorts->clear();
             // for order by name.
@@ -555,6 +833,17 @@ private:
             m_commType = eCommType::COM;
             comm = new CommSerial(this);
         }
+        else if (chkVirtual->isChecked()) {
+            m_commType = eCommType::Virtual;
+            CommVirtual* virt = new CommVirtual(this);
+            virt->setGenerator([this]() { return makeVirtualFrame(); });
+            virt->setFrameRate(virtualRate->value());
+            comm = virt;
+        }
+        else if (chkReplay->isChecked()) {
+            m_commType = eCommType::Replay;
+            comm = new CommReplay(this);
+        }
         QObject::connect(comm, &Comm::onStatus, this, &CMainWin::onStatus);
         QObject::connect(comm, &Comm::onAlert, this, &CMainWin::onAlert);
         QObject::connect(comm, &Comm::onProgress, this, &CMainWin::onProgress);
@@ -570,14 +859,21 @@ private:
                 comm = nullptr;
             }
             setCommType();
-            virtualDataEnabled = (m_commType == eCommType::UDP) && connString->text().right(2) == ".0";
             if (!comm->checkConn()) {
                 if (isCOM)
                     comm->setConnInfo(comPorts->currentText(), this->baudRates->currentText().toInt());
+                else if (m_commType == eCommType::Replay) {
+                    // pcap: connNum = sensor UDP port, frames joined like CommUDP (expectedBytes)
+                    CommReplay* replay = static_cast<CommReplay*>(comm);
+                    replay->setFrameBytes((reqWrdSize * 2) + 11);
+                    replay->setConnInfo(replayPath->text(), connNum->text().toInt());
+                }
                 else {
                     comm->setConnInfo(connString->text(), connNum->text().toInt());
                 }
-                comm->connect(waitForConn);
+                bool isOK = comm->connect(waitForConn);
+                if (isOK && m_commType == eCommType::Replay)
+                    onReplayOpened(static_cast<CommReplay*>(comm));
             }
         }
         else {
@@ -658,33 +954,7 @@ private:
     }
 
     void createDefaultConfig() {
-        QJsonObject type1, type2;
-        QJsonArray typesArray;
-
-        type1["name"] = "1ch / 360° (Standard)";
-        type1["channels"] = 1;
-        type1["fov"] = 360;
-        type1["resolution"] = 0.33;
-        type1["isClockwise"] = true;
-        type1["angleOffset"] = 180.0;
-        type1["fovStart"] = 0.0;
-        type1["distanceRate"] = 0.1; // Raw 1 = 0.1cm (1mm)
-        type1["distanceUnit"] = "cm";
-        type1["mesuresPerScan"] = (int)(360 / 0.33) + 1;
-
-        type2["name"] = "4ch / 90° (Front-Facing)";
-        type2["channels"] = 4;
-        type2["fov"] = 90;
-        type2["resolution"] = 0.33;
-        type2["isClockwise"] = true;
-        type2["angleOffset"] = 135.0;
-        type2["fovStart"] = 45.0;
-        type2["distanceRate"] = 0.1;
-        type2["distanceUnit"] = "cm";
-        type2["mesuresPerScan"] = (int)(90 / 0.33) + 1;
-
-        typesArray.append(type1);
-        typesArray.append(type2);
+        QJsonArray typesArray = LidarConfig::defaultTypes();
 
         QJsonObject rootObj;
         rootObj["Types"] = typesArray;
@@ -704,13 +974,28 @@ private:
         settings["port"] = connNum->text();
         settings["interval"] = interval->text();
         settings["fadeEffect"] = m_fadeCheck->isChecked();
+        settings["trailLength"] = m_trailSpin->value();
+        settings["persistence"] = m_persistenceMode->currentIndex() == 1 ? "buffered" : "decay";
+        settings["autoQuality"] = m_autoQualityCheck->isChecked();
+        settings["scanFilter"] = m_filterCheck->isChecked();
+        settings["scanFilterMode"] = m_filterMode->currentIndex();
+        settings["scanFilterSpikePercent"] = m_scanFilter.spikePercent();
+        settings["recordCompressed"] = m_recordCompressCheck->isChecked();
+        settings["blackBox"] = m_blackBoxAction->isChecked();
+        settings["blackBoxSeconds"] = m_blackBox.seconds();
+        settings["guardMeter"] = m_guardSpin->value();
         settings["lastModelIndex"] = lidarCfgs->currentIndex();
 
         // 통신 타입 저장
         QString commType = "TCP";
         if (chkUDP->isChecked()) commType = "UDP";
         else if (chkSerial->isChecked()) commType = "COM";
+        else if (chkVirtual->isChecked()) commType = "VIRTUAL";
+        else if (chkReplay->isChecked()) commType = "REPLAY";
         settings["commType"] = commType;
+        settings["replayFile"] = replayPath->text();
+        settings["virtualHz"] = virtualRate->value();
+        settings["replaySpeed"] = replaySpeed->currentIndex();
 
         // 화면 상태 저장 (Zoom, Offset)
         settings["zoomRate"] = (double)lumoMap->getZoomRate();
@@ -750,17 +1035,36 @@ private:
         connNum->setText(settings["port"].toString(connNum->text()));
         interval->setText(settings["interval"].toString(interval->text()));
         m_fadeCheck->setChecked(settings["fadeEffect"].toBool(m_fadeCheck->isChecked()));
+        m_trailSpin->setValue(settings["trailLength"].toInt(m_trailSpin->value()));
         lidarCfgs->setCurrentIndex(settings["lastModelIndex"].toInt(lidarCfgs->currentIndex()));
 
         // 통신 타입 복원
         QString commType = settings["commType"].toString("TCP");
+        // 예전 방식: UDP + IP 끝이 ".0" 이면 가상 데이터 -> Virtual 소스로 이전
+        if (commType == "UDP" && connString->text().right(2) == ".0") commType = "VIRTUAL";
         if (commType == "UDP") chkUDP->setChecked(true);
         else if (commType == "COM") chkSerial->setChecked(true);
+        else if (commType == "VIRTUAL") chkVirtual->setChecked(true);
+        else if (commType == "REPLAY") chkReplay->setChecked(true);
         else chkTCP->setChecked(true);
+        replayPath->setText(settings["replayFile"].toString());
+        virtualRate->setValue(settings["virtualHz"].toInt(virtualRate->value()));
+        replaySpeed->setCurrentIndex(qBound(0, settings["replaySpeed"].toInt(1), replaySpeed->count() - 1));
         clickCommType();
 
         // 화면 상태 복원
         if (!lumoMap) return;
+        lumoMap->setTrailLength(m_trailSpin->value());
+        m_persistenceMode->setCurrentIndex(settings["persistence"].toString("decay") == "buffered" ? 1 : 0);
+        m_autoQualityCheck->setChecked(settings["autoQuality"].toBool(true));
+        m_scanFilter.setSpikePercent(settings["scanFilterSpikePercent"].toInt(CScanFilter::DEFAULT_SPIKE_PERCENT));
+        m_filterMode->setCurrentIndex(qBound(0, settings["scanFilterMode"].toInt(0), m_filterMode->count() - 1));
+        m_filterCheck->setChecked(settings["scanFilter"].toBool(false));
+        onFilterChanged();
+        m_recordCompressCheck->setChecked(settings["recordCompressed"].toBool(true));
+        m_blackBox.setSeconds(settings["blackBoxSeconds"].toInt(CBlackBox::DEFAULT_SECONDS));
+        m_guardSpin->setValue(settings["guardMeter"].toDouble(0.0));
+        m_blackBoxAction->setChecked(settings["blackBox"].toBool(false));
         if (settings.contains("zoomRate")) {
             lumoMap->setZoomRate((float)settings["zoomRate"].toDouble(1.0));
         }
@@ -782,27 +1086,27 @@ private:
         }
 
         QJsonObject config = m_lidarConfigArray[index].toObject();
-        m_curConfig.name = config["name"].toString();
-        m_curConfig.channels = config["channels"].toInt(1);
-        m_curConfig.fov = config["fov"].toInt(360);
-        m_curConfig.resolution = (float)config["resolution"].toDouble(0.33);
-        m_curConfig.isClockwise = config["isClockwise"].toBool(true);
-        m_curConfig.angleOffset = (float)config["angleOffset"].toDouble(0.0);
-        m_curConfig.distanceRate = (float)config["distanceRate"].toDouble(0.1);
-        m_curConfig.distanceUnit = config["distanceUnit"].toString("cm");
-        m_curConfig.mesuresPerScan = config["mesuresPerScan"].toInt((int)(m_curConfig.fov / m_curConfig.resolution) + 1);
+        m_curConfig = LidarConfig::fromJson(config);
+        m_configHash = m_curConfig.hash();
 
         // Unit -> Meter 변환
-        float unitToMeter = 0.01f; // 기본 cm
-        if (m_curConfig.distanceUnit == "mm") unitToMeter = 0.001f;
-        else if (m_curConfig.distanceUnit == "m") unitToMeter = 1.0f;
-        else if (m_curConfig.distanceUnit == "cm") unitToMeter = 0.01f;
+        float unitToMeter = m_curConfig.unitToMeter();
 
         // reqWrdSize(스캔 당 측정 횟수) 계산
-        if (m_curConfig.mesuresPerScan <= 0) m_curConfig.mesuresPerScan = 1;
-        int bytesPerPacket = 2 + (m_curConfig.channels * 2);
-        int totalDataBytes = m_curConfig.mesuresPerScan * bytesPerPacket;
-        reqWrdSize = (totalDataBytes + 1) / 2;
+        reqWrdSize = m_curConfig.reqWordSize();
+
+        // Virtual: 프로파일 그대로 ray-cast, payload 버퍼는 여기서 한 번만 할당
+        m_synth.setProfile(m_curConfig.channels, m_curConfig.resolution, m_curConfig.mesuresPerScan,
+            m_curConfig.distanceRate * unitToMeter);
+        m_virtualPayload = QByteArray(m_synth.payloadBytes(), 0);
+
+        // Black Box: frame = header + reqWrdSize words
+        m_blackBox.setConfig(m_curConfig.toJson(), m_configHash);
+        // dump 중에는 allocate 불가 -> dump 가 끝나면 onBlackBoxDumped 에서 다시 시도
+        m_blackBoxPendingBytes = 0;
+        if (m_blackBox.frameBytes() < reqWrdSize * 2 + 64 && !m_blackBox.allocate(reqWrdSize * 2 + 64))
+            m_blackBoxPendingBytes = reqWrdSize * 2 + 64;
+        onGuardChanged();
 
         // 설정 전파
         cloudPoints->setOrientation(m_curConfig.angleOffset, m_curConfig.isClockwise);
@@ -813,8 +1117,12 @@ private:
         lumoMap->setMapOrientation(m_curConfig.angleOffset, m_curConfig.isClockwise);
         lumoMap->setDistanceUnit(m_curConfig.distanceUnit);
 
+        // Range View (angle x layer)
+        m_rangeView->setProfile(m_curConfig.channels, m_curConfig.mesuresPerScan);
+        m_rangeView->setRange(30.0f, m_curConfig.distanceRate * unitToMeter);
+
         // 테이블 헤더 업데이트
-        m_pointTable->setHorizontalHeaderItem(1, new QTableWidgetItem("Dist (" + m_curConfig.distanceUnit + ")"));
+        m_pointModel->setDistanceFormat(m_curConfig.distanceRate, m_curConfig.distanceUnit);
 
         // UI 가시성
         bool showCheckboxes = (m_curConfig.channels > 1);
@@ -842,18 +1150,26 @@ private:
         QWidget* dockContainer = new QWidget();
         QVBoxLayout* layout = new QVBoxLayout(dockContainer);
 
+        QHBoxLayout* captureLayout = new QHBoxLayout();
         m_btnCapture = new QPushButton("Capture Current Scan");
-        layout->addWidget(m_btnCapture);
+        captureLayout->addWidget(m_btnCapture, 1);
+        m_liveCheck = new QCheckBox("Live");
+        m_liveCheck->setToolTip("Follow the latest scan while the Point Viewer is visible");
+        captureLayout->addWidget(m_liveCheck);
+        layout->addLayout(captureLayout);
 
+        m_pointModel = new CPointTableModel(this);
         m_pointTable = new CCopyTableWidget();
-        m_pointTable->setColumnCount(3);
-        m_pointTable->setHorizontalHeaderLabels(QStringList() << "Angle (°)" << "Dist (cm)" << "Layer");
+        m_pointTable->setModel(m_pointModel);
         m_pointTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
 
         m_pointTable->setSelectionBehavior(QAbstractItemView::SelectRows);
         m_pointTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
         m_pointTable->verticalHeader()->setVisible(false);
+        // 행 높이 고정: 수백만 행에서도 크기 계산 없이 스크롤
+        m_pointTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        m_pointTable->verticalHeader()->setDefaultSectionSize(20);
         m_pointTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
         layout->addWidget(m_pointTable);
 
@@ -864,13 +1180,37 @@ private:
         addDockWidget(Qt::RightDockWidgetArea, m_pointViewerDock);
 
         connect(m_btnCapture, &QPushButton::clicked, this, &CMainWin::onCapturePoints);
+        connect(m_liveCheck, &QCheckBox::toggled, this, &CMainWin::onLiveToggle);
         //connect(m_pointTable, &CCopyTableWidget::cellClicked, this, &CMainWin::onPointHighlight);
         connect(m_pointTable->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &CMainWin::onPointSelectionChanged);
-        connect(m_pointTable, &CCopyTableWidget::currentItemChanged,
+        connect(m_pointTable->selectionModel(), &QItemSelectionModel::currentRowChanged,
             this, &CMainWin::onCurrentPointChanged);
     }
 
+    // 각도 x 레이어 거리 이미지 (waterfall). 보일 때만 갱신.
+    void createRangeViewDock() {
+        m_rangeViewDock = new QDockWidget("Range View", this);
+        m_rangeViewDock->setAllowedAreas(Qt::AllDockWidgetAreas);
+
+        m_rangeView = new CRangeView(m_rangeViewDock);
+        m_rangeViewDock->setWidget(m_rangeView);
+        addDockWidget(Qt::BottomDockWidgetArea, m_rangeViewDock);
+        m_rangeViewDock->hide();
+    }
+
+    // Stage 별 지연 (CStageTimer), Point Viewer 옆 탭. 보일 때만 갱신.
+    void createPerfDock() {
+        m_perfDock = new QDockWidget("Performance", this);
+        m_perfDock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
+
+        m_perfPanel = new CPerfPanel(m_perfDock);
+        m_perfDock->setWidget(m_perfPanel);
+        addDockWidget(Qt::RightDockWidgetArea, m_perfDock);
+        tabifyDockWidget(m_pointViewerDock, m_perfDock);
+        m_pointViewerDock->raise();
+    }
+
     void setUI() {
         this->resize(1280, 720);
         this->setWindowTitle("LumoMap");
@@ -890,10 +1230,18 @@ private:
         chkUDP->setCheckable(true);
         chkSerial = new QAction("COM", chkCommType);
         chkSerial->setCheckable(true);
+        chkVirtual = new QAction("Virtual", chkCommType);
+        chkVirtual->setCheckable(true);
+        chkVirtual->setToolTip("Generated scans, no device");
+        chkReplay = new QAction("Replay", chkCommType);
+        chkReplay->setCheckable(true);
+        chkReplay->setToolTip("Play back a .lrec recording");
         toolBar->addActions(chkCommType->actions());
         connect(chkTCP, &QAction::triggered, this, &CMainWin::clickCommType);
         connect(chkUDP, &QAction::triggered, this, &CMainWin::clickCommType);
         connect(chkSerial, &QAction::triggered, this, &CMainWin::clickCommType);
+        connect(chkVirtual, &QAction::triggered, this, &CMainWin::clickCommType);
+        connect(chkReplay, &QAction::triggered, this, &CMainWin::clickCommType);
         connString = new QLineEdit("127.0.0.1", this);
         connString->setFixedWidth(100); connString->setAlignment(Qt::AlignCenter);
         connStringAction = toolBar->addWidget(connString);
@@ -912,9 +1260,44 @@ private:
         baudRates->setVisible(false); baudRates->setFixedWidth(100);
         baudRatesAction = toolBar->addWidget(baudRates);
         baudRatesAction->setEnabled(false);
+        replayPath = new QLineEdit(this);
+        replayPath->setFixedWidth(200); replayPath->setPlaceholderText("recording.lrec");
+        replayPathAction = toolBar->addWidget(replayPath);
+        replayPathAction->setVisible(false);
+        replayBrowseAction = toolBar->addAction("...");
+        replayBrowseAction->setVisible(false);
+        connect(replayBrowseAction, &QAction::triggered, this, &CMainWin::onReplayBrowse);
+        // Virtual: scene.json (없으면 기본 장면), 생성 속도
+        m_synth.setScene(CSynthScene::loadScene());
+        virtualRate = new QSpinBox(this);
+        virtualRate->setRange(1, 10000); virtualRate->setSuffix(" Hz");
+        virtualRate->setValue(int(m_synth.rate()));
+        virtualRate->setToolTip("Virtual frames per second (set the interval to 0 for more than 1000/interval)");
+        virtualRateAction = toolBar->addWidget(virtualRate);
+        virtualRateAction->setVisible(false);
+        connect(virtualRate, QOverload<int>::of(&QSpinBox::valueChanged), this, &CMainWin::onVirtualRateChanged);
         toolBar->addSeparator();
         // (통신 설정 끝)
 
+        // Replay 재생 속도 / 위치
+        replayToolBar = addToolBar("Replay");
+        replaySpeed = new QComboBox(this);
+        replaySpeed->addItem("0.1x", 0.1);
+        replaySpeed->addItem("1x", 1.0);
+        replaySpeed->addItem("10x", 10.0);
+        replaySpeed->addItem("Max", 0.0);
+        replaySpeed->setCurrentIndex(1);
+        replaySpeed->setToolTip("Max: as fast as possible (set the interval to 0 to benchmark)");
+        replayToolBar->addWidget(replaySpeed);
+        connect(replaySpeed, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &CMainWin::onReplaySpeedChanged);
+        replaySeek = new QSlider(Qt::Horizontal, this);
+        replaySeek->setFixedWidth(200);
+        replayToolBar->addWidget(replaySeek);
+        connect(replaySeek, &QSlider::valueChanged, this, &CMainWin::onReplaySeek);
+        replayTime = new QLabel(this);
+        replayToolBar->addWidget(replayTime);
+        replayToolBar->setVisible(false);
+
         toolBar = addToolBar("Run");
 
         // (Run)
@@ -978,6 +1361,39 @@ private:
         m_fadeEnabled = true;
         toolBar->addWidget(m_fadeCheck);
         connect(m_fadeCheck, &QCheckBox::toggled, this, &CMainWin::onFadeToggle);
+        m_persistenceMode = new QComboBox(this);
+        m_persistenceMode->addItems({ "Decay", "Buffered" });
+        m_persistenceMode->setToolTip("Decay: trail fades over the trail length, Buffered: last 3 scans");
+        toolBar->addWidget(m_persistenceMode);
+        connect(m_persistenceMode, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &CMainWin::onPersistenceChanged);
+
+        // 잔상 길이 (scan 수)
+        toolBar->addWidget(new QLabel(" Trail: ", this));
+        m_trailSpin = new QSpinBox(this);
+        m_trailSpin->setRange(1, CLumoMap::MAX_TRAIL_LENGTH);
+        m_trailSpin->setValue(3);
+        m_trailSpin->setFixedWidth(50);
+        toolBar->addWidget(m_trailSpin);
+        connect(m_trailSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &CMainWin::onTrailChanged);
+        toolBar->addSeparator();
+
+        // 프레임이 밀리면 AA/잔상/점 수를 자동으로 낮춤
+        m_autoQualityCheck = new QCheckBox("Auto Quality", this);
+        m_autoQualityCheck->setChecked(true);
+        toolBar->addWidget(m_autoQualityCheck);
+        connect(m_autoQualityCheck, &QCheckBox::toggled, this, &CMainWin::onAutoQualityToggle);
+        toolBar->addSeparator();
+
+        // 스캔 간 시간 필터 (각도 bin x 레이어별 median / spike 제거)
+        m_filterCheck = new QCheckBox("Filter", this);
+        m_filterCheck->setToolTip("Temporal filter per angle bin and layer over the last scans");
+        toolBar->addWidget(m_filterCheck);
+        m_filterMode = new QComboBox(this);
+        m_filterMode->addItems({ "Median 3", "Median 5", "Spike 3", "Spike 5" });
+        m_filterMode->setEnabled(false);
+        toolBar->addWidget(m_filterMode);
+        connect(m_filterCheck, &QCheckBox::toggled, this, &CMainWin::onFilterChanged);
+        connect(m_filterMode, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &CMainWin::onFilterChanged);
 
 
         toolBar = addToolBar("Tool");
@@ -989,6 +1405,61 @@ private:
             m_pointViewerDock->raise();
             });
 
+        QAction* viewRangeAction = toolBar->addAction("Range View");
+        connect(viewRangeAction, &QAction::triggered, this, [this]() {
+            m_rangeView->clear();
+            m_rangeViewDock->setVisible(true);
+            m_rangeViewDock->raise();
+            });
+
+        QAction* viewPerfAction = toolBar->addAction("Performance");
+        viewPerfAction->setToolTip("Per-stage latency (p50 / p99 / max), scan Hz, render FPS");
+        connect(viewPerfAction, &QAction::triggered, this, [this]() {
+            m_perfDock->setVisible(true);
+            m_perfDock->raise();
+            });
+
+        toolBar->addSeparator();
+        m_recordAction = toolBar->addAction("Record");
+        m_recordAction->setCheckable(true);
+        m_recordAction->setToolTip("Record received frames to a .lrec file");
+        connect(m_recordAction, &QAction::toggled, this, &CMainWin::onRecordToggle);
+        m_recordCompressCheck = new QCheckBox("Compress", this);
+        m_recordCompressCheck->setChecked(true);
+        m_recordCompressCheck->setToolTip("Delta-code recorded frames (keyframe every 32 frames)");
+        toolBar->addWidget(m_recordCompressCheck);
+
+        m_blackBoxAction = toolBar->addAction("Black Box");
+        m_blackBoxAction->setCheckable(true);
+        m_blackBoxAction->setToolTip("Keep the last seconds of frames in memory");
+        connect(m_blackBoxAction, &QAction::toggled, this, &CMainWin::onBlackBoxToggle);
+        m_dumpAction = toolBar->addAction("Dump");
+        m_dumpAction->setEnabled(false);
+        m_dumpAction->setToolTip("Write the black box to blackbox/*.lrec");
+        connect(m_dumpAction, &QAction::triggered, this, [this]() {
+            if (triggerBlackBox("button").isEmpty()) m_statusBar->showMessage("Black box: dump in progress", waitForMsgDone);
+            });
+        m_guardSpin = new QDoubleSpinBox(this);
+        m_guardSpin->setRange(0.0, 100.0); m_guardSpin->setSingleStep(0.5);
+        m_guardSpin->setPrefix("Guard "); m_guardSpin->setSuffix(" m");
+        m_guardSpin->setSpecialValueText("Guard off");
+        m_guardSpin->setToolTip("Dump the black box when a point comes closer than this");
+        toolBar->addWidget(m_guardSpin);
+        connect(m_guardSpin, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &CMainWin::onGuardChanged);
+
+        connect(&m_blackBox, &CBlackBox::dumpFinished, this, &CMainWin::onBlackBoxDumped, Qt::QueuedConnection);
+        m_blackBoxServer = new QLocalServer(this);
+        if (!m_blackBoxServer->listen("LumoMap.blackbox")) {
+            // 이미 실행 중인 인스턴스가 응답하면 그쪽 socket 은 건드리지 않는다 (응답 없는 stale socket 만 정리)
+            QLocalSocket probe;
+            probe.connectToServer("LumoMap.blackbox");
+            if (!probe.waitForConnected(200)) {
+                QLocalServer::removeServer("LumoMap.blackbox");
+                m_blackBoxServer->listen("LumoMap.blackbox");
+            }
+        }
+        connect(m_blackBoxServer, &QLocalServer::newConnection, this, &CMainWin::onBlackBoxClient);
+
 
 
         // 상태표시줄
@@ -999,6 +1470,16 @@ private:
         connStatus->setAlignment(Qt::AlignCenter);
         m_statusBar->addPermanentWidget(connStatus);
 
+        m_renderStats = new QLabel("", this);
+        m_renderStats->setMinimumWidth(160);
+        m_renderStats->setToolTip("Render quality level, frame time average / peak");
+        m_statusBar->addPermanentWidget(m_renderStats);
+
+        m_filterStats = new QLabel("", this);
+        m_filterStats->setToolTip("Temporal filter cost per scan (average)");
+        m_filterStats->setVisible(false);
+        m_statusBar->addPermanentWidget(m_filterStats);
+
         if (comm)
             this->onStatus(comm, Comm::eStatus::closed);
     }
@@ -1006,9 +1487,24 @@ private:
 
 
 #include <QApplication>
+#include <QGuiApplication>
 #include <QFile>
 #include <QStyleFactory>
 int main(int argc, char* argv[]) {
+    // 녹화 -> point cloud 일괄 변환 (--convert, GUI 없이 QtCore 만)
+    if (CCloudConvertCli::isRequested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return CCloudConvertCli::run(app.arguments());
+    }
+
+    // 오프스크린 렌더/벤치마크 모드 (디스플레이 없이 실행)
+    if (CRenderCli::isRequested(argc, argv)) {
+        if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        QGuiApplication app(argc, argv);
+        return CRenderCli::run(app.arguments());
+    }
+
     QApplication app(argc, argv);
 
     // (선택) 'Fusion' 스타일을 적용하면 QSS가 더 일관되게 보입니다.
@@ -0,0 +1,883 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CMAPRENDERER_H
+#define CMAPRENDERER_H
+
+#include <QtGui>
+#include <QtCore>
+#include <QString>
+#include <QMap>
+
+#include "CPointRaster.h"
+#include "CScanIndex.h"
+
+/**
+ * @brief Map drawing (rings, FoV, points, highlights, info) without a widget.
+ *
+ * CLumoMap owns one and forwards its view state; the offscreen CLI renders
+ * straight into a QImage with the same code.
+ */
+class CMapRenderer
+{
+public:
+
+    struct HighlightData {
+        QPointF pos;
+        bool active;
+    };
+
+    typedef struct distanceInfo {
+        QString info;
+        QRect textRect;
+        QStaticText staticText; // laid out only when info changes
+        QString preparedInfo;
+    } distanceInfo;
+
+    // buffered: legacy 3-scan buffer, decay: exponentially decaying accumulation image
+    enum class ePersistence { buffered, decay };
+    enum { MAX_TRAIL_LENGTH = 100 };
+    // decay is time-based: the trail reaches the cutoff after trail length x the measured scan period
+    enum { TRAIL_TICK_MS = 33, MAX_SCAN_PERIOD_MS = 2000 };
+
+    // painter: QPainter::drawPoint per point, tiled: CPointRaster on the thread pool.
+    // The tiled backend is only used when selected (setRasterBackend).
+    enum class eRasterBackend { painter, tiled };
+
+    // Render quality, cheapest last; each level keeps the savings of the ones above it.
+    enum class eQuality { full, noAntialias, noPersistence, decimated };
+    enum { MAX_QUALITY_LEVEL = (int)eQuality::decimated };
+
+    CMapRenderer(int channels, int fov, float resolution)
+        : m_channels(channels), m_fov(fov), m_resolution(resolution)
+    {
+        penThin = QPen(lineThin.color, lineThin.thickness, lineThin.pattern);
+        penThick = QPen(lineThick.color, lineThick.thickness, lineThick.pattern);
+        penGrid = QPen(lineThin.color, lineThin.thickness, lineThick.pattern);
+        penFoV = QPen(Qt::darkRed, 1.0, Qt::SolidLine);
+        penHighlight = QPen(Qt::yellow, 2.0, Qt::SolidLine);
+
+        m_currentScanIndex = 0;
+        for (int i = 0; i < 8; ++i) m_visibleLayer[i] = true;
+
+        m_clock.start();
+        m_fadeEnabled = true;
+        m_persistence = ePersistence::decay;
+        setTrailLength(3);
+        m_angleOffset = 0.0f;
+        m_isClockwise = true;
+        m_distanceUnit = "cm";
+
+        m_infoFont = QFont("Arial", 12);
+        m_labelFont = QFont("Arial", 9);
+        m_infoOption.setWrapMode(QTextOption::WordWrap);
+    }
+
+    // nowMs < 0: the renderer's own clock; offscreen callers pass scan times for repeatable output.
+    void lumos(const QVector<QPointF>& newScan, qint64 nowMs = -1)
+    {
+        nowMs = timeOf(nowMs);
+        if (m_lastScanMs >= 0 && nowMs > m_lastScanMs && nowMs - m_lastScanMs < MAX_SCAN_PERIOD_MS)
+            m_scanPeriodMs = m_scanPeriodMs * 0.9 + (nowMs - m_lastScanMs) * 0.1;
+        m_lastScanMs = nowMs;
+
+        if (fadeActive() && m_persistence == ePersistence::buffered) {
+            m_currentScanIndex = (m_currentScanIndex + 1) % 3;
+        }
+        else {
+            m_currentScanIndex = 0;
+            m_scanBuffer[1].clear();
+            m_scanBuffer[2].clear();
+        }
+        if (m_quality >= eQuality::decimated) {
+            decimate(newScan, m_scanBuffer[m_currentScanIndex]);
+        }
+        else {
+            m_scanBuffer[m_currentScanIndex] = newScan;
+        }
+
+        if (trailActive()) {
+            advanceTrail(nowMs);
+            splatTrail(m_scanBuffer[m_currentScanIndex]);
+        }
+        pushScanRect(scanBounds(m_scanBuffer[m_currentScanIndex]), nowMs);
+    }
+
+    void fadeAway(bool fadeEnabled, qint64 nowMs = -1) {
+        nowMs = timeOf(nowMs);
+        if (!fadeEnabled || m_quality >= eQuality::noPersistence) {
+            clearPoints();
+        }
+        else if (m_persistence == ePersistence::decay) {
+            m_scanBuffer[m_currentScanIndex].clear();
+            advanceTrail(nowMs);
+        }
+        else {
+            m_currentScanIndex = (m_currentScanIndex + 1) % 3;
+            m_scanBuffer[m_currentScanIndex].clear();
+            pushScanRect(QRect(), nowMs);
+        }
+    }
+
+    // Fades the trail by the time since the last decay. Called per scan and per displayed
+    // frame (CLumoMap), so the trail keeps fading between scans and after they stop.
+    // True when the trail changed (repaint takeDirtyRegion()).
+    bool advanceTrail(qint64 nowMs = -1)
+    {
+        nowMs = timeOf(nowMs);
+        if (!trailActive() || m_lastDecayMs < 0 || nowMs < m_lastDecayMs) {
+            m_lastDecayMs = nowMs;
+            return false;
+        }
+        const double trailMs = m_trailLength * m_scanPeriodMs;
+        const int factor = (int)std::lround(std::pow(TRAIL_CUTOFF, (nowMs - m_lastDecayMs) / trailMs) * 256.0);
+        if (factor >= 256) return false; // under one step; the time carries over to the next call
+
+        m_lastDecayMs = nowMs;
+        const bool lit = !m_pointsRect.isEmpty();
+        decayTrail(m_pointsRect, (quint16)factor);
+        updatePointsRect(nowMs);
+        return lit;
+    }
+
+    // Decay mode with something still fading on screen.
+    bool hasTrail() const { return trailActive() && !m_pointsRect.isEmpty(); }
+
+    void clearPoints() {
+        m_scanBuffer[0].clear();
+        m_scanBuffer[1].clear();
+        m_scanBuffer[2].clear();
+        m_trailImage.fill(Qt::transparent);
+        m_dirtyRect |= m_pointsRect;
+        m_scanRects.clear();
+        m_pointsRect = QRect();
+    }
+
+    // Widget area changed by scans since the last call (previous and new point extents)
+    // plus the overlay areas that follow the scan (info text, hover marker).
+    QRegion takeDirtyRegion()
+    {
+        QRegion region(m_dirtyRect);
+        m_dirtyRect = QRect();
+
+        region += infoBlock(nomalInfo, normalInfoPos()) | infoBlock(m_fixedInfo, fixedInfoPos());
+        region += infoBlock(m_hoverInfo, hoverInfoPos());
+        region += m_hoverMarkRect;
+        if (m_hoverRow >= 0 && m_scanIndex && m_hoverRow < m_scanIndex->count()) {
+            const CScanIndex::Entry& e = m_scanIndex->entry(m_hoverRow);
+            QPoint center = mapFromScene(QPointF(e.x, e.y)).toPoint();
+            region += QRect(center - QPoint(8, 8), QSize(17, 17));
+        }
+        return region;
+    }
+
+    void setViewportSize(const QSize& size)
+    {
+        m_viewSize = size;
+        m_centerPoint = QPointF(size.width() / 2, size.height() / 2);
+        m_trailImage = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        m_pointImage = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        resetTrail();
+    }
+
+    QSize viewportSize() const { return m_viewSize; }
+
+    void setSettings(float pixelsPerMeter, int maxConcCircles)
+    {
+        m_pixelsPerMeter = pixelsPerMeter;
+        m_maxConcCircles = maxConcCircles;
+    }
+
+    void setHardwareProfile(int channels, int fov, float resolution) {
+        m_channels = channels;
+        m_fov = fov;
+        m_resolution = resolution;
+    }
+
+    void setMapOrientation(float angleOffset, bool isCCW)
+    {
+        m_angleOffset = angleOffset;
+        m_isClockwise = isCCW;
+    }
+
+    void setFadeEnabled(bool enabled)
+    {
+        m_fadeEnabled = enabled;
+        resetTrail();
+    }
+
+    void setPersistence(ePersistence mode)
+    {
+        m_persistence = mode;
+        resetTrail();
+    }
+
+    // Trail length in scans; the accumulation image reaches the cutoff level after that many
+    // scan periods (measured between lumos() calls), whether or not scans keep coming.
+    void setTrailLength(int scans)
+    {
+        m_trailLength = qBound(1, scans, (int)MAX_TRAIL_LENGTH);
+        resetTrail();
+    }
+
+    int getTrailLength() const { return m_trailLength; }
+
+    void setRasterBackend(eRasterBackend backend)
+    {
+        m_rasterBackend = backend;
+        resetTrail();
+    }
+
+    void setRasterThreads(int threads) {
+        m_raster.setThreadCount(threads);
+    }
+
+    void setDistanceUnit(const QString& unit) {
+        m_distanceUnit = unit;
+    }
+
+    // Index of the scan passed to lumos(); used to snap hover/click to real returns.
+    void setScanIndex(const CScanIndex* index) {
+        m_scanIndex = index;
+    }
+
+    void setHighlight(QPointF pos, Qt::GlobalColor color)
+    {
+        HighlightData data;
+        data.pos = pos;
+        data.active = true;
+
+        m_highlights.insert(color, data);
+    }
+
+    void visibleHighlight(Qt::GlobalColor color, bool visible)
+    {
+        if (m_highlights.contains(color)) {
+            m_highlights[color].active = visible;
+        }
+    }
+
+    void clearHighlights() {
+        m_highlights.clear();
+    }
+
+    void setQuality(eQuality quality)
+    {
+        if (quality == m_quality) return;
+        m_quality = quality;
+        resetTrail();
+    }
+
+    eQuality quality() const { return m_quality; }
+
+    void setVisibleLayer(int layerIndex, bool value) {
+        m_visibleLayer[layerIndex] = value;
+        resetTrail();
+    }
+
+    float getZoomRate() const { return m_zoomRate; }
+    void setZoomRate(float rate) {
+        m_zoomRate = rate;
+        penThin = QPen(lineThin.color, lineThin.thickness / m_zoomRate, lineThin.pattern);
+        penThick = QPen(lineThick.color, lineThick.thickness / m_zoomRate, lineThick.pattern);
+        penGrid = QPen(lineThin.color, lineThin.thickness / m_zoomRate, lineThick.pattern);
+        penFoV = QPen(penFoV.color(), 1.0 / m_zoomRate, penFoV.style());
+        penHighlight.setWidthF(2.0 / m_zoomRate);
+        resetTrail();
+    }
+
+    QPointF getCenterOffset() const { return m_centerOffset; }
+    void setCenterOffset(const QPointF& offset) {
+        m_centerOffset = offset;
+        resetTrail();
+    }
+
+    QPointF mapToScene(const QPointF& viewPos) const {
+        return (viewPos - (m_centerPoint + m_centerOffset)) / m_zoomRate;
+    }
+
+    QPointF mapFromScene(const QPointF& scenePos) const {
+        return scenePos * m_zoomRate + m_centerPoint + m_centerOffset;
+    }
+
+    // Info overlay: nomal (click), fixed (Ctrl+click), hover.
+    distanceInfo& normalInfo() { return nomalInfo; }
+    distanceInfo& fixedInfo() { return m_fixedInfo; }
+    distanceInfo& hoverInfo() { return m_hoverInfo; }
+
+    void setHoverRow(int row) { m_hoverRow = row; }
+    int hoverRow() const { return m_hoverRow; }
+
+    // Nearest indexed return within PICK_RADIUS screen pixels, or -1.
+    int pickPoint(const QPointF& scenePos) const
+    {
+        if (!m_scanIndex) return -1;
+        return m_scanIndex->nearest(scenePos, PICK_RADIUS / m_zoomRate);
+    }
+
+    const CScanIndex* scanIndex() const { return m_scanIndex; }
+
+    QString pointInfo(const QPointF& scenePos, int row) const
+    {
+        float dx = scenePos.x();
+        float dy = scenePos.y();
+        float distance = std::sqrt(dx * dx + dy * dy);
+
+        float mapAngle = std::atan2(-dy, dx) * 180.0 / M_PI;
+
+        float rawAngle = mapAngle - m_angleOffset;
+        if (m_isClockwise) rawAngle = -rawAngle;
+
+        float distMeter = distance / m_pixelsPerMeter;
+        float distValue = distMeter;
+
+        if (m_distanceUnit == "cm") distValue *= 100.0f;
+        else if (m_distanceUnit == "mm") distValue *= 1000.0f;
+
+        const CScanIndex::Entry* e = (row >= 0) ? &m_scanIndex->entry(row) : nullptr;
+        if (e) rawAngle = e->angle / 100.0f;
+
+        QString info = QString("Dist: %1 %2\nAngle: %3\u00B0")
+            .arg(QLocale(QLocale::English).toString(distValue, 'f', 1))
+            .arg(m_distanceUnit)
+            .arg(QLocale(QLocale::English).toString(rawAngle, 'f', 2));
+        if (e) {
+            info += QString("\nLayer: %1  Raw: %2\nRow: %3")
+                .arg(e->layer + 1)
+                .arg(e->distance)
+                .arg(row + 1);
+        }
+        return info;
+    }
+
+    // Draws one full frame into painter's device (viewport size set beforehand).
+    void render(QPainter& painter)
+    {
+        render(painter, QRect(QPoint(0, 0), m_viewSize));
+    }
+
+    // Repaints only `dirty`; the caller's device must still hold the previous frame elsewhere.
+    void render(QPainter& painter, const QRect& dirty)
+    {
+        painter.setRenderHint(QPainter::Antialiasing, m_quality < eQuality::noAntialias);
+        painter.fillRect(dirty, Qt::black);
+
+        painter.save();
+        painter.translate(m_centerPoint + m_centerOffset);
+        painter.scale(m_zoomRate, m_zoomRate);
+
+        drawCrosshair(painter);
+        drawConcCircles(painter);
+        drawFieldOfView(painter);
+        drawLidarPoints(painter, dirty);
+        drawHighlight(painter);
+        painter.restore();
+
+        if (m_overlayEnabled) {
+            drawRingLabels(painter);
+            drawInfo(painter);
+        }
+    }
+
+    // Info text and ring labels; off only for render benchmarks.
+    void setOverlayEnabled(bool enabled) { m_overlayEnabled = enabled; }
+
+    void render(QImage& image)
+    {
+        if (image.size() != m_viewSize) setViewportSize(image.size());
+        QPainter painter(&image);
+        render(painter);
+    }
+
+private:
+
+    QColor channelColor[5][3] = {
+        // Ch 1: Green
+        {QColor(0, 255, 0, 255),   QColor(0, 255, 0, 120),   QColor(0, 255, 0, 80)},
+        // Ch 2: Yellow
+        {QColor(255, 255, 0, 255), QColor(255, 255, 0, 120), QColor(255, 255, 0, 80)},
+        // Ch 3: Cyan
+        {QColor(0, 255, 255, 255), QColor(0, 255, 255, 120), QColor(0, 255, 255, 80)},
+        // Ch 4: Magenta
+        {QColor(255, 0, 255, 255), QColor(255, 0, 255, 120), QColor(255, 0, 255, 80)},
+        // Ch 5: Red
+        {QColor(255, 0, 0, 255),   QColor(255, 0, 0, 120),   QColor(255, 0, 0, 80)},
+    };
+
+    void drawLidarPoints(QPainter& painter, const QRect& dirty)
+    {
+        const QVector<QPointF>& scan1 = m_scanBuffer[m_currentScanIndex];
+        const bool fade = fadeActive();
+
+        if (fade && m_persistence == ePersistence::decay) {
+            painter.save();
+            painter.resetTransform();
+            painter.drawImage(dirty, m_trailImage, dirty);
+            painter.restore();
+            return;
+        }
+
+        // without fade only the newest scan is drawn, through the same backend choice
+        const QVector<QPointF>& scan2 = m_scanBuffer[(m_currentScanIndex + 2) % 3];
+        const QVector<QPointF>& scan3 = m_scanBuffer[(m_currentScanIndex + 1) % 3];
+
+        if (useTiledRaster()) {
+            m_pointImage.fill(Qt::transparent);
+            if (fade) {
+                rasterScan(m_pointImage, scan3, 2);
+                rasterScan(m_pointImage, scan2, 1);
+            }
+            rasterScan(m_pointImage, scan1, 0);
+            painter.save();
+            painter.resetTransform();
+            painter.drawImage(dirty, m_pointImage, dirty);
+            painter.restore();
+            return;
+        }
+
+        if (fade) {
+            drawScan(painter, scan3, 2);
+            drawScan(painter, scan2, 1);
+        }
+        drawScan(painter, scan1, 0);
+    }
+
+    bool useTiledRaster() const
+    {
+        return m_rasterBackend == eRasterBackend::tiled;
+    }
+
+    bool fadeActive() const
+    {
+        return m_fadeEnabled && m_quality < eQuality::noPersistence;
+    }
+
+    bool trailActive() const
+    {
+        return fadeActive() && m_persistence == ePersistence::decay;
+    }
+
+    qint64 timeOf(qint64 nowMs) const
+    {
+        return nowMs >= 0 ? nowMs : m_clock.elapsed();
+    }
+
+    // Keep every other measurement (all layers of it), so layer interleaving is preserved.
+    void decimate(const QVector<QPointF>& src, QVector<QPointF>& dst) const
+    {
+        const int channels = qMax(1, m_channels);
+        dst.resize(0);
+        dst.reserve(src.size() / 2 + channels);
+        for (int i = 0; i + channels <= src.size(); i += channels * 2) {
+            for (int j = 0; j < channels; ++j) dst.append(src[i + j]);
+        }
+    }
+
+    void rasterScan(QImage& target, const QVector<QPointF>& scan, int colorStep)
+    {
+        if (target.isNull() || scan.isEmpty()) return;
+
+        QRgb colors[5];
+        for (int i = 0; i < 5; ++i) {
+            colors[i] = qPremultiply(channelColor[i][colorStep].rgba());
+        }
+        QTransform xform;
+        xform.translate((m_centerPoint + m_centerOffset).x(), (m_centerPoint + m_centerOffset).y());
+        xform.scale(m_zoomRate, m_zoomRate);
+        m_raster.rasterize(target, xform, scan, colors, m_channels, m_visibleLayer, m_PointSize);
+    }
+
+    void drawScan(QPainter& painter, const QVector<QPointF>& scan, int colorStep)
+    {
+        if (scan.isEmpty()) return;
+
+        if (m_channels == 1) {
+            painter.setPen(QPen(channelColor[0][colorStep], m_PointSize / m_zoomRate));
+            for (const QPointF& point : qAsConst(scan)) {
+                painter.drawPoint(point);
+            }
+        }
+        else {
+            int channel = 1;
+            for (const QPointF& point : qAsConst(scan)) {
+                if (m_visibleLayer[channel - 1]) {
+                    painter.setPen(QPen(channelColor[channel - 1][colorStep], m_PointSize / m_zoomRate));
+                    painter.drawPoint(point);
+                }
+                channel++;
+                if (channel > m_channels) channel = 1;
+            }
+        }
+    }
+
+    // Splat a new scan into the accumulation image at full intensity (widget coordinates).
+    void splatTrail(const QVector<QPointF>& scan)
+    {
+        if (m_trailImage.isNull() || scan.isEmpty()) return;
+
+        if (useTiledRaster()) {
+            rasterScan(m_trailImage, scan, 0);
+            return;
+        }
+
+        QPainter painter(&m_trailImage);
+        painter.setRenderHint(QPainter::Antialiasing, m_quality < eQuality::noAntialias);
+        painter.translate(m_centerPoint + m_centerOffset);
+        painter.scale(m_zoomRate, m_zoomRate);
+        drawScan(painter, scan, 0);
+    }
+
+    // Attenuate the accumulation image by factor/256 inside `area` (outside it the image is already 0).
+    // Premultiplied ARGB, so all four bytes scale by the same factor (a plain byte loop, left to the compiler to vectorize).
+    void decayTrail(const QRect& area, quint16 factor)
+    {
+        if (m_trailImage.isNull()) return;
+
+        const QRect r = area & m_trailImage.rect();
+        if (r.isEmpty()) return;
+
+        const int count = r.width() * 4;
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            uchar* bits = m_trailImage.scanLine(y) + r.left() * 4;
+            for (int i = 0; i < count; ++i) {
+                bits[i] = (uchar)((bits[i] * factor) >> 8);
+            }
+        }
+    }
+
+    // Widget-space bounding rect of a scan, grown by the point size, clipped to the view.
+    QRect scanBounds(const QVector<QPointF>& scan) const
+    {
+        if (scan.isEmpty()) return QRect();
+
+        qreal minX = scan[0].x(), maxX = minX, minY = scan[0].y(), maxY = minY;
+        for (const QPointF& p : scan) {
+            if (p.x() < minX) minX = p.x(); else if (p.x() > maxX) maxX = p.x();
+            if (p.y() < minY) minY = p.y(); else if (p.y() > maxY) maxY = p.y();
+        }
+        QRectF r(mapFromScene(QPointF(minX, minY)), mapFromScene(QPointF(maxX, maxY)));
+        int margin = m_PointSize + 2;
+        return r.toAlignedRect().adjusted(-margin, -margin, margin, margin)
+            & QRect(QPoint(0, 0), m_viewSize);
+    }
+
+    void pushScanRect(const QRect& rect, qint64 nowMs)
+    {
+        ScanRect scan = { rect, nowMs };
+        m_scanRects.append(scan);
+        updatePointsRect(nowMs);
+    }
+
+    // Scans still visible on screen: 1 (no fade), 3 (buffered) or, for decay, those younger
+    // than the time a full-intensity pixel takes to reach 0 (ln 255 / ln(1 / cutoff) trail
+    // lengths, plus a margin for the rounded factors). Whatever the trail had outside the
+    // remaining rects is cleared, so nothing is left lit where it is no longer decayed.
+    void updatePointsRect(qint64 nowMs)
+    {
+        const QRect before = m_pointsRect;
+
+        int keep = 1;
+        if (fadeActive() && m_persistence == ePersistence::buffered) {
+            keep = 3;
+        }
+        else if (trailActive()) {
+            const double fadeMs = m_trailLength * m_scanPeriodMs * std::log(255.0) / -std::log(TRAIL_CUTOFF) * 1.25
+                + TRAIL_TICK_MS;
+            keep = 0;
+            while (keep < m_scanRects.size() && nowMs - m_scanRects[m_scanRects.size() - 1 - keep].timeMs <= fadeMs)
+                ++keep;
+        }
+        const int excess = m_scanRects.size() - keep;
+        if (excess > 0) m_scanRects.remove(0, excess);
+
+        m_pointsRect = QRect();
+        for (const ScanRect& s : qAsConst(m_scanRects)) m_pointsRect |= s.rect;
+        m_dirtyRect |= before | m_pointsRect;
+
+        if (trailActive() && !m_trailImage.isNull() && !before.isEmpty()) {
+            for (const QRect& gone : QRegion(before).subtracted(QRegion(m_pointsRect))) {
+                const QRect r = gone & m_trailImage.rect();
+                for (int y = r.top(); y <= r.bottom(); ++y)
+                    memset(m_trailImage.scanLine(y) + r.left() * 4, 0, r.width() * 4);
+            }
+        }
+    }
+
+    // The trail is in widget coordinates, so any view change restarts it from the latest scan.
+    void resetTrail()
+    {
+        m_scanRects.clear();
+        m_pointsRect = QRect();
+        m_dirtyRect = QRect(QPoint(0, 0), m_viewSize);
+        pushScanRect(scanBounds(m_scanBuffer[m_currentScanIndex]), m_lastScanMs >= 0 ? m_lastScanMs : timeOf(-1));
+        m_lastDecayMs = m_lastScanMs; // the latest scan is splatted again at full intensity below
+
+        if (m_trailImage.isNull()) return;
+
+        m_trailImage.fill(Qt::transparent);
+        if (fadeActive() && m_persistence == ePersistence::decay) {
+            splatTrail(m_scanBuffer[m_currentScanIndex]);
+        }
+    }
+
+    // Largest distance from the map center to any viewport corner, in scene units.
+    float sceneExtent(bool includeHeight) const
+    {
+        qreal absX = std::abs(m_centerOffset.x());
+        qreal absY = std::abs(m_centerOffset.y());
+        qreal absW = absX >= absY ? absX : absY;
+        float sceneSize = (absW + m_viewSize.width()) / m_zoomRate;
+        if (includeHeight && (absW + m_viewSize.height()) / m_zoomRate > sceneSize)
+            sceneSize = (absW + m_viewSize.height()) / m_zoomRate;
+        return sceneSize;
+    }
+
+    void drawCrosshair(QPainter& painter)
+    {
+        painter.setPen(penGrid);
+        float m_sceneSizeMax = sceneExtent(false);
+
+        painter.drawLine(-m_sceneSizeMax, 0, m_sceneSizeMax, 0);
+        painter.drawLine(0, -m_sceneSizeMax, 0, m_sceneSizeMax);
+    }
+
+    void drawFieldOfView(QPainter& painter)
+    {
+        painter.setPen(penFoV);
+
+        float sceneSize = sceneExtent(true);
+
+        float radStart = m_angleOffset * M_PI / 180.0;
+        float x1 = sceneSize * std::cos(radStart);
+        float y1 = -sceneSize * std::sin(radStart);
+        painter.drawLine(QPointF(0, 0), QPointF(x1, y1));
+
+        if (m_fov < 360) {
+            float endAngle = m_isClockwise ? (m_angleOffset - m_fov) : (m_angleOffset + m_fov);
+            float radEnd = endAngle * M_PI / 180.0;
+            float x2 = sceneSize * std::cos(radEnd);
+            float y2 = -sceneSize * std::sin(radEnd);
+            painter.drawLine(QPointF(0, 0), QPointF(x2, y2));
+        }
+    }
+
+    void drawHighlight(QPainter& painter)
+    {
+        if (m_hoverRow >= 0 && m_scanIndex && m_hoverRow < m_scanIndex->count()) {
+            const CScanIndex::Entry& e = m_scanIndex->entry(m_hoverRow);
+            float radius = 6.0f / m_zoomRate;
+            painter.setPen(QPen(Qt::white, 1.0 / m_zoomRate));
+            painter.setBrush(Qt::NoBrush);
+            painter.drawEllipse(QPointF(e.x, e.y), radius, radius);
+
+            QPoint center = mapFromScene(QPointF(e.x, e.y)).toPoint();
+            m_hoverMarkRect = QRect(center - QPoint(8, 8), QSize(17, 17));
+        }
+        else {
+            m_hoverMarkRect = QRect();
+        }
+
+        if (m_highlights.isEmpty()) return;
+
+        float crossSize = 10.0f / m_zoomRate;
+
+        QMapIterator<Qt::GlobalColor, HighlightData> i(m_highlights);
+        while (i.hasNext()) {
+            i.next();
+            const HighlightData& data = i.value();
+
+            if (!data.active) continue;
+
+            // 타입별 색상 적용 (설정된 색상 사용)
+            penHighlight.setColor(i.key());
+            penHighlight.setWidthF(2.0 / m_zoomRate);
+            painter.setPen(penHighlight);
+
+            painter.drawLine(data.pos - QPointF(crossSize, 0), data.pos + QPointF(crossSize, 0));
+            painter.drawLine(data.pos - QPointF(0, crossSize), data.pos + QPointF(0, crossSize));
+        }
+    }
+
+    void drawConcCircles(QPainter& painter)
+    {
+        float sceneSize = sceneExtent(true);
+
+        int maxVisibleMeter = (int)(sceneSize / m_pixelsPerMeter) + 1;
+
+        for (int i = 1; i <= maxVisibleMeter; ++i) {
+            float radius = i * m_pixelsPerMeter;
+            int gridType = (i % m_concCircleStep);
+
+            if (gridType == 0) {
+                painter.setPen(penThick);
+            }
+            else if (i <= m_maxConcCircles) {
+                painter.setPen(penThin);
+            }
+            else {
+                continue;
+            }
+
+            painter.drawEllipse(QPointF(0, 0), radius, radius);
+        }
+    }
+
+    // Labels for the thick rings, on the 45 degree diagonal (screen coordinates, not scaled).
+    void drawRingLabels(QPainter& painter)
+    {
+        float sceneSize = sceneExtent(true);
+        int maxVisibleMeter = (int)(sceneSize / m_pixelsPerMeter) + 1;
+        const QRectF view(QPointF(0, 0), m_viewSize);
+        const float diag = (float)M_SQRT1_2;
+
+        painter.setFont(m_labelFont);
+        painter.setPen(lineThick.color);
+        for (int i = m_concCircleStep; i <= maxVisibleMeter; i += m_concCircleStep) {
+            float radius = i * m_pixelsPerMeter;
+            QPointF pos = mapFromScene(QPointF(radius * diag, -radius * diag)) + QPointF(3, -14);
+            if (!view.contains(pos)) continue;
+
+            QStaticText& label = m_ringLabels[i];
+            if (label.text().isEmpty()) {
+                label.setText(QString("%1 m").arg(i));
+                label.prepare(QTransform(), m_labelFont);
+            }
+            painter.drawStaticText(pos, label);
+        }
+    }
+
+    void drawInfoText(QPainter& painter, distanceInfo& info, const QPoint& pos, const QColor& color)
+    {
+        if (info.info.isEmpty()) return;
+
+        if (info.preparedInfo != info.info) {
+            info.staticText.setText(info.info);
+            info.staticText.setTextFormat(Qt::PlainText);
+            info.staticText.setTextWidth(INFO_WIDTH);
+            info.staticText.setTextOption(m_infoOption);
+            info.staticText.prepare(QTransform(), m_infoFont);
+            info.preparedInfo = info.info;
+        }
+        painter.setPen(color);
+        painter.drawStaticText(pos, info.staticText);
+        info.textRect = QRect(pos, info.staticText.size().toSize());
+    }
+
+    void drawInfo(QPainter& painter)
+    {
+        painter.setFont(m_infoFont);
+        drawInfoText(painter, nomalInfo, normalInfoPos(), Qt::white);
+        drawInfoText(painter, m_fixedInfo, fixedInfoPos(), Qt::yellow);
+        drawInfoText(painter, m_hoverInfo, hoverInfoPos(), Qt::lightGray);
+    }
+
+    // Info text layout, shared by drawInfo and takeDirtyRegion: three INFO_WIDTH x INFO_HEIGHT
+    // blocks (normal and fixed at the top left, hover at the bottom left).
+    enum { INFO_MARGIN = 10, INFO_WIDTH = 240, INFO_HEIGHT = 90 };
+
+    QPoint normalInfoPos() const { return QPoint(INFO_MARGIN, INFO_MARGIN); }
+    QPoint fixedInfoPos() const { return QPoint(INFO_MARGIN, INFO_MARGIN + INFO_HEIGHT); }
+    QPoint hoverInfoPos() const { return QPoint(INFO_MARGIN, m_viewSize.height() - INFO_MARGIN - INFO_HEIGHT); }
+
+    // Area to repaint for one text: its block, grown to the text last drawn and the one laid out now.
+    QRect infoBlock(const distanceInfo& info, const QPoint& pos) const
+    {
+        QRect block(pos, QSize(INFO_WIDTH, INFO_HEIGHT));
+        block |= info.textRect;
+        if (!info.preparedInfo.isEmpty()) block |= QRect(pos, info.staticText.size().toSize());
+        return block;
+    }
+
+    QVector<QPointF> m_scanBuffer[3];
+    int m_currentScanIndex;
+
+    bool    m_visibleLayer[8];
+    QSize   m_viewSize;
+    QPointF m_centerOffset;
+    QPointF m_centerPoint;
+    int     m_PointSize = 2;
+
+    float   m_zoomRate = 1.000f;
+    float   m_pixelsPerMeter = 100.0f;
+    int     m_maxConcCircles = 100;
+    int     m_concCircleStep = 5;
+    int     m_channels = 1;
+    int     m_fov = 360;
+    float   m_resolution = 0.3f;
+
+    struct lineInfo {
+        double thickness;
+        Qt::GlobalColor color;
+        Qt::PenStyle pattern;
+    };
+    lineInfo lineThin = { 0.5, Qt::gray, Qt::SolidLine };
+    lineInfo lineThick = { 1, Qt::darkRed, Qt::SolidLine };
+    QPen penThin;
+    QPen penThick;
+    QPen penGrid;
+    QPen penFoV;
+    distanceInfo nomalInfo, m_fixedInfo;
+
+    bool        m_overlayEnabled = true;
+    QFont       m_infoFont;
+    QFont       m_labelFont;
+    QTextOption m_infoOption;
+    QHash<int, QStaticText> m_ringLabels; // meter -> label
+
+    QPen penHighlight;
+
+    QMap<Qt::GlobalColor, HighlightData> m_highlights;
+    bool    m_isHighlightActive; // (이제 개별 Data.active 사용)
+
+    bool  m_fadeEnabled;
+    ePersistence m_persistence;
+    int     m_trailLength;
+    double  m_scanPeriodMs = 100.0; // average time between lumos() calls
+    qint64  m_lastScanMs = -1;
+    qint64  m_lastDecayMs = -1;
+    QElapsedTimer m_clock;
+    QImage  m_trailImage;
+    static constexpr double TRAIL_CUTOFF = 24.0 / 255.0;
+
+    eRasterBackend m_rasterBackend = eRasterBackend::painter;
+    CPointRaster m_raster;
+    QImage  m_pointImage;
+    eQuality m_quality = eQuality::full;
+
+    // Dirty-region tracking (widget coordinates)
+    struct ScanRect {
+        QRect rect;
+        qint64 timeMs;
+    };
+    QVector<ScanRect> m_scanRects; // bounds of the scans still on screen (updatePointsRect)
+    QRect   m_pointsRect;       // union of m_scanRects
+    QRect   m_dirtyRect;
+    QRect   m_hoverMarkRect;
+
+    float m_angleOffset;
+    bool  m_isClockwise;
+    QString m_distanceUnit;
+
+    static constexpr float PICK_RADIUS = 12.0f;
+    const CScanIndex* m_scanIndex = nullptr;
+    int     m_hoverRow = -1;
+    distanceInfo m_hoverInfo;
+};
+
+#endif // CMAPRENDERER_H
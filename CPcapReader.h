@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPCAPREADER_H
+#define CPCAPREADER_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QVector>
+#include <QJsonObject>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+#include "CScanRecord.h"
+
+/**
+ * @brief Sensor frames from a tcpdump capture (pcap or pcapng), memory-mapped.
+ *
+ * UDP datagrams sent from the sensor port are joined into frames the way
+ * CommUDP::recvProc joins them: until frameBytes are collected, or until the
+ * next request to the sensor port is seen. The index keeps one entry per frame
+ * (offset of its first packet, time, size); frame() walks the packets again
+ * from there, zero-copy when the frame is a single unfragmented datagram.
+ *
+ * Link types: Ethernet (with VLAN tags), BSD loopback, raw IP, Linux SLL/SLL2.
+ * IPv4 fragments are reassembled when they arrive in order; IPv6 extension
+ * headers are not followed.
+ */
+class CPcapReader : public IFrameSource
+{
+public:
+    enum { DEFAULT_PORT = 47777 };
+
+    CPcapReader(quint16 port = DEFAULT_PORT, int frameBytes = 0)
+        : m_port(port), m_frameBytes(frameBytes) {}
+    ~CPcapReader() { close(); }
+
+    static bool isCapture(const QString& path)
+    {
+        return path.endsWith(".pcap", Qt::CaseInsensitive) || path.endsWith(".pcapng", Qt::CaseInsensitive)
+            || path.endsWith(".cap", Qt::CaseInsensitive);
+    }
+
+    // Both take effect on the next open().
+    void setPort(quint16 port) { m_port = port; }
+    void setFrameBytes(int bytes) { m_frameBytes = bytes; } // 0: one datagram per frame
+
+    bool open(const QString& path) override
+    {
+        close();
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::ReadOnly)) return false;
+
+        m_size = m_file.size();
+        m_base = m_size > 0 ? m_file.map(0, m_size) : nullptr;
+        if (!m_base || !readFileHeader()) {
+            close();
+            return false;
+        }
+        buildIndex();
+        return true;
+    }
+
+    void close() override
+    {
+        if (m_base) m_file.unmap(m_base);
+        m_base = nullptr;
+        m_file.close();
+        m_index.clear();
+        m_sections.clear();
+        m_datagrams = 0;
+    }
+
+    bool isOpen() const override { return m_base != nullptr; }
+    int frameCount() const override { return m_index.size(); }
+    int datagramCount() const { return m_datagrams; } // from the sensor port
+
+    quint64 frameTimeNs(int i) const override { return m_index[i].timeNs - m_index[0].timeNs; }
+    int frameSize(int i) const override { return (i >= 0 && i < m_index.size()) ? m_index[i].bytes : -1; }
+
+    quint64 durationNs() const override
+    {
+        return m_index.isEmpty() ? 0 : m_index.last().timeNs - m_index.first().timeNs;
+    }
+
+    const QJsonObject& config() const override { return m_config; }
+    quint32 configHash() const override { return 0; }
+
+    bool frame(int i, Frame* out) const override
+    {
+        if (i < 0 || i >= m_index.size()) return false;
+        const Entry& e = m_index[i];
+
+        Cursor cur = { e.offset, e.section };
+        Reassembly ra;
+        Datagram d;
+        int collected = 0;
+        m_frame.resize(0);
+        while (collected < e.bytes && nextDatagram(cur, ra, &d, false)) {
+            if (!isReply(d)) continue;
+            if (collected == 0 && d.size >= e.bytes && !d.reassembled) {
+                out->data = QByteArray::fromRawData((const char*)d.data, e.bytes);
+                collected = e.bytes;
+                break;
+            }
+            m_frame.append((const char*)d.data, d.size);
+            collected += d.size;
+        }
+        if (m_frame.size() > 0) out->data = m_frame;
+        out->timeNs = e.timeNs - m_index[0].timeNs;
+        out->linkId = 0;
+        out->configHash = 0;
+        return collected > 0;
+    }
+
+    int seek(quint64 timeNs) const override
+    {
+        if (m_index.isEmpty()) return 0;
+        const quint64 t = m_index[0].timeNs + timeNs;
+        auto it = std::lower_bound(m_index.constBegin(), m_index.constEnd(), t,
+            [](const Entry& e, quint64 v) { return e.timeNs < v; });
+        return qMin(int(it - m_index.constBegin()), m_index.size() - 1);
+    }
+
+private:
+    enum {
+        PCAP_HEADER_SIZE = 24, PCAP_RECORD_SIZE = 16,
+        NG_SHB = 0x0A0D0D0A, NG_IDB = 1, NG_OPB = 2, NG_SPB = 3, NG_EPB = 6,
+        NG_BYTE_ORDER = 0x1A2B3C4D,
+        LINK_NULL = 0, LINK_ETHERNET = 1, LINK_RAW_OLD = 12, LINK_RAW_OLD2 = 14, LINK_RAW = 101,
+        LINK_LOOP = 108, LINK_SLL = 113, LINK_IPV4 = 228, LINK_IPV6 = 229, LINK_SLL2 = 276,
+    };
+
+    struct Iface {
+        int linkType;
+        quint64 unitsPerSec;
+    };
+
+    struct Section {
+        bool swap;
+        QVector<Iface> ifaces;
+    };
+
+    struct Entry {
+        quint64 offset;   // first packet record of the frame
+        quint64 timeNs;   // capture time
+        int bytes;
+        int section;
+    };
+
+    struct Cursor {
+        quint64 pos;
+        int section;
+    };
+
+    struct Packet {
+        quint64 offset;
+        quint64 timeNs;
+        int linkType;
+        const uchar* data;
+        int size;
+    };
+
+    struct Datagram {
+        quint64 offset;   // record of the first fragment
+        quint64 timeNs;
+        quint16 srcPort, dstPort;
+        const uchar* data;
+        int size;
+        bool reassembled;
+    };
+
+    struct Reassembly {
+        QByteArray buf;
+        quint32 src = 0, dst = 0;
+        quint16 id = 0;
+        quint64 offset = 0, timeNs = 0;
+        bool active = false;
+    };
+
+    // Shared by buildIndex() and frame(), so both see the same datagrams. Replies come from
+    // the sensor port; one from that port to itself (client bound to the same port) is a reply.
+    bool isReply(const Datagram& d) const { return d.srcPort == m_port; }
+    bool isRequest(const Datagram& d) const { return d.dstPort == m_port && d.srcPort != m_port; }
+
+    quint16 rd16(const uchar* p, bool swap) const { return swap ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p); }
+    quint32 rd32(const uchar* p, bool swap) const { return swap ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p); }
+
+    static quint64 toNs(quint64 ts, quint64 unitsPerSec)
+    {
+        if (unitsPerSec == 1000000000ULL) return ts;
+        return (ts / unitsPerSec) * 1000000000ULL + (ts % unitsPerSec) * 1000000000ULL / unitsPerSec;
+    }
+
+    bool readFileHeader()
+    {
+        if (m_size < 12) return false;
+        const quint32 magic = qFromLittleEndian<quint32>(m_base);
+        if (magic == NG_SHB) {
+            m_pcapng = true;
+            m_dataStart = 0; // sections are read while walking
+            return true;
+        }
+
+        bool swap, nano;
+        switch (magic) {
+        case 0xA1B2C3D4: swap = false; nano = false; break;
+        case 0xD4C3B2A1: swap = true;  nano = false; break;
+        case 0xA1B23C4D: swap = false; nano = true;  break;
+        case 0x4D3CB2A1: swap = true;  nano = true;  break;
+        default: return false;
+        }
+        if (m_size < PCAP_HEADER_SIZE) return false;
+
+        m_pcapng = false;
+        m_dataStart = PCAP_HEADER_SIZE;
+        Section section;
+        section.swap = swap;
+        section.ifaces.append({ int(rd32(m_base + 20, swap) & 0xFFFF), nano ? 1000000000ULL : 1000000ULL });
+        m_sections.append(section);
+        return true;
+    }
+
+    void buildIndex()
+    {
+        Cursor cur = { m_dataStart, m_pcapng ? -1 : 0 };
+        Reassembly ra;
+        Datagram d;
+        Entry entry = { 0, 0, 0, 0 };
+        bool inFrame = false;
+
+        while (nextDatagram(cur, ra, &d, true)) {
+            if (isRequest(d)) { // the reply so far is a frame
+                if (inFrame) m_index.append(entry);
+                inFrame = false;
+                continue;
+            }
+            if (!isReply(d)) continue;
+
+            ++m_datagrams;
+            if (!inFrame) {
+                entry = { d.offset, d.timeNs, 0, cur.section };
+                inFrame = true;
+            }
+            entry.bytes += d.size;
+            if (m_frameBytes <= 0 || entry.bytes >= m_frameBytes) {
+                m_index.append(entry);
+                inFrame = false;
+            }
+        }
+        if (inFrame) m_index.append(entry);
+    }
+
+    // Next captured packet; pcapng section and interface blocks are consumed on the way
+    // (recorded when indexing, skipped when re-reading a frame).
+    bool nextPacket(Cursor& cur, Packet* out, bool indexing) const
+    {
+        while (true) {
+            if (!m_pcapng) {
+                if (cur.pos + PCAP_RECORD_SIZE > (quint64)m_size) return false;
+                const Section& s = m_sections[0];
+                const uchar* r = m_base + cur.pos;
+                quint32 capLen = rd32(r + 8, s.swap);
+                if (cur.pos + PCAP_RECORD_SIZE + capLen > (quint64)m_size) return false;
+                out->offset = cur.pos;
+                out->timeNs = rd32(r, s.swap) * 1000000000ULL + toNs(rd32(r + 4, s.swap), s.ifaces[0].unitsPerSec);
+                out->linkType = s.ifaces[0].linkType;
+                out->data = r + PCAP_RECORD_SIZE;
+                out->size = (int)capLen;
+                cur.pos += PCAP_RECORD_SIZE + capLen;
+                return true;
+            }
+
+            if (cur.pos + 12 > (quint64)m_size) return false;
+            const uchar* b = m_base + cur.pos;
+            const quint64 offset = cur.pos;
+
+            if (qFromLittleEndian<quint32>(b) == NG_SHB) {
+                quint32 order = qFromLittleEndian<quint32>(b + 8);
+                bool swap = (order != NG_BYTE_ORDER);
+                if (swap && qFromBigEndian<quint32>(b + 8) != NG_BYTE_ORDER) return false;
+                quint32 len = rd32(b + 4, swap);
+                if (len < 28 || offset + len > (quint64)m_size) return false;
+                ++cur.section;
+                if (indexing) m_sections.append({ swap, QVector<Iface>() });
+                cur.pos += len;
+                continue;
+            }
+            if (cur.section < 0 || cur.section >= m_sections.size()) return false;
+            Section& s = m_sections[cur.section];
+            const quint32 type = rd32(b, s.swap);
+            const quint32 len = rd32(b + 4, s.swap);
+            if (len < 12 || (len & 3) || offset + len > (quint64)m_size) return false;
+            cur.pos += len;
+
+            if (type == NG_IDB) {
+                if (indexing && len >= 20) s.ifaces.append({ rd16(b + 8, s.swap), tsResolution(b + 16, b + len - 4, s.swap) });
+                continue;
+            }
+            if (type == NG_EPB || type == NG_OPB) {
+                if (len < 32) continue;
+                quint32 ifId = (type == NG_EPB) ? rd32(b + 8, s.swap) : rd16(b + 8, s.swap);
+                quint32 capLen = rd32(b + 20, s.swap);
+                if (ifId >= (quint32)s.ifaces.size() || 28 + (quint64)capLen > len - 4) continue; // len >= 32
+                quint64 ts = ((quint64)rd32(b + 12, s.swap) << 32) | rd32(b + 16, s.swap);
+                out->offset = offset;
+                out->timeNs = toNs(ts, s.ifaces[ifId].unitsPerSec);
+                out->linkType = s.ifaces[ifId].linkType;
+                out->data = b + 28;
+                out->size = (int)capLen;
+                return true;
+            }
+            if (type == NG_SPB) {
+                if (len < 16 || s.ifaces.isEmpty()) continue;
+                out->offset = offset;
+                out->timeNs = m_lastTimeNs; // no timestamp in a simple packet block
+                out->linkType = s.ifaces[0].linkType;
+                out->data = b + 12;
+                out->size = (int)qMin<quint32>(rd32(b + 8, s.swap), len - 16);
+                return true;
+            }
+        }
+    }
+
+    // if_tsresol (option 9): 10^-n, or 2^-n when the high bit is set; default microseconds.
+    quint64 tsResolution(const uchar* opt, const uchar* end, bool swap) const
+    {
+        while (opt + 4 <= end) {
+            quint16 code = rd16(opt, swap), len = rd16(opt + 2, swap);
+            if (code == 0) break;
+            if (code == 9 && len >= 1 && opt + 5 <= end) {
+                quint8 v = opt[4];
+                if (v & 0x80) return (v & 0x7F) < 63 ? (1ULL << (v & 0x7F)) : 1000000ULL;
+                quint64 units = 1;
+                for (int i = 0; i < (v & 0x7F) && i < 19; ++i) units *= 10;
+                return units;
+            }
+            opt += 4 + ((len + 3) & ~3);
+        }
+        return 1000000ULL;
+    }
+
+    // Next UDP datagram (any port) from the link layer up.
+    bool nextDatagram(Cursor& cur, Reassembly& ra, Datagram* out, bool indexing) const
+    {
+        Packet pkt;
+        while (nextPacket(cur, &pkt, indexing)) {
+            m_lastTimeNs = pkt.timeNs;
+            const uchar* p = pkt.data;
+            int n = pkt.size;
+            int etherType = -1;
+
+            switch (pkt.linkType) {
+            case LINK_ETHERNET:
+                if (n < 14) continue;
+                etherType = qFromBigEndian<quint16>(p + 12);
+                p += 14; n -= 14;
+                while ((etherType == 0x8100 || etherType == 0x88A8) && n >= 4) {
+                    etherType = qFromBigEndian<quint16>(p + 2);
+                    p += 4; n -= 4;
+                }
+                break;
+            case LINK_NULL: case LINK_LOOP:
+                if (n < 4) continue;
+                p += 4; n -= 4;
+                break;
+            case LINK_SLL:
+                if (n < 16) continue;
+                etherType = qFromBigEndian<quint16>(p + 14);
+                p += 16; n -= 16;
+                break;
+            case LINK_SLL2:
+                if (n < 20) continue;
+                etherType = qFromBigEndian<quint16>(p);
+                p += 20; n -= 20;
+                break;
+            case LINK_RAW: case LINK_RAW_OLD: case LINK_RAW_OLD2: case LINK_IPV4: case LINK_IPV6:
+                break;
+            default:
+                continue;
+            }
+            if (n < 1) continue;
+            if (etherType < 0) etherType = ((p[0] >> 4) == 6) ? 0x86DD : 0x0800;
+
+            const uchar* l4 = nullptr;
+            int l4Size = 0;
+            quint64 firstOffset = pkt.offset, firstTime = pkt.timeNs;
+            bool reassembled = false;
+
+            if (etherType == 0x0800) {
+                if (n < 20 || (p[0] >> 4) != 4) continue;
+                int ihl = (p[0] & 0x0F) * 4;
+                int total = qMin<int>(qFromBigEndian<quint16>(p + 2), n);
+                if (ihl < 20 || total < ihl || p[9] != 17) continue;
+                quint16 frag = qFromBigEndian<quint16>(p + 6);
+                bool more = frag & 0x2000;
+                int fragOffset = (frag & 0x1FFF) * 8;
+
+                if (!more && fragOffset == 0) {
+                    l4 = p + ihl;
+                    l4Size = total - ihl;
+                }
+                else {
+                    quint32 src = qFromBigEndian<quint32>(p + 12), dst = qFromBigEndian<quint32>(p + 16);
+                    quint16 id = qFromBigEndian<quint16>(p + 4);
+                    if (fragOffset == 0) {
+                        ra.buf.resize(0);
+                        ra.src = src; ra.dst = dst; ra.id = id;
+                        ra.offset = pkt.offset; ra.timeNs = pkt.timeNs;
+                        ra.active = true;
+                    }
+                    else if (!ra.active || ra.src != src || ra.dst != dst || ra.id != id || fragOffset != ra.buf.size()) {
+                        ra.active = false; // out of order or lost fragment: drop the datagram
+                        continue;
+                    }
+                    ra.buf.append((const char*)p + ihl, total - ihl);
+                    if (more) continue;
+                    ra.active = false;
+                    l4 = (const uchar*)ra.buf.constData();
+                    l4Size = ra.buf.size();
+                    firstOffset = ra.offset;
+                    firstTime = ra.timeNs;
+                    reassembled = true;
+                }
+            }
+            else if (etherType == 0x86DD) {
+                if (n < 40 || (p[0] >> 4) != 6 || p[6] != 17) continue;
+                l4 = p + 40;
+                l4Size = qMin<int>(qFromBigEndian<quint16>(p + 4), n - 40);
+            }
+            else {
+                continue;
+            }
+
+            if (l4Size < 8) continue;
+            int udpLen = qMin<int>(qFromBigEndian<quint16>(l4 + 4), l4Size);
+            if (udpLen < 8) continue;
+
+            out->offset = firstOffset;
+            out->timeNs = firstTime;
+            out->srcPort = qFromBigEndian<quint16>(l4);
+            out->dstPort = qFromBigEndian<quint16>(l4 + 2);
+            out->data = l4 + 8;
+            out->size = udpLen - 8;
+            out->reassembled = reassembled;
+            return true;
+        }
+        return false;
+    }
+
+    QFile m_file;
+    uchar* m_base = nullptr;
+    qint64 m_size = 0;
+    bool m_pcapng = false;
+    quint64 m_dataStart = 0;
+    mutable QVector<Section> m_sections; // grows while indexing (const walk)
+    mutable quint64 m_lastTimeNs = 0;
+
+    quint16 m_port;
+    int m_frameBytes;
+    QVector<Entry> m_index;
+    int m_datagrams = 0;
+    QJsonObject m_config;
+    mutable QByteArray m_frame;
+};
+
+#endif // CPCAPREADER_H
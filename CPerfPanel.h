@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPERFPANEL_H
+#define CPERFPANEL_H
+
+#include <QtWidgets>
+#include <QtGui>
+#include <QtCore>
+#include <memory>
+
+#include "CStageTimer.h"
+
+/**
+ * @brief Live view of CStageTimer: p50 / p99 / max per stage, scan Hz, render FPS, bytes/s.
+ *
+ * Refreshes every REFRESH_MS while visible over the last WINDOW_REFRESHES
+ * snapshots. Every refresh is also kept in a history ring; Export writes the
+ * history (.csv) or the history plus the full histograms since Reset (.json).
+ */
+class CPerfPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    enum { REFRESH_MS = 500, WINDOW_REFRESHES = 4, HISTORY = 1200 };
+    enum eColumn { colP50, colP99, colMax, colRate, COLUMN_COUNT };
+
+    CPerfPanel(QWidget* parent = nullptr) : QWidget(parent)
+    {
+        QVBoxLayout* layout = new QVBoxLayout(this);
+
+        m_rates = new QLabel(this);
+        layout->addWidget(m_rates);
+
+        m_table = new QTableWidget(CStageTimer::STAGE_COUNT, COLUMN_COUNT, this);
+        m_table->setHorizontalHeaderLabels({ "p50 (us)", "p99 (us)", "max (us)", "/s" });
+        QStringList stages;
+        for (int s = 0; s < CStageTimer::STAGE_COUNT; ++s) stages << CStageTimer::name((CStageTimer::eStage)s);
+        m_table->setVerticalHeaderLabels(stages);
+        m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+        for (int s = 0; s < CStageTimer::STAGE_COUNT; ++s) {
+            for (int c = 0; c < COLUMN_COUNT; ++c) {
+                QTableWidgetItem* item = new QTableWidgetItem();
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                m_table->setItem(s, c, item);
+            }
+        }
+        layout->addWidget(m_table);
+
+        QHBoxLayout* buttons = new QHBoxLayout();
+        m_enableCheck = new QCheckBox("Enabled", this);
+        m_enableCheck->setChecked(CStageTimer::isEnabled());
+        m_enableCheck->setToolTip("Stage timers on (a clock read per stage)");
+        buttons->addWidget(m_enableCheck);
+        buttons->addStretch(1);
+        QPushButton* reset = new QPushButton("Reset", this);
+        QPushButton* exportButton = new QPushButton("Export...", this);
+        buttons->addWidget(reset);
+        buttons->addWidget(exportButton);
+        layout->addLayout(buttons);
+
+        connect(m_enableCheck, &QCheckBox::toggled, this, [](bool on) { CStageTimer::setEnabled(on); });
+        connect(reset, &QPushButton::clicked, this, &CPerfPanel::reset);
+        connect(exportButton, &QPushButton::clicked, this, &CPerfPanel::onExport);
+        connect(&m_refresh, &QTimer::timeout, this, &CPerfPanel::refresh);
+
+        m_origin.reset(new CStageTimer::Snapshot);
+        reset();
+    }
+
+    // Histograms and history start over from now.
+    void reset()
+    {
+        CStageTimer::snapshot(m_origin.get());
+        m_window.clear();
+        m_window.append(std::make_shared<CStageTimer::Snapshot>(*m_origin));
+        m_history.clear();
+        refresh();
+    }
+
+    // CSV: one row per refresh. JSON: rows plus the histograms since Reset.
+    bool exportTo(const QString& path) const
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+
+        if (path.endsWith(".csv", Qt::CaseInsensitive)) {
+            QTextStream out(&file);
+            out << "time_s,scan_hz,render_fps,bytes_per_s";
+            for (int s = 0; s < CStageTimer::STAGE_COUNT; ++s) {
+                const QString n = CStageTimer::name((CStageTimer::eStage)s);
+                out << "," << n << "_count," << n << "_p50_us," << n << "_p99_us," << n << "_max_us";
+            }
+            out << "\n";
+            for (const Row& row : m_history) {
+                out << row.timeS << "," << row.scanHz << "," << row.fps << "," << row.bytesPerSec;
+                for (int s = 0; s < CStageTimer::STAGE_COUNT; ++s) {
+                    const CStageTimer::Summary& sum = row.stages[s];
+                    out << "," << sum.count << "," << sum.p50Us << "," << sum.p99Us << "," << sum.maxUs;
+                }
+                out << "\n";
+            }
+            return out.status() == QTextStream::Ok;
+        }
+
+        CStageTimer::Snapshot now;
+        CStageTimer::snapshot(&now);
+        QJsonObject stages;
+        for (int s = 0; s < CStageTimer::STAGE_COUNT; ++s) {
+            const CStageTimer::Summary sum = CStageTimer::summarize(now, *m_origin, (CStageTimer::eStage)s);
+            QJsonArray buckets; // [lowerNs, upperNs, count], non-empty only
+            for (int k = 0; k < CStageTimer::BUCKETS; ++k) {
+                quint64 c = now.counts[s][k] - m_origin->counts[s][k];
+                if (c) buckets.append(QJsonArray{ double(CStageTimer::bucketLowerNs(k)), double(CStageTimer::bucketUpperNs(k)), double(c) });
+            }
+            stages[CStageTimer::name((CStageTimer::eStage)s)] = QJsonObject{
+                { "count", double(sum.count) }, { "p50Us", sum.p50Us }, { "p99Us", sum.p99Us },
+                { "maxUs", sum.maxUs }, { "buckets", buckets } };
+        }
+        QJsonArray history;
+        for (const Row& row : m_history) {
+            QJsonObject r{ { "timeS", row.timeS }, { "scanHz", row.scanHz }, { "fps", row.fps }, { "bytesPerSec", row.bytesPerSec } };
+            for (int s = 0; s < CStageTimer::STAGE_COUNT; ++s) {
+                const CStageTimer::Summary& sum = row.stages[s];
+                r[CStageTimer::name((CStageTimer::eStage)s)] = QJsonArray{ double(sum.count), sum.p50Us, sum.p99Us, sum.maxUs };
+            }
+            history.append(r);
+        }
+        QJsonObject root{
+            { "exported", QDateTime::currentDateTime().toString(Qt::ISODate) },
+            { "seconds", (now.timeNs - m_origin->timeNs) / 1e9 },
+            { "bytes", double(now.bytes - m_origin->bytes) },
+            { "stages", stages },
+            { "historyColumns", QJsonArray{ "count", "p50Us", "p99Us", "maxUs" } },
+            { "history", history } };
+        return file.write(QJsonDocument(root).toJson()) > 0;
+    }
+
+protected:
+    void showEvent(QShowEvent* event) override
+    {
+        QWidget::showEvent(event);
+        refresh();
+        m_refresh.start(REFRESH_MS);
+    }
+
+    void hideEvent(QHideEvent* event) override
+    {
+        QWidget::hideEvent(event);
+        m_refresh.stop();
+    }
+
+private:
+    struct Row {
+        double timeS, scanHz, fps, bytesPerSec;
+        CStageTimer::Summary stages[CStageTimer::STAGE_COUNT];
+    };
+
+    void refresh()
+    {
+        std::shared_ptr<CStageTimer::Snapshot> now = std::make_shared<CStageTimer::Snapshot>();
+        CStageTimer::snapshot(now.get());
+        const CStageTimer::Snapshot& from = *m_window.first();
+        const double sec = qMax<qint64>(1, now->timeNs - from.timeNs) / 1e9;
+
+        Row row;
+        row.timeS = (now->timeNs - m_origin->timeNs) / 1e9;
+        for (int s = 0; s < CStageTimer::STAGE_COUNT; ++s) {
+            row.stages[s] = CStageTimer::summarize(*now, from, (CStageTimer::eStage)s);
+            const CStageTimer::Summary& sum = row.stages[s];
+            m_table->item(s, colP50)->setText(sum.count ? QString::number(sum.p50Us, 'f', 1) : "-");
+            m_table->item(s, colP99)->setText(sum.count ? QString::number(sum.p99Us, 'f', 1) : "-");
+            m_table->item(s, colMax)->setText(sum.count ? QString::number(sum.maxUs, 'f', 1) : "-");
+            m_table->item(s, colRate)->setText(QString::number(sum.count / sec, 'f', 1));
+        }
+        row.scanHz = row.stages[(int)CStageTimer::eStage::scan].count / sec;
+        row.fps = row.stages[(int)CStageTimer::eStage::paint].count / sec;
+        row.bytesPerSec = (now->bytes - from.bytes) / sec;
+        m_rates->setText(QString("Scan %1 Hz   Render %2 FPS   %3 KB/s")
+            .arg(row.scanHz, 0, 'f', 1).arg(row.fps, 0, 'f', 1).arg(row.bytesPerSec / 1024.0, 0, 'f', 1));
+
+        if (m_history.size() >= HISTORY) m_history.removeFirst();
+        m_history.append(row);
+        m_window.append(now);
+        while (m_window.size() > WINDOW_REFRESHES) m_window.removeFirst();
+    }
+
+    void onExport()
+    {
+        QString path = QFileDialog::getSaveFileName(this, "Export Performance",
+            QDateTime::currentDateTime().toString("'perf_'yyyyMMdd_hhmmss'.json'"),
+            "Histograms and history (*.json);;History (*.csv)");
+        if (path.isEmpty()) return;
+        if (!exportTo(path)) QMessageBox::warning(this, "Export Performance", "Couldn't write " + path);
+    }
+
+    QLabel* m_rates;
+    QTableWidget* m_table;
+    QCheckBox* m_enableCheck;
+    QTimer m_refresh;
+    std::unique_ptr<CStageTimer::Snapshot> m_origin;
+    QVector<std::shared_ptr<CStageTimer::Snapshot>> m_window;
+    QVector<Row> m_history;
+};
+
+#endif // CPERFPANEL_H
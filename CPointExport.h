@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPOINTEXPORT_H
+#define CPOINTEXPORT_H
+
+#include <QIODevice>
+#include <QItemSelection>
+#include <QtEndian>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "CPointTableModel.h"
+
+/**
+ * @brief Streams Point Viewer rows as CSV, TSV or binary straight from the raw payloads.
+ *
+ * Rows are formatted with integer arithmetic into a fixed-size chunk that is
+ * flushed when nearly full: to the device for files (memory stays at one
+ * chunk), or into one preallocated QString for the clipboard (the text is
+ * held once, in UTF-16, plus one chunk).
+ *
+ * Binary layout: "LPT1", u32 row count, f32 distanceRate, then per row
+ * u16 angle (0.01 deg), u16 raw distance, u8 layer (0-based); little endian.
+ */
+class CPointExporter
+{
+public:
+    enum class eFormat { csv, tsv, binary };
+    typedef QVector<QPair<int, int>> RowRanges; // [first, last]
+
+    enum { CHUNK_SIZE = 1 << 20, MAX_ROW_BYTES = 48, TEXT_ROW_BYTES = 24,
+           BINARY_ROW_BYTES = 5, BINARY_HEADER_BYTES = 12 };
+
+    // Selected rows as sorted, merged ranges (overlapping Ctrl+click selections count once).
+    static RowRanges rowRanges(const QItemSelection& selection)
+    {
+        RowRanges ranges;
+        for (const QItemSelectionRange& r : selection) ranges.append(qMakePair(r.top(), r.bottom()));
+        std::sort(ranges.begin(), ranges.end());
+
+        RowRanges merged;
+        for (const QPair<int, int>& r : qAsConst(ranges)) {
+            if (!merged.isEmpty() && r.first <= merged.last().second + 1)
+                merged.last().second = qMax(merged.last().second, r.second);
+            else
+                merged.append(r);
+        }
+        return merged;
+    }
+
+    static qint64 rowCount(const RowRanges& ranges)
+    {
+        qint64 rows = 0;
+        for (const QPair<int, int>& r : ranges) rows += r.second - r.first + 1;
+        return rows;
+    }
+
+    // Returns bytes written, or -1 on a device error.
+    static qint64 write(const CPointTableModel& model, const RowRanges& ranges, eFormat format,
+        QIODevice* out, bool header = true)
+    {
+        qint64 written = 0;
+        bool ok = stream(model, ranges, format, header, [&](const QByteArray& chunk) {
+            if (out->write(chunk) != chunk.size()) return false;
+            written += chunk.size();
+            return true;
+        });
+        return ok ? written : -1;
+    }
+
+    // CSV / TSV of the whole selection (clipboard path). The QString is reserved once
+    // from the row count and filled chunk by chunk, so no Latin-1 copy of it exists.
+    static QString toText(const CPointTableModel& model, const RowRanges& ranges, eFormat format, bool header = false)
+    {
+        QString text;
+        if (format == eFormat::binary) return text;
+        text.reserve(int(qMin<qint64>(rowCount(ranges) * TEXT_ROW_BYTES + 256, INT_MAX / 4)));
+        stream(model, ranges, format, header, [&](const QByteArray& chunk) {
+            text.append(QLatin1String(chunk.constData(), chunk.size()));
+            return true;
+        });
+        return text;
+    }
+
+private:
+    // Formats the rows into one CHUNK_SIZE buffer and hands it to flush(chunk) when nearly full.
+    template <typename Flush>
+    static bool stream(const CPointTableModel& model, const RowRanges& ranges, eFormat format, bool header, Flush flush)
+    {
+        QByteArray chunk;
+        chunk.reserve(CHUNK_SIZE);
+        if (header) writeHeader(model, ranges, format, chunk);
+
+        const char sep = (format == eFormat::csv) ? ',' : '\t';
+        const int decimals = model.distanceDecimals();
+        const double scale = std::pow(10.0, decimals);
+
+        char row[MAX_ROW_BYTES];
+        CPointTableModel::Point pt;
+        for (const QPair<int, int>& r : ranges) {
+            for (int i = r.first; i <= r.second; ++i) {
+                if (!model.point(i, &pt)) continue;
+
+                int len = (format == eFormat::binary) ? binaryRow(pt, row)
+                    : textRow(model.unitDistance(pt.distance), pt, sep, scale, decimals, row);
+                chunk.append(row, len);
+                if (chunk.size() > CHUNK_SIZE - MAX_ROW_BYTES) {
+                    if (!flush(chunk)) return false;
+                    chunk.resize(0);
+                }
+            }
+        }
+        return chunk.isEmpty() || flush(chunk);
+    }
+
+    static void writeHeader(const CPointTableModel& model, const RowRanges& ranges, eFormat format, QByteArray& chunk)
+    {
+        if (format == eFormat::binary) {
+            uchar head[BINARY_HEADER_BYTES] = { 'L', 'P', 'T', '1' };
+            qToLittleEndian<quint32>((quint32)rowCount(ranges), head + 4);
+            float rate = model.distanceRate();
+            quint32 rateBits;
+            memcpy(&rateBits, &rate, 4);
+            qToLittleEndian<quint32>(rateBits, head + 8);
+            chunk.append((const char*)head, BINARY_HEADER_BYTES);
+            return;
+        }
+        const char sep = (format == eFormat::csv) ? ',' : '\t';
+        chunk.append("angle_deg").append(sep)
+            .append(QString("dist_%1").arg(model.distanceUnit()).toLatin1()).append(sep)
+            .append("layer\n");
+    }
+
+    static int binaryRow(const CPointTableModel::Point& pt, char* row)
+    {
+        qToLittleEndian<quint16>(pt.angle, (uchar*)row);
+        qToLittleEndian<quint16>(pt.distance, (uchar*)row + 2);
+        row[4] = (char)pt.layer;
+        return BINARY_ROW_BYTES;
+    }
+
+    // Same text as CPointTableModel::format(), without QString: the distance is the
+    // model's float value, scaled exactly (float x 10^decimals fits a double) and
+    // rounded half away from zero like QString::number(v, 'f', decimals).
+    static int textRow(float distance, const CPointTableModel::Point& pt, char sep, double scale, int decimals, char* row)
+    {
+        char* p = row;
+        p = writeFixed(p, pt.angle, 2);
+        *p++ = sep;
+        p = writeFixed(p, (qint64)std::llround(distance * scale), decimals);
+        *p++ = sep;
+        p = writeFixed(p, pt.layer + 1, 0);
+        *p++ = '\n';
+        return int(p - row);
+    }
+
+    // value / 10^decimals with exactly `decimals` fraction digits.
+    static char* writeFixed(char* p, qint64 value, int decimals)
+    {
+        if (value < 0) { *p++ = '-'; value = -value; }
+
+        char digits[24];
+        int n = 0;
+        do {
+            digits[n++] = char('0' + value % 10);
+            value /= 10;
+        } while (value > 0 || n <= decimals);
+
+        while (n > decimals) *p++ = digits[--n];
+        if (decimals > 0) {
+            *p++ = '.';
+            while (n > 0) *p++ = digits[--n];
+        }
+        return p;
+    }
+};
+
+#endif // CPOINTEXPORT_H
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPOINTRASTER_H
+#define CPOINTRASTER_H
+
+#include <QImage>
+#include <QVector>
+#include <QPointF>
+#include <QTransform>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <climits>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Tiled point rasterizer for large scans.
+ *
+ * The target image is split into horizontal bands. Points are projected and
+ * binned per band, then every band is filled by its own pool task. Bands own
+ * disjoint scanlines, so no locking is needed; the caller composites the image
+ * on the GUI thread.
+ */
+class CPointRaster {
+public:
+    CPointRaster(int threads = QThread::idealThreadCount()) {
+        setThreadCount(threads);
+    }
+
+    void setThreadCount(int threads) {
+        m_threads = qMax(1, threads);
+        m_pool.setMaxThreadCount(m_threads);
+    }
+
+    int threadCount() const { return m_threads; }
+
+    /**
+     * @brief Rasterize one scan into target (Format_ARGB32_Premultiplied).
+     *
+     * xform is the map view transform (translate + scale only). As in
+     * CLumoMap::drawScan, point i belongs to layer (i % channels); a single
+     * channel ignores the visibility mask. layerColors are premultiplied.
+     */
+    void rasterize(QImage& target, const QTransform& xform, const QVector<QPointF>& scan,
+                   const QRgb* layerColors, int channels, const bool* visibleLayer, int pointSize)
+    {
+        const int count = scan.size();
+        const int width = target.width();
+        const int height = target.height();
+        if (count == 0 || target.isNull()) return;
+        if (channels < 1) channels = 1;
+
+        const int size = qMax(1, pointSize);
+        const int half = size / 2;
+        const int bands = qMax(1, qMin(height, m_threads == 1 ? 1 : m_threads * BANDS_PER_THREAD));
+        const int bandHeight = (height + bands - 1) / bands;
+
+        // 1) Project to pixel space; culled points get y = INT_MIN. The tile test is
+        //    done in double, so far-off (or NaN) points never reach the int conversion.
+        m_px.resize(count);
+        m_py.resize(count);
+        const qreal sx = xform.m11(), sy = xform.m22(), dx = xform.dx(), dy = xform.dy();
+        const QPointF* src = scan.constData();
+        const int chunk = (count + m_threads - 1) / m_threads;
+        parallelFor(m_threads, [&](int job) {
+            const int begin = job * chunk;
+            const int end = qMin(count, begin + chunk);
+            for (int i = begin; i < end; ++i) {
+                int layer = (channels == 1) ? 0 : i % channels;
+                const double x = std::floor(src[i].x() * sx + dx) - half;
+                const double y = std::floor(src[i].y() * sy + dy) - half;
+                bool visible = (channels == 1 || visibleLayer[layer]) &&
+                    x < width && y < height && x + size > 0 && y + size > 0;
+                m_px[i] = visible ? (int)x : 0;
+                m_py[i] = visible ? (int)y : INT_MIN;
+            }
+        });
+
+        // 2) Bin point indices per band (CSR). A point touching two bands is in both.
+        m_bandStart.assign(bands + 1, 0);
+        for (int i = 0; i < count; ++i) {
+            if (m_py[i] == INT_MIN) continue;
+            int first = qMax(0, m_py[i]) / bandHeight;
+            int last = qMin(height - 1, m_py[i] + size - 1) / bandHeight;
+            for (int b = first; b <= last; ++b) m_bandStart[b + 1]++;
+        }
+        for (int b = 0; b < bands; ++b) m_bandStart[b + 1] += m_bandStart[b];
+
+        m_bandItems.resize(m_bandStart[bands]);
+        m_bandFill.assign(m_bandStart.begin(), m_bandStart.end() - 1);
+        for (int i = 0; i < count; ++i) {
+            if (m_py[i] == INT_MIN) continue;
+            int first = qMax(0, m_py[i]) / bandHeight;
+            int last = qMin(height - 1, m_py[i] + size - 1) / bandHeight;
+            for (int b = first; b <= last; ++b) m_bandItems[m_bandFill[b]++] = i;
+        }
+
+        // 3) Fill bands in parallel. Scan order is kept within a band, so overdraw
+        //    matches sequential QPainter output.
+        uchar* bits = target.bits();
+        const int bpl = target.bytesPerLine();
+        parallelFor(bands, [&](int b) {
+            const int y0 = b * bandHeight;
+            const int y1 = qMin(height, y0 + bandHeight);
+            for (int k = m_bandStart[b]; k < m_bandStart[b + 1]; ++k) {
+                const int i = m_bandItems[k];
+                const QRgb color = layerColors[(channels == 1) ? 0 : i % channels];
+                const int ya = qMax(y0, m_py[i]), yb = qMin(y1, m_py[i] + size);
+                const int xa = qMax(0, m_px[i]), xb = qMin(width, m_px[i] + size);
+                for (int y = ya; y < yb; ++y) {
+                    QRgb* line = reinterpret_cast<QRgb*>(bits + (qsizetype)y * bpl);
+                    if (qAlpha(color) == 255) {
+                        for (int x = xa; x < xb; ++x) line[x] = color;
+                    }
+                    else {
+                        for (int x = xa; x < xb; ++x) line[x] = blend(line[x], color);
+                    }
+                }
+            }
+        });
+    }
+
+private:
+    enum { BANDS_PER_THREAD = 4 };
+
+    // SourceOver for premultiplied pixels (same math as Qt's BYTE_MUL).
+    static inline QRgb blend(QRgb dst, QRgb src) {
+        const quint32 ia = 255 - qAlpha(src);
+        quint32 rb = (dst & 0x00ff00ff) * ia + 0x00800080;
+        rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+        quint32 ag = ((dst >> 8) & 0x00ff00ff) * ia + 0x00800080;
+        ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+        return src + rb + ag;
+    }
+
+    template <typename Fn>
+    void parallelFor(int jobs, const Fn& fn) {
+        if (m_threads == 1 || jobs == 1) {
+            for (int i = 0; i < jobs; ++i) fn(i);
+            return;
+        }
+        QVector<QFuture<void>> futures;
+        futures.reserve(jobs);
+        for (int i = 0; i < jobs; ++i) {
+            futures.append(QtConcurrent::run(&m_pool, [&fn, i]() { fn(i); }));
+        }
+        for (QFuture<void>& future : futures) {
+            future.waitForFinished();
+        }
+    }
+
+    int m_threads = 1;
+    QThreadPool m_pool;
+
+    std::vector<int> m_px;
+    std::vector<int> m_py;
+    std::vector<int> m_bandStart;
+    std::vector<int> m_bandFill;
+    std::vector<int> m_bandItems;
+};
+
+#endif // CPOINTRASTER_H
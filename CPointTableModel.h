@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPOINTTABLEMODEL_H
+#define CPOINTTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QByteArray>
+#include <QVector>
+#include <algorithm>
+
+/**
+ * @brief Point Viewer model over captured getBulk payloads.
+ *
+ * Captured scans are kept as the raw big-endian payloads (implicitly shared,
+ * so capturing is a refcount bump). Rows are [packet][layer] in payload order,
+ * the same order as decodeScanPayload and CScanIndex; text is formatted in
+ * data() only for rows the view asks for.
+ */
+class CPointTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum eColumn { colAngle, colDist, colLayer, COLUMN_COUNT };
+
+    struct Point {
+        quint16 angle;
+        quint16 distance; // raw
+        int layer;
+    };
+
+    CPointTableModel(QObject* parent = nullptr) : QAbstractTableModel(parent) {}
+
+    // Raw -> unit value (distanceRate) and header unit.
+    void setDistanceFormat(float distanceRate, const QString& unit)
+    {
+        m_distanceRate = distanceRate;
+        m_distanceUnit = unit;
+        m_distDecimals = (distanceRate == (int)distanceRate) ? 0 : 1;
+        emit headerDataChanged(Qt::Horizontal, colDist, colDist);
+        if (rowCount() > 0) emit dataChanged(index(0, colDist), index(rowCount() - 1, colDist));
+    }
+
+    float distanceRate() const { return m_distanceRate; }
+    int distanceDecimals() const { return m_distDecimals; }
+    // Distance in the header unit, float as displayed (CPointExporter prints the same value).
+    float unitDistance(quint16 raw) const { return raw * m_distanceRate; }
+    QString distanceUnit() const { return m_distanceUnit; }
+
+    // Replace the contents with one scan.
+    void capture(const QByteArray& payload, int channels)
+    {
+        beginResetModel();
+        m_scans.clear();
+        m_rowStart.clear();
+        m_rowCount = 0;
+        addScan(payload, channels);
+        endResetModel();
+    }
+
+    // Live mode: swap in the latest scan. Same shape -> ranged dataChanged for the rows
+    // whose raw values differ (selection and current index survive); otherwise a reset.
+    void updateScan(const QByteArray& payload, int channels)
+    {
+        if (m_scans.size() != 1 || m_scans[0].channels != channels
+            || scanRows(payload, channels) != m_rowCount) {
+            capture(payload, channels);
+            return;
+        }
+
+        const QByteArray previous = m_scans[0].payload;
+        m_scans[0].payload = payload;
+        if (previous.constData() == payload.constData()) return;
+
+        const quint8* a = (const quint8*)previous.constData();
+        const quint8* b = (const quint8*)payload.constData();
+        const int packetSize = 2 + channels * 2;
+        const int packets = m_rowCount / channels;
+
+        int first = -1, last = -1;
+        for (int i = 0; i < packets; ++i) {
+            const int off = i * packetSize;
+            const bool angleChanged = a[off] != b[off] || a[off + 1] != b[off + 1];
+            for (int j = 0; j < channels; ++j) {
+                const int row = i * channels + j;
+                const int d = off + 2 + j * 2;
+                if (angleChanged || a[d] != b[d] || a[d + 1] != b[d + 1]) {
+                    if (first < 0) first = row;
+                    last = row;
+                }
+                else if (first >= 0 && row - last > LIVE_MERGE_GAP) {
+                    emit dataChanged(index(first, 0), index(last, COLUMN_COUNT - 1));
+                    first = -1;
+                }
+            }
+        }
+        if (first >= 0) emit dataChanged(index(first, 0), index(last, COLUMN_COUNT - 1));
+    }
+
+    // Append a scan below the existing rows (scan history).
+    void appendScan(const QByteArray& payload, int channels)
+    {
+        int rows = scanRows(payload, channels);
+        if (rows <= 0) return;
+        beginInsertRows(QModelIndex(), m_rowCount, m_rowCount + rows - 1);
+        addScan(payload, channels);
+        endInsertRows();
+    }
+
+    void clear()
+    {
+        beginResetModel();
+        m_scans.clear();
+        m_rowStart.clear();
+        m_rowCount = 0;
+        endResetModel();
+    }
+
+    bool point(int row, Point* pt) const
+    {
+        if (row < 0 || row >= m_rowCount) return false;
+
+        int s = int(std::upper_bound(m_rowStart.constBegin(), m_rowStart.constEnd(), row) - m_rowStart.constBegin()) - 1;
+        const Scan& scan = m_scans[s];
+        int local = row - m_rowStart[s];
+        int packet = local / scan.channels;
+        int layer = local % scan.channels;
+
+        const quint8* p = (const quint8*)scan.payload.constData() + packet * (2 + scan.channels * 2);
+        pt->angle = (quint16)((p[0] << 8) | p[1]);
+        pt->distance = (quint16)((p[2 + layer * 2] << 8) | p[3 + layer * 2]);
+        pt->layer = layer;
+        return true;
+    }
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : m_rowCount;
+    }
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : COLUMN_COUNT;
+    }
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override
+    {
+        if (role == Qt::TextAlignmentRole) return int(Qt::AlignCenter);
+        if (role != Qt::DisplayRole || !index.isValid()) return QVariant();
+
+        Point pt;
+        if (!point(index.row(), &pt)) return QVariant();
+        return format(pt, index.column());
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override
+    {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+        switch (section) {
+        case colAngle: return QString("Angle (%1)").arg(QChar(0x00B0));
+        case colDist:  return QString("Dist (%1)").arg(m_distanceUnit);
+        case colLayer: return QString("Layer");
+        }
+        return QVariant();
+    }
+
+    QString format(const Point& pt, int column) const
+    {
+        switch (column) {
+        case colAngle: return QString::number(pt.angle / 100.0, 'f', 2);
+        case colDist:  return QString::number(unitDistance(pt.distance), 'f', m_distDecimals);
+        case colLayer: return QString::number(pt.layer + 1);
+        }
+        return QString();
+    }
+
+private:
+    // Unchanged rows between two changed ones that are still merged into one dataChanged.
+    enum { LIVE_MERGE_GAP = 16 };
+
+    struct Scan {
+        QByteArray payload;
+        int channels;
+    };
+
+    static int scanRows(const QByteArray& payload, int channels)
+    {
+        if (channels <= 0) return 0;
+        return (payload.size() / (2 + channels * 2)) * channels;
+    }
+
+    void addScan(const QByteArray& payload, int channels)
+    {
+        int rows = scanRows(payload, channels);
+        if (rows <= 0) return;
+        m_scans.append({ payload, channels });
+        m_rowStart.append(m_rowCount);
+        m_rowCount += rows;
+    }
+
+    QVector<Scan> m_scans;
+    QVector<int> m_rowStart; // first row of each scan
+    int m_rowCount = 0;
+
+    float m_distanceRate = 0.1f;
+    int m_distDecimals = 1;
+    QString m_distanceUnit = "cm";
+};
+
+#endif // CPOINTTABLEMODEL_H
@@ -75,7 +75,7 @@ public:
             in << quint16(7 + (data->count() / 2));
             in << dType;
             in << sAddr;
-            in << quint16(data->count());
+            in << quint16(data->count() / 2); // words, as protocol.h and the firmware
             cmd.append(*data);
             in << getCrc16(cmd);
             break;
@@ -168,7 +168,7 @@ public:
                 cmd = eCmd::setParam;
                 if (payload) {
                     payload->clear();
-                    payload->append(data.mid(12, wCnt));
+                    payload->append(data.mid(12, wCnt * 2));
                 }
                 break;
             case 'G': // GetBulk
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CRANGEVIEW_H
+#define CRANGEVIEW_H
+
+#include <QtWidgets>
+#include <QtGui>
+#include <QtCore>
+
+/**
+ * @brief Polar range image: angle bin (x) x layer, with a waterfall history.
+ *
+ * Each layer owns a panel of m_history rows in one QImage used as a ring.
+ * A scan writes exactly one row per layer straight from the big-endian
+ * payload through a 64K-entry color LUT, so the cost is one pass over the
+ * payload regardless of history depth.
+ */
+class CRangeView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    CRangeView(QWidget* parent = nullptr, int history = 256)
+        : QWidget(parent), m_history(qMax(1, history))
+    {
+        setAttribute(Qt::WA_OpaquePaintEvent);
+        setMinimumSize(200, 150);
+        setRange(30.0f, 0.001f);
+    }
+
+    void setProfile(int channels, int mesuresPerScan)
+    {
+        m_channels = qMax(1, channels);
+        m_bins = qMax(1, mesuresPerScan);
+        m_image = QImage(m_bins, m_channels * m_history, QImage::Format_RGB32);
+        m_image.fill(Qt::black);
+        m_head = 0;
+        update();
+    }
+
+    // Color scale: 0 .. maxMeter, rawToMeter = distanceRate * unitToMeter.
+    void setRange(float maxMeter, float rawToMeter)
+    {
+        m_lut.resize(65536);
+        const float maxRaw = maxMeter / rawToMeter;
+        m_lut[0] = qRgb(0, 0, 0); // no return
+        for (int raw = 1; raw < 65536; ++raw) {
+            float t = qMin(1.0f, raw / maxRaw);
+            // near = red, far = blue
+            m_lut[raw] = QColor::fromHsvF(t * (240.0f / 360.0f), 1.0, 1.0).rgb();
+        }
+    }
+
+    void clear()
+    {
+        m_image.fill(Qt::black);
+        update();
+    }
+
+    // payload: [Angle(2) + Channels * Dist(2)] * N, Big Endian (getBulk payload)
+    void pushScan(const QByteArray& payload)
+    {
+        if (m_image.isNull()) return;
+
+        const int packetSize = 2 + m_channels * 2;
+        const int cnt = qMin(m_bins, payload.size() / packetSize);
+        const quint8* data = (const quint8*)payload.constData();
+        const QRgb* lut = m_lut.constData();
+
+        m_head = (m_head + m_history - 1) % m_history;
+        QRgb* rows[8];
+        const int layers = qMin(m_channels, 8);
+        for (int j = 0; j < layers; ++j) {
+            rows[j] = reinterpret_cast<QRgb*>(m_image.scanLine(j * m_history + m_head));
+        }
+
+        for (int i = 0; i < cnt; ++i) {
+            const quint8* dist = data + i * packetSize + 2;
+            for (int j = 0; j < layers; ++j) {
+                rows[j][i] = lut[(dist[j * 2] << 8) | dist[j * 2 + 1]];
+            }
+        }
+        for (int j = 0; j < layers; ++j) {
+            for (int i = cnt; i < m_bins; ++i) rows[j][i] = lut[0];
+        }
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent* event) override
+    {
+        Q_UNUSED(event);
+
+        QPainter painter(this);
+        painter.fillRect(rect(), Qt::black);
+        if (m_image.isNull()) return;
+
+        // Newest row on top: ring rows [head, history) then [0, head).
+        const int panelHeight = height() / m_channels;
+        const int upper = m_history - m_head;
+        for (int j = 0; j < m_channels; ++j) {
+            const int top = j * panelHeight;
+            const int split = panelHeight * upper / m_history;
+            painter.drawImage(QRect(0, top, width(), split), m_image,
+                QRect(0, j * m_history + m_head, m_bins, upper));
+            if (m_head > 0) {
+                painter.drawImage(QRect(0, top + split, width(), panelHeight - split), m_image,
+                    QRect(0, j * m_history, m_bins, m_head));
+            }
+            painter.setPen(Qt::white);
+            painter.drawText(QRect(4, top + 2, 40, 16), QString("L%1").arg(j + 1));
+            if (j > 0) {
+                painter.setPen(Qt::darkGray);
+                painter.drawLine(0, top, width(), top);
+            }
+        }
+    }
+
+private:
+    QImage m_image;
+    QVector<QRgb> m_lut;
+    int m_history;
+    int m_head = 0;
+    int m_channels = 1;
+    int m_bins = 1;
+};
+
+#endif // CRANGEVIEW_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CRENDERCLI_H
+#define CRENDERCLI_H
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QDir>
+#include <QImage>
+
+#include "CMapRenderer.h"
+#include "CCloudPoints.h"
+#include "CLidarConfig.h"
+#include "CSynthScene.h"
+
+/**
+ * @brief Headless map rendering: PNG sequence export and render benchmark.
+ *
+ *   LumoMap --render [--profile N|all] [--frames N] [--size WxH] [--out DIR] [--bench]
+ *
+ * Scans come from CSynthScene (scene.json, or the default scene). The codec,
+ * black box, replay and scene benchmarks are in LumoBench.
+ *
+ * Runs under the offscreen platform, so no display is needed.
+ */
+class CRenderCli {
+public:
+    static bool isRequested(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            QByteArray arg(argv[i]);
+            if (arg == "--render") return true;
+        }
+        return false;
+    }
+
+    static int run(const QStringList& arguments) {
+        QTextStream out(stdout);
+
+        QCommandLineParser parser;
+        parser.setApplicationDescription("LumoMap offscreen renderer");
+        parser.addHelpOption();
+        parser.addOptions({
+            { "render", "Offscreen render mode." },
+            { "bench", "Report ms per frame for each profile." },
+            { "config", "LiDAR profile file.", "path", "config.json" },
+            { "profile", "Profile index in config.json, or 'all'.", "index", "all" },
+            { "frames", "Frames per profile.", "count", "100" },
+            { "size", "Image size.", "WxH", "1920x1080" },
+            { "out", "Write a PNG sequence into this directory.", "dir" },
+            { "zoom", "Zoom rate.", "rate", "0.2" },
+            { "trail", "Trail length in scans.", "scans", "3" },
+            { "persistence", "decay, buffered or off.", "mode", "decay" },
+            { "backend", "painter or tiled.", "backend", "painter" },
+            { "threads", "Tiled rasterizer threads.", "count", QString::number(QThread::idealThreadCount()) },
+            { "overlay", "Info text and ring labels: on or off.", "mode", "on" },
+        });
+        parser.process(arguments);
+
+        QJsonArray types = LidarConfig::loadTypes(parser.value("config"));
+        if (types.isEmpty()) types = LidarConfig::defaultTypes();
+
+        QList<int> profiles;
+        if (parser.value("profile") == "all") {
+            for (int i = 0; i < types.count(); ++i) profiles.append(i);
+        }
+        else {
+            int index = parser.value("profile").toInt();
+            if (index < 0 || index >= types.count()) {
+                out << "Invalid profile index: " << index << Qt::endl;
+                return 1;
+            }
+            profiles.append(index);
+        }
+
+        QStringList wh = parser.value("size").split('x');
+        QSize size(wh.value(0).toInt(), wh.value(1).toInt());
+        if (size.isEmpty()) size = QSize(1920, 1080);
+
+        QString outDir = parser.value("out");
+        if (!outDir.isEmpty()) QDir().mkpath(outDir);
+
+        Options opt;
+        opt.frames = qMax(1, parser.value("frames").toInt());
+        opt.size = size;
+        opt.outDir = outDir;
+        opt.zoom = parser.value("zoom").toFloat();
+        opt.trail = parser.value("trail").toInt();
+        opt.persistence = parser.value("persistence");
+        opt.tiled = (parser.value("backend") == "tiled");
+        opt.threads = parser.value("threads").toInt();
+        opt.overlay = (parser.value("overlay") != "off");
+
+        for (int index : profiles) {
+            LidarConfig cfg = LidarConfig::fromJson(types[index].toObject());
+            double msPerFrame = renderProfile(cfg, index, opt);
+            if (parser.isSet("bench")) {
+                out << QString("Profile %1 '%2': %3 frames %4x%5, %6 ms/frame (%7 fps)")
+                    .arg(index).arg(cfg.name).arg(opt.frames)
+                    .arg(size.width()).arg(size.height())
+                    .arg(msPerFrame, 0, 'f', 3)
+                    .arg(msPerFrame > 0 ? 1000.0 / msPerFrame : 0.0, 0, 'f', 1) << Qt::endl;
+            }
+        }
+        return 0;
+    }
+
+private:
+    struct Options {
+        int frames;
+        QSize size;
+        QString outDir;
+        float zoom;
+        int trail;
+        QString persistence;
+        bool tiled;
+        int threads;
+        bool overlay;
+    };
+
+    // Decode + transform outside the timed loop; only lumos() and render() are measured.
+    static double renderProfile(const LidarConfig& cfg, int profileIndex, const Options& opt) {
+        CCloudPoints cloud(nullptr);
+        cloud.setOrientation(cfg.angleOffset, cfg.isClockwise);
+        cloud.setDistanceSettings(cfg.distanceRate, cfg.unitToMeter());
+
+        QVector<QVector<QPointF>> scans;
+        scans.reserve(opt.frames);
+        for (const QByteArray& payload : syntheticFrames(cfg, opt.frames)) {
+            decodeScanPayload(payload, cfg.channels, &cloud);
+            scans.append(cloud.getPoints());
+        }
+
+        CMapRenderer map(cfg.channels, cfg.fov, cfg.resolution);
+        map.setViewportSize(opt.size);
+        map.setMapOrientation(cfg.angleOffset, cfg.isClockwise);
+        map.setDistanceUnit(cfg.distanceUnit);
+        map.setZoomRate(opt.zoom);
+        map.setTrailLength(opt.trail);
+        map.setFadeEnabled(opt.persistence != "off");
+        map.setPersistence(opt.persistence == "buffered" ?
+            CMapRenderer::ePersistence::buffered : CMapRenderer::ePersistence::decay);
+        map.setRasterBackend(opt.tiled ?
+            CMapRenderer::eRasterBackend::tiled : CMapRenderer::eRasterBackend::painter);
+        map.setRasterThreads(opt.threads);
+        map.setOverlayEnabled(opt.overlay);
+        map.normalInfo().info = cfg.name;
+        map.fixedInfo().info = QString("Dist: 0.0 %1\nAngle: 0.00\u00B0").arg(cfg.distanceUnit);
+
+        QImage image(opt.size, QImage::Format_ARGB32_Premultiplied);
+        QElapsedTimer stopwatch;
+        qint64 elapsedNs = 0;
+
+        // scans 100 ms apart (the default interval), so trails don't depend on how fast we render
+        for (int i = 0; i < opt.frames; ++i) {
+            stopwatch.start();
+            map.lumos(scans[i], qint64(i) * 100);
+            map.render(image);
+            elapsedNs += stopwatch.nsecsElapsed();
+
+            if (!opt.outDir.isEmpty()) {
+                image.save(QString("%1/p%2_%3.png").arg(opt.outDir).arg(profileIndex)
+                    .arg(i, 5, 10, QChar('0')));
+            }
+        }
+        return elapsedNs / 1e6 / opt.frames;
+    }
+
+    // Consecutive CSynthScene frames (walls, moving boxes, range noise, dropouts).
+    static QVector<QByteArray> syntheticFrames(const LidarConfig& cfg, int count) {
+        CSynthScene scene;
+        scene.setScene(CSynthScene::loadScene());
+        scene.setProfile(cfg.channels, cfg.resolution, cfg.mesuresPerScan, cfg.distanceRate * cfg.unitToMeter());
+
+        QVector<QByteArray> frames;
+        frames.reserve(count);
+        for (int f = 0; f < count; ++f) {
+            QByteArray payload(scene.payloadBytes(), 0);
+            scene.generate((uchar*)payload.data());
+            frames.append(payload);
+        }
+        return frames;
+    }
+};
+
+#endif // CRENDERCLI_H
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CRENDERGOVERNOR_H
+#define CRENDERGOVERNOR_H
+
+#include <QtGlobal>
+
+/**
+ * @brief Picks a render quality level from measured frame times.
+ *
+ * Steps one level down after DEGRADE_FRAMES consecutive frames over budget,
+ * one level up after RESTORE_FRAMES frames under half the budget. Every change
+ * is followed by a cooldown so the new level is measured before the next step.
+ */
+class CRenderGovernor
+{
+public:
+    enum { DEGRADE_FRAMES = 5, RESTORE_FRAMES = 60, COOLDOWN_FRAMES = 15 };
+
+    CRenderGovernor(int maxLevel) : m_maxLevel(maxLevel) {}
+
+    void setBudget(float ms) { m_budgetMs = qMax(1.0f, ms); }
+    float budget() const { return m_budgetMs; }
+
+    void setEnabled(bool enabled)
+    {
+        m_enabled = enabled;
+        reset();
+        if (!enabled) m_level = 0;
+    }
+    bool isEnabled() const { return m_enabled; }
+
+    void reset()
+    {
+        m_over = m_under = 0;
+        m_cooldown = COOLDOWN_FRAMES;
+    }
+
+    int level() const { return m_level; }
+    float averageMs() const { return m_avgMs; }
+    float peakMs() const { return m_peakMs; }
+
+    // Returns true when the level changed.
+    bool addSample(float ms)
+    {
+        m_avgMs = (m_avgMs == 0.0f) ? ms : m_avgMs * 0.8f + ms * 0.2f;
+        m_peakMs = qMax(m_peakMs * 0.98f, ms);
+
+        if (!m_enabled) return false;
+        if (m_cooldown > 0) {
+            --m_cooldown;
+            return false;
+        }
+
+        m_over = (m_avgMs > m_budgetMs) ? m_over + 1 : 0;
+        m_under = (m_avgMs < m_budgetMs * 0.5f) ? m_under + 1 : 0;
+
+        if (m_over >= DEGRADE_FRAMES && m_level < m_maxLevel) {
+            ++m_level;
+            reset();
+            return true;
+        }
+        if (m_under >= RESTORE_FRAMES && m_level > 0) {
+            --m_level;
+            reset();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    int   m_maxLevel;
+    int   m_level = 0;
+    bool  m_enabled = true;
+    float m_budgetMs = 16.0f;
+    float m_avgMs = 0.0f;
+    float m_peakMs = 0.0f;
+    int   m_over = 0;
+    int   m_under = 0;
+    int   m_cooldown = COOLDOWN_FRAMES;
+};
+
+#endif // CRENDERGOVERNOR_H
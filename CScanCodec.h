@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSCANCODEC_H
+#define CSCANCODEC_H
+
+#include <QByteArray>
+#include <QtEndian>
+
+/**
+ * @brief Temporal delta coder for recorded frames.
+ *
+ * A frame is read as big-endian 16-bit words (angle, distances, as on the
+ * wire), so word k of two scans of the same profile is the same angle bin and
+ * layer. Each word is stored as the zigzag of its difference to word k of the
+ * previous frame; a keyframe uses no reference. Tokens are varints: even =
+ * one non-zero zigzag value (<< 1), odd = a run of ((t >> 1) + 1) zero deltas.
+ *
+ * Coded block: u32 rawSize | tokens. An odd trailing byte is coded as its own word.
+ */
+class CScanCodec
+{
+public:
+    // Frames per chunk: seek decodes at most KEYFRAME_INTERVAL - 1 deltas.
+    enum { KEYFRAME_INTERVAL = 32, HEADER_SIZE = 4 };
+
+    static int maxEncodedSize(int rawSize)
+    {
+        return HEADER_SIZE + ((rawSize + 1) / 2) * 3;
+    }
+
+    // Appends the coded frame to out; prev == nullptr for a keyframe (prev must be size bytes).
+    static int encode(const uchar* cur, int size, const uchar* prev, QByteArray& out)
+    {
+        const int start = out.size();
+        out.resize(start + maxEncodedSize(size));
+        uchar* p = (uchar*)out.data() + start;
+        qToLittleEndian<quint32>((quint32)size, p);
+        p += HEADER_SIZE;
+
+        const int words = size / 2;
+        quint32 run = 0;
+        for (int k = 0; k < words; ++k) {
+            quint16 c = (quint16)((cur[2 * k] << 8) | cur[2 * k + 1]);
+            quint16 r = prev ? (quint16)((prev[2 * k] << 8) | prev[2 * k + 1]) : 0;
+            quint32 z = zigzag((qint16)(c - r));
+            if (z == 0) {
+                ++run;
+                continue;
+            }
+            if (run) p = putVarint(p, ((run - 1) << 1) | 1);
+            run = 0;
+            p = putVarint(p, z << 1);
+        }
+        if (size & 1) {
+            quint32 z = zigzag((qint16)(cur[size - 1] - (prev ? prev[size - 1] : 0)));
+            if (z == 0) ++run;
+            else {
+                if (run) p = putVarint(p, ((run - 1) << 1) | 1);
+                run = 0;
+                p = putVarint(p, z << 1);
+            }
+        }
+        if (run) p = putVarint(p, ((run - 1) << 1) | 1);
+
+        const int written = int(p - ((uchar*)out.data() + start));
+        out.resize(start + written);
+        return written;
+    }
+
+    static int rawSize(const uchar* in, int inSize)
+    {
+        return inSize >= HEADER_SIZE ? (int)qFromLittleEndian<quint32>(in) : -1;
+    }
+
+    // out may alias prev (in-place delta). prev == nullptr for a keyframe.
+    static bool decode(const uchar* in, int inSize, const uchar* prev, uchar* out, int outSize)
+    {
+        if (rawSize(in, inSize) != outSize) return false;
+        const uchar* p = in + HEADER_SIZE;
+        const uchar* end = in + inSize;
+
+        const int units = outSize / 2 + (outSize & 1);
+        int k = 0;
+        while (p < end && k < units) {
+            quint32 t;
+            if (!getVarint(p, end, &t)) return false;
+            if (t & 1) {
+                int run = int(t >> 1) + 1;
+                if (run > units - k) return false;
+                if (!prev) {
+                    int from = 2 * k, to = qMin(outSize, 2 * (k + run));
+                    memset(out + from, 0, to - from);
+                }
+                else if (out != prev) {
+                    int from = 2 * k, to = qMin(outSize, 2 * (k + run));
+                    memcpy(out + from, prev + from, to - from);
+                }
+                k += run;
+                continue;
+            }
+            qint16 d = unzigzag(t >> 1);
+            if (2 * k + 1 < outSize) {
+                quint16 r = prev ? (quint16)((prev[2 * k] << 8) | prev[2 * k + 1]) : 0;
+                quint16 v = (quint16)(r + d);
+                out[2 * k] = (uchar)(v >> 8);
+                out[2 * k + 1] = (uchar)v;
+            }
+            else {
+                out[2 * k] = (uchar)((prev ? prev[2 * k] : 0) + d);
+            }
+            ++k;
+        }
+        return k == units && p == end;
+    }
+
+private:
+    // unsigned shift: d << 1 on a negative d is undefined before C++20
+    static quint32 zigzag(qint16 d) { return (quint16)((quint16(d) << 1) ^ quint16(d >> 15)); }
+    static qint16 unzigzag(quint32 z) { return (qint16)((z >> 1) ^ (0u - (z & 1))); }
+
+    static uchar* putVarint(uchar* p, quint32 v)
+    {
+        while (v >= 0x80) {
+            *p++ = (uchar)(v | 0x80);
+            v >>= 7;
+        }
+        *p++ = (uchar)v;
+        return p;
+    }
+
+    static bool getVarint(const uchar*& p, const uchar* end, quint32* v)
+    {
+        quint32 result = 0;
+        for (int shift = 0; shift < 35 && p < end; shift += 7) {
+            uchar b = *p++;
+            result |= quint32(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                *v = result;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif // CSCANCODEC_H
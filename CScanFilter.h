@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSCANFILTER_H
+#define CSCANFILTER_H
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <chrono>
+#include <vector>
+
+/**
+ * @brief Temporal filter per (angle bin, layer) over the last `depth` scans (3 or 5).
+ *
+ * Works on the getBulk payload in place, before decodeScanPayload, so the
+ * map, Range View and Point Viewer all see the filtered distances:
+ *   median  every distance becomes the median of its bin over the last depth scans
+ *   spike   a distance is replaced by that median only when it differs from it
+ *           by more than spikePercent; otherwise the raw value is kept
+ * A 0 (no return) is kept out of the median: the ring holds distance - 1, so 0
+ * wraps to 0xFFFF and sorts above every range. When most of the window is
+ * empty the median is "no return" and the raw value is kept.
+ * Bins are measure indices, so scans must keep the same angle grid; a change
+ * in bins or channels restarts the history. Until `depth` scans are in, the
+ * scan passes unchanged. The history is one fixed ring of depth x bins x
+ * layers words; the kernels are branch-free min / max over contiguous arrays.
+ */
+class CScanFilter
+{
+public:
+    enum class eMode { median, spike };
+    enum { MAX_DEPTH = 5, DEFAULT_SPIKE_PERCENT = 20 };
+
+    void setMode(eMode mode, int depth)
+    {
+        m_mode = mode;
+        m_depth = depth >= MAX_DEPTH ? MAX_DEPTH : 3;
+        reset();
+    }
+
+    void setSpikePercent(int percent) { m_spikePercent = qBound(1, percent, 1000); }
+
+    eMode mode() const { return m_mode; }
+    int depth() const { return m_depth; }
+    int spikePercent() const { return m_spikePercent; }
+
+    void reset()
+    {
+        m_bins = 0;
+        m_filled = 0;
+        m_head = 0;
+    }
+
+    // Exponential average of apply() in microseconds.
+    double costUs() const { return m_costUs; }
+
+    void apply(QByteArray& payload, int channels)
+    {
+        const qint64 start = nowNs();
+        const int stride = 2 + channels * 2;
+        const int bins = channels > 0 ? payload.size() / stride : 0;
+        if (bins <= 0) return;
+        const int n = bins * channels;
+        if (bins != m_bins || channels != m_channels || int(m_ring.size()) != m_depth * n) {
+            m_bins = bins;
+            m_channels = channels;
+            m_ring.assign(size_t(m_depth) * n, 0);
+            m_out.assign(n, 0);
+            m_filled = 0;
+            m_head = 0;
+        }
+
+        // distances only (angle words skipped), k = bin * channels + layer
+        uchar* p = (uchar*)payload.data();
+        quint16* cur = &m_ring[size_t(m_head) * n];
+        for (int i = 0, k = 0; i < bins; ++i) {
+            const uchar* d = p + i * stride + 2;
+            for (int l = 0; l < channels; ++l, ++k) cur[k] = quint16(((d[l * 2] << 8) | d[l * 2 + 1]) - 1);
+        }
+        m_head = (m_head + 1) % m_depth;
+        if (m_filled < m_depth) ++m_filled;
+        if (m_filled < m_depth) return;
+
+        const quint16* h[MAX_DEPTH];
+        for (int s = 0; s < m_depth; ++s) h[s] = &m_ring[size_t(s) * n];
+        quint16* out = m_out.data();
+        if (m_depth == 3) median3(h[0], h[1], h[2], out, n);
+        else median5(h[0], h[1], h[2], h[3], h[4], out, n);
+
+        // back to distances (0xFFFF + 1 wraps to 0)
+        if (m_mode == eMode::spike) {
+            const int percent = m_spikePercent;
+            for (int k = 0; k < n; ++k) {
+                const int c = quint16(cur[k] + 1), m = quint16(out[k] + 1);
+                out[k] = quint16(m != 0 && qAbs(c - m) * 100 > percent * m ? m : c);
+            }
+        }
+        else {
+            for (int k = 0; k < n; ++k) {
+                const quint16 c = quint16(cur[k] + 1), m = quint16(out[k] + 1);
+                out[k] = m ? m : c;
+            }
+        }
+
+        for (int i = 0, k = 0; i < bins; ++i) {
+            uchar* d = p + i * stride + 2;
+            for (int l = 0; l < channels; ++l, ++k) {
+                d[l * 2] = uchar(out[k] >> 8);
+                d[l * 2 + 1] = uchar(out[k]);
+            }
+        }
+
+        const double us = (nowNs() - start) / 1000.0;
+        m_costUs = m_costUs > 0 ? m_costUs * 0.9 + us * 0.1 : us;
+    }
+
+private:
+    static qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static quint16 lo(quint16 a, quint16 b) { return a < b ? a : b; }
+    static quint16 hi(quint16 a, quint16 b) { return a < b ? b : a; }
+
+    static void median3(const quint16* a, const quint16* b, const quint16* c, quint16* out, int n)
+    {
+        for (int k = 0; k < n; ++k) out[k] = hi(lo(a[k], b[k]), lo(hi(a[k], b[k]), c[k]));
+    }
+
+    // median3(e, max(min(a,b), min(c,d)), min(max(a,b), max(c,d)))
+    static void median5(const quint16* a, const quint16* b, const quint16* c, const quint16* d, const quint16* e,
+        quint16* out, int n)
+    {
+        for (int k = 0; k < n; ++k) {
+            const quint16 f = hi(lo(a[k], b[k]), lo(c[k], d[k]));
+            const quint16 g = lo(hi(a[k], b[k]), hi(c[k], d[k]));
+            out[k] = hi(lo(f, g), lo(hi(f, g), e[k]));
+        }
+    }
+
+    eMode m_mode = eMode::median;
+    int m_depth = 3;
+    int m_spikePercent = DEFAULT_SPIKE_PERCENT;
+    int m_bins = 0;
+    int m_channels = 0;
+    int m_filled = 0;
+    int m_head = 0;
+    std::vector<quint16> m_ring;
+    std::vector<quint16> m_out;
+    double m_costUs = 0;
+};
+
+#endif // CSCANFILTER_H
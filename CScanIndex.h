@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSCANINDEX_H
+#define CSCANINDEX_H
+
+#include <QVector>
+#include <QPointF>
+#include <QtMath>
+
+#include <cfloat>
+#include <cmath>
+
+/**
+ * @brief Uniform-grid index over one scan, rebuilt per scan.
+ *
+ * Entries are appended in decode order, so an entry's position is also its
+ * Point Viewer row. build() sorts them into cells with a counting sort (O(n)),
+ * after which nearest() and radius() only visit the cells around the query.
+ * Entries with distance 0 (no return, drawn at the origin) keep their row but
+ * are not put in any cell, so they can't be picked or snapped to.
+ */
+class CScanIndex {
+public:
+    struct Entry {
+        float x;            // scene position (pixels at zoom 1)
+        float y;
+        quint16 angle;      // raw angle (0.01 deg)
+        quint16 distance;   // raw distance
+        quint8 layer;
+    };
+
+    void clear() {
+        m_entries.clear();
+        m_cellStart.clear();
+        m_cellItems.clear();
+        m_cols = m_rows = 0;
+    }
+
+    void reserve(int count) {
+        m_entries.reserve(count);
+    }
+
+    void append(float x, float y, quint16 angle, quint16 distance, int layerNo) {
+        Entry e = { x, y, angle, distance, (quint8)layerNo };
+        m_entries.append(e);
+    }
+
+    int count() const { return m_entries.size(); }
+    const Entry& entry(int row) const { return m_entries.at(row); }
+
+    void build() {
+        const int n = m_entries.size();
+        m_cellStart.clear();
+        m_cellItems.clear();
+        m_cols = m_rows = 0;
+
+        int indexed = 0;
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+        for (const Entry& e : qAsConst(m_entries)) {
+            if (e.distance == 0) continue;
+            minX = qMin(minX, e.x); maxX = qMax(maxX, e.x);
+            minY = qMin(minY, e.y); maxY = qMax(maxY, e.y);
+            ++indexed;
+        }
+        if (indexed == 0) return;
+
+        // About CELL_OCCUPANCY points per cell, clamped to MAX_GRID_DIM per axis.
+        float w = qMax(maxX - minX, 1.0f), h = qMax(maxY - minY, 1.0f);
+        m_cellSize = std::sqrt(w * h * CELL_OCCUPANCY / indexed);
+        m_cellSize = qMax(m_cellSize, qMax(w, h) / MAX_GRID_DIM);
+        m_cellSize = qMax(m_cellSize, 1.0f);
+        m_originX = minX;
+        m_originY = minY;
+        m_cols = (int)(w / m_cellSize) + 1;
+        m_rows = (int)(h / m_cellSize) + 1;
+
+        m_cellStart.fill(0, m_cols * m_rows + 1);
+        m_cellItems.resize(indexed);
+        QVector<int> cellOf(n);
+        for (int i = 0; i < n; ++i) {
+            cellOf[i] = m_entries[i].distance ? cellIndex(m_entries[i].x, m_entries[i].y) : -1;
+            if (cellOf[i] >= 0) m_cellStart[cellOf[i] + 1]++;
+        }
+        for (int c = 0; c < m_cols * m_rows; ++c) m_cellStart[c + 1] += m_cellStart[c];
+
+        QVector<int> fill = m_cellStart;
+        for (int i = 0; i < n; ++i) {
+            if (cellOf[i] >= 0) m_cellItems[fill[cellOf[i]]++] = i;
+        }
+    }
+
+    // Row of the entry closest to pos within maxRadius, or -1.
+    int nearest(const QPointF& pos, float maxRadius) const {
+        if (m_cols == 0) return -1;
+
+        const float px = (float)pos.x(), py = (float)pos.y();
+        const int cx = (int)std::floor((px - m_originX) / m_cellSize);
+        const int cy = (int)std::floor((py - m_originY) / m_cellSize);
+        const int maxRing = qMin((int)(maxRadius / m_cellSize) + 1, qMax(m_cols, m_rows) + qMax(qAbs(cx), qAbs(cy)));
+
+        int best = -1;
+        float bestDist2 = maxRadius * maxRadius;
+        for (int r = 0; r <= maxRing; ++r) {
+            // Everything in ring r+1 and beyond is at least r cells away.
+            float ringDist = (r - 1) * m_cellSize;
+            if (best >= 0 && ringDist > 0 && ringDist * ringDist > bestDist2) break;
+
+            for (int y = cy - r; y <= cy + r; ++y) {
+                if (y < 0 || y >= m_rows) continue;
+                const bool edgeRow = (y == cy - r || y == cy + r);
+                for (int x = cx - r; x <= cx + r; x += (edgeRow || r == 0) ? 1 : 2 * r) {
+                    if (x < 0 || x >= m_cols) continue;
+                    const int c = y * m_cols + x;
+                    for (int k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k) {
+                        const Entry& e = m_entries[m_cellItems[k]];
+                        float dx = e.x - px, dy = e.y - py;
+                        float d2 = dx * dx + dy * dy;
+                        if (d2 <= bestDist2) {
+                            bestDist2 = d2;
+                            best = m_cellItems[k];
+                        }
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+    // Rows of all entries within radius of pos (unordered).
+    int radius(const QPointF& pos, float radius, QVector<int>& rows) const {
+        rows.clear();
+        if (m_cols == 0) return 0;
+
+        const float px = (float)pos.x(), py = (float)pos.y();
+        const float r2 = radius * radius;
+        const int x0 = qMax(0, (int)std::floor((px - radius - m_originX) / m_cellSize));
+        const int x1 = qMin(m_cols - 1, (int)std::floor((px + radius - m_originX) / m_cellSize));
+        const int y0 = qMax(0, (int)std::floor((py - radius - m_originY) / m_cellSize));
+        const int y1 = qMin(m_rows - 1, (int)std::floor((py + radius - m_originY) / m_cellSize));
+
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                const int c = y * m_cols + x;
+                for (int k = m_cellStart[c]; k < m_cellStart[c + 1]; ++k) {
+                    const Entry& e = m_entries[m_cellItems[k]];
+                    float dx = e.x - px, dy = e.y - py;
+                    if (dx * dx + dy * dy <= r2) rows.append(m_cellItems[k]);
+                }
+            }
+        }
+        return rows.size();
+    }
+
+private:
+    static constexpr float CELL_OCCUPANCY = 2.0f;
+    static constexpr float MAX_GRID_DIM = 1024.0f;
+
+    int cellIndex(float x, float y) const {
+        int cx = qBound(0, (int)((x - m_originX) / m_cellSize), m_cols - 1);
+        int cy = qBound(0, (int)((y - m_originY) / m_cellSize), m_rows - 1);
+        return cy * m_cols + cx;
+    }
+
+    QVector<Entry> m_entries;
+    QVector<int> m_cellStart;
+    QVector<int> m_cellItems;
+    float m_cellSize = 1.0f;
+    float m_originX = 0.0f;
+    float m_originY = 0.0f;
+    int m_cols = 0;
+    int m_rows = 0;
+};
+
+#endif // CSCANINDEX_H
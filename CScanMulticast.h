@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSCANMULTICAST_H
+#define CSCANMULTICAST_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QMap>
+#include <QHostAddress>
+#include <QNetworkInterface>
+#include <QUdpSocket>
+#include <QtEndian>
+#include <functional>
+#include <memory>
+
+/*
+ * Scan multicast: one sender (LumoDaemon --publish multicast), any number of
+ * receivers on the segment (CScanMulticastReceiver, LumoRecv).
+ *
+ * Datagram (little endian), HEADER_BYTES:
+ *   u32 magic 'LMCS' | u8 version | u8 flags | u16 sensor | u32 seq |
+ *   u16 fragment | u16 fragments | u32 scanBytes | u32 offset |
+ *   u32 configHash | i64 epochNs | scan bytes [offset, offset + n)
+ *
+ * Scan: u8 encoding | u8 channels | u16 measures | u16 firstAngle | i16 angleStep | data
+ *   rawPayload      data = getBulk payload as on the wire
+ *   implicitAngles  data = distance words only (big endian), angle i = firstAngle + i * angleStep
+ * implicitAngles is used whenever the angles are evenly spaced, which drops
+ * a third to a half of a 1 / 2 channel scan before it is split into fragments.
+ */
+namespace ScanMulticast {
+
+enum : quint32 { MAGIC = 0x53434D4C }; // "LMCS"
+enum { VERSION = 1, HEADER_BYTES = 36, SCAN_HEADER_BYTES = 8,
+    DEFAULT_PORT = 47800, DEFAULT_DATAGRAM_BYTES = 1472 };
+enum eEncoding { rawPayload = 0, implicitAngles = 1 };
+
+inline QHostAddress defaultGroup() { return QHostAddress("239.255.76.77"); }
+
+struct Scan {
+    quint16 sensor = 0;
+    quint32 seq = 0;
+    qint64 epochNs = 0;
+    quint32 configHash = 0;
+    int channels = 0;
+    QByteArray payload;     // rebuilt getBulk payload (decodeScanPayload)
+};
+
+inline QByteArray encodeScan(const QByteArray& payload, int channels)
+{
+    const int stride = 2 + channels * 2;
+    const int measures = payload.size() / stride;
+    const uchar* p = (const uchar*)payload.constData();
+
+    bool implicit = channels > 0 && channels < 256 && measures >= 2 && measures <= 0xFFFF && payload.size() == measures * stride;
+    const quint16 first = implicit ? qFromBigEndian<quint16>(p) : 0;
+    const qint16 step = implicit ? qint16(qFromBigEndian<quint16>(p + stride) - first) : 0;
+    for (int i = 2; implicit && i < measures; ++i) implicit = qFromBigEndian<quint16>(p + i * stride) == quint16(first + i * step);
+
+    QByteArray scan(SCAN_HEADER_BYTES + (implicit ? measures * channels * 2 : payload.size()), 0);
+    uchar* out = (uchar*)scan.data();
+    out[0] = implicit ? implicitAngles : rawPayload;
+    out[1] = uchar(qBound(0, channels, 255));
+    qToLittleEndian<quint16>(quint16(qMin(measures, 0xFFFF)), out + 2);
+    qToLittleEndian<quint16>(first, out + 4);
+    qToLittleEndian<qint16>(step, out + 6);
+    if (!implicit) {
+        memcpy(out + SCAN_HEADER_BYTES, p, payload.size());
+        return scan;
+    }
+    uchar* dist = out + SCAN_HEADER_BYTES;
+    for (int i = 0; i < measures; ++i, dist += channels * 2) memcpy(dist, p + i * stride + 2, channels * 2);
+    return scan;
+}
+
+inline bool decodeScan(const QByteArray& scan, QByteArray* payload, int* channels)
+{
+    if (scan.size() < SCAN_HEADER_BYTES) return false;
+    const uchar* in = (const uchar*)scan.constData();
+    *channels = in[1];
+    const int measures = qFromLittleEndian<quint16>(in + 2);
+    const quint16 first = qFromLittleEndian<quint16>(in + 4);
+    const qint16 step = qFromLittleEndian<qint16>(in + 6);
+    const int stride = 2 + *channels * 2;
+
+    if (in[0] == rawPayload) {
+        *payload = scan.mid(SCAN_HEADER_BYTES);
+        return true;
+    }
+    if (in[0] != implicitAngles || !*channels || scan.size() != SCAN_HEADER_BYTES + measures * *channels * 2) return false;
+    payload->resize(measures * stride);
+    uchar* out = (uchar*)payload->data();
+    const uchar* dist = in + SCAN_HEADER_BYTES;
+    for (int i = 0; i < measures; ++i, out += stride, dist += *channels * 2) {
+        qToBigEndian<quint16>(quint16(first + i * step), out);
+        memcpy(out + 2, dist, *channels * 2);
+    }
+    return true;
+}
+
+// Splits an encoded scan into datagrams of at most datagramBytes.
+inline QVector<QByteArray> fragment(const QByteArray& scan, quint16 sensor, quint32 seq, qint64 epochNs,
+    quint32 configHash, int datagramBytes = DEFAULT_DATAGRAM_BYTES)
+{
+    const int chunk = qMax(64, datagramBytes - HEADER_BYTES);
+    const int count = qMax(1, (scan.size() + chunk - 1) / chunk);
+    QVector<QByteArray> datagrams;
+    datagrams.reserve(count);
+    for (int f = 0; f < count; ++f) {
+        const int offset = f * chunk;
+        const int n = qMin(chunk, scan.size() - offset);
+        QByteArray d(HEADER_BYTES + n, 0);
+        uchar* h = (uchar*)d.data();
+        qToLittleEndian<quint32>(MAGIC, h);
+        h[4] = VERSION;
+        qToLittleEndian<quint16>(sensor, h + 6);
+        qToLittleEndian<quint32>(seq, h + 8);
+        qToLittleEndian<quint16>(quint16(f), h + 12);
+        qToLittleEndian<quint16>(quint16(count), h + 14);
+        qToLittleEndian<quint32>(quint32(scan.size()), h + 16);
+        qToLittleEndian<quint32>(quint32(offset), h + 20);
+        qToLittleEndian<quint32>(configHash, h + 24);
+        qToLittleEndian<qint64>(epochNs, h + 28);
+        memcpy(h + HEADER_BYTES, scan.constData() + offset, n);
+        datagrams.append(d);
+    }
+    return datagrams;
+}
+
+} // namespace ScanMulticast
+
+/**
+ * @brief Joins the group and reassembles scans; handler runs on the socket's thread.
+ *
+ * Per sensor, up to MAX_PENDING scans may be in flight. When a scan
+ * completes, every older one still missing fragments is dropped; lost
+ * counts the seq gaps between delivered scans, so it includes those.
+ */
+class CScanMulticastReceiver
+{
+public:
+    enum { MAX_PENDING = 8, RECEIVE_BUFFER_BYTES = 4 * 1024 * 1024, MAX_SCAN_BYTES = 16 * 1024 * 1024 };
+
+    struct Stats {
+        quint64 datagrams = 0;
+        quint64 bytes = 0;
+        quint64 scans = 0;
+        quint64 lost = 0;
+        quint64 bad = 0;        // malformed or inconsistent datagrams
+    };
+
+    void setHandler(std::function<void(const ScanMulticast::Scan&)> handler) { m_handler = handler; }
+
+    bool open(const QHostAddress& group, quint16 port, const QString& interfaceName = QString())
+    {
+        close();
+        m_socket.reset(new QUdpSocket);
+        if (!m_socket->bind(QHostAddress(QHostAddress::AnyIPv4), port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint)) return false;
+        m_socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, RECEIVE_BUFFER_BYTES);
+        bool joined = interfaceName.isEmpty() ? m_socket->joinMulticastGroup(group)
+            : m_socket->joinMulticastGroup(group, QNetworkInterface::interfaceFromName(interfaceName));
+        if (!joined) return false;
+        QObject::connect(m_socket.get(), &QUdpSocket::readyRead, m_socket.get(), [this]() { read(); });
+        return true;
+    }
+
+    void close()
+    {
+        m_socket.reset();
+        m_sensors.clear();
+    }
+
+    // Sensors seen so far, and their totals.
+    QList<quint16> sensors() const { return m_sensors.keys(); }
+    Stats stats(quint16 sensor) const { return m_sensors.value(sensor).stats; }
+
+    // One datagram (also for tests without a socket).
+    void feed(const QByteArray& d)
+    {
+        using namespace ScanMulticast;
+        if (d.size() < HEADER_BYTES) return;
+        const uchar* h = (const uchar*)d.constData();
+        if (qFromLittleEndian<quint32>(h) != MAGIC || h[4] != VERSION) return;
+
+        const quint16 sensor = qFromLittleEndian<quint16>(h + 6);
+        Sensor& s = m_sensors[sensor];
+        ++s.stats.datagrams;
+        s.stats.bytes += d.size();
+
+        const quint32 seq = qFromLittleEndian<quint32>(h + 8);
+        const int frag = qFromLittleEndian<quint16>(h + 12);
+        const int count = qFromLittleEndian<quint16>(h + 14);
+        const quint32 scanBytes = qFromLittleEndian<quint32>(h + 16);
+        const quint32 offset = qFromLittleEndian<quint32>(h + 20);
+        const int n = d.size() - HEADER_BYTES;
+        if (!count || frag >= count || scanBytes > MAX_SCAN_BYTES || quint64(offset) + n > scanBytes) {
+            ++s.stats.bad;
+            return;
+        }
+        const qint64 epochNs = qFromLittleEndian<qint64>(h + 28);
+        if (s.delivered && qint32(seq - s.last) <= 0) {
+            if (epochNs <= s.lastEpochNs) return; // late or duplicate
+            s.delivered = false; // an older seq with a newer scan: the sender restarted
+            s.pending.clear();
+        }
+
+        Pending& p = s.pending[seq];
+        if (p.fragments.isEmpty()) {
+            p.fragments.fill(false, count);
+            p.scan.resize(int(scanBytes));
+            p.epochNs = epochNs;
+            p.configHash = qFromLittleEndian<quint32>(h + 24);
+        }
+        else if (p.fragments.size() != count || p.scan.size() != int(scanBytes)) {
+            ++s.stats.bad;
+            return;
+        }
+        if (p.fragments[frag]) return;
+        p.fragments[frag] = true;
+        memcpy(p.scan.data() + offset, h + HEADER_BYTES, n);
+        if (++p.received < count) {
+            // keep the newest MAX_PENDING (QMap is ordered by seq; fine until the u32 wraps)
+            while (s.pending.size() > MAX_PENDING) s.pending.erase(s.pending.begin());
+            return;
+        }
+
+        Scan scan;
+        scan.sensor = sensor;
+        scan.seq = seq;
+        scan.epochNs = p.epochNs;
+        scan.configHash = p.configHash;
+        const bool ok = decodeScan(p.scan, &scan.payload, &scan.channels);
+        // this one and everything older is done
+        while (!s.pending.isEmpty() && qint32(s.pending.firstKey() - seq) <= 0) s.pending.erase(s.pending.begin());
+        if (s.delivered) s.stats.lost += seq - s.last - 1;
+        s.delivered = true;
+        s.last = seq;
+        s.lastEpochNs = scan.epochNs;
+        if (!ok) {
+            ++s.stats.bad;
+            return;
+        }
+        ++s.stats.scans;
+        if (m_handler) m_handler(scan);
+    }
+
+private:
+    struct Pending {
+        QVector<bool> fragments;
+        int received = 0;
+        QByteArray scan;
+        qint64 epochNs = 0;
+        quint32 configHash = 0;
+    };
+
+    struct Sensor {
+        bool delivered = false;
+        quint32 last = 0;
+        qint64 lastEpochNs = 0;
+        QMap<quint32, Pending> pending;
+        Stats stats;
+    };
+
+    void read()
+    {
+        while (m_socket->hasPendingDatagrams()) {
+            m_datagram.resize(int(m_socket->pendingDatagramSize()));
+            if (m_socket->readDatagram(m_datagram.data(), m_datagram.size()) < 0) continue;
+            feed(m_datagram);
+        }
+    }
+
+    std::unique_ptr<QUdpSocket> m_socket;
+    std::function<void(const ScanMulticast::Scan&)> m_handler;
+    QMap<quint16, Sensor> m_sensors;
+    QByteArray m_datagram;
+};
+
+#endif // CSCANMULTICAST_H
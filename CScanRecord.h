@@ -0,0 +1,440 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSCANRECORD_H
+#define CSCANRECORD_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+#include "CScanCodec.h"
+
+/*
+ * Recording file (.lrec), little endian:
+ *
+ *   Header  "LUMOREC1" | u32 version | u32 headerSize | u64 startEpochMs
+ *           | u32 configHash | u32 configJsonSize | config JSON (LidarConfig::toJson)
+ *   Frame   u64 timeNs (monotonic, from start) | u16 linkId | u16 flags
+ *           | u32 configHash | u32 size | raw frame bytes (as received, before unpack)
+ *   Footer  N x { u64 offset | u64 timeNs } | u64 indexOffset | u32 N | u32 0 | "LUMOIDX1"
+ *
+ * A file without a valid footer (crash, power loss) is still readable; the
+ * reader rebuilds the index by walking the frames.
+ *
+ * flags FLAG_CODED: the frame bytes are a CScanCodec block, a temporal delta
+ * to the previous frame unless FLAG_KEY is also set. A keyframe is written
+ * every CScanCodec::KEYFRAME_INTERVAL frames and whenever the size changes.
+ */
+namespace ScanRecord {
+    static const char FILE_MAGIC[8] = { 'L', 'U', 'M', 'O', 'R', 'E', 'C', '1' };
+    static const char INDEX_MAGIC[8] = { 'L', 'U', 'M', 'O', 'I', 'D', 'X', '1' };
+    enum {
+        VERSION = 1,
+        FIXED_HEADER_SIZE = 32,
+        FRAME_HEADER_SIZE = 20,
+        INDEX_ENTRY_SIZE = 16,
+        TRAILER_SIZE = 24,
+    };
+    enum { FLAG_CODED = 0x0001, FLAG_KEY = 0x0002 };
+
+    struct IndexEntry {
+        quint64 offset;   // of the frame header
+        quint64 timeNs;
+    };
+}
+
+/**
+ * @brief Indexed, seekable sequence of received frames (replay input).
+ */
+class IFrameSource {
+public:
+    struct Frame {
+        quint64 timeNs;
+        quint16 linkId;
+        quint32 configHash;
+        QByteArray data; // may point into the source's mapping, valid while it is open
+    };
+
+    virtual ~IFrameSource() {}
+    virtual bool open(const QString& path) = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+    virtual int frameCount() const = 0;
+    virtual quint64 frameTimeNs(int i) const = 0;   // relative to the start of the source
+    virtual int frameSize(int i) const = 0;
+    virtual bool frame(int i, Frame* out) const = 0;
+    virtual int seek(quint64 timeNs) const = 0;     // first frame at or after timeNs
+    virtual quint64 durationNs() const = 0;
+    virtual const QJsonObject& config() const = 0;  // LidarConfig::toJson, empty if unknown
+    virtual quint32 configHash() const = 0;         // 0 if unknown
+};
+
+/**
+ * @brief Appends received frames to a recording with large sequential writes.
+ *
+ * Frames are packed into a WRITE_BLOCK buffer and written when it fills, so the
+ * per-frame cost is a memcpy; the index is kept in memory and written as the
+ * footer on close().
+ */
+class CScanRecorder
+{
+public:
+    enum { WRITE_BLOCK = 4 << 20 };
+
+    ~CScanRecorder() { close(); }
+
+    // Delta-code the frames of the next open() (CScanCodec).
+    void setCompressed(bool compressed) { m_compressed = compressed; }
+    bool isCompressed() const { return m_compressed; }
+
+    // startEpochMs < 0: now. (CBlackBox passes the wall time of its oldest frame.)
+    bool open(const QString& path, const QJsonObject& config, quint32 configHash, qint64 startEpochMs = -1)
+    {
+        close();
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+        QByteArray json = QJsonDocument(config).toJson(QJsonDocument::Compact);
+        QByteArray header(ScanRecord::FIXED_HEADER_SIZE, 0);
+        uchar* h = (uchar*)header.data();
+        memcpy(h, ScanRecord::FILE_MAGIC, 8);
+        qToLittleEndian<quint32>(ScanRecord::VERSION, h + 8);
+        qToLittleEndian<quint32>(ScanRecord::FIXED_HEADER_SIZE + json.size(), h + 12);
+        qToLittleEndian<quint64>(startEpochMs < 0 ? QDateTime::currentMSecsSinceEpoch() : startEpochMs, h + 16);
+        qToLittleEndian<quint32>(configHash, h + 24);
+        qToLittleEndian<quint32>(json.size(), h + 28);
+
+        m_block.resize(0);
+        m_block.reserve(WRITE_BLOCK);
+        m_block.append(header).append(json);
+        m_offset = m_block.size();
+        m_index.clear();
+        m_bytesWritten = 0;
+        m_rawBytes = 0;
+        m_prev.clear();
+        m_sinceKey = 0;
+        m_clock.start();
+        return true;
+    }
+
+    bool isOpen() const { return m_file.isOpen(); }
+
+    // timeNs < 0: time since open().
+    bool write(const QByteArray& frame, quint16 linkId, quint32 configHash, qint64 timeNs = -1)
+    {
+        if (!m_file.isOpen()) return false;
+
+        const int maxSize = m_compressed ? CScanCodec::maxEncodedSize(frame.size()) : frame.size();
+        if (m_block.size() + ScanRecord::FRAME_HEADER_SIZE + maxSize > WRITE_BLOCK && !flush()) return false;
+
+        // indexed only once the frame is in the block (a failed flush drops it)
+        ScanRecord::IndexEntry entry = { m_offset, (quint64)(timeNs < 0 ? m_clock.nsecsElapsed() : timeNs) };
+        const int headerAt = m_block.size();
+        m_block.resize(headerAt + ScanRecord::FRAME_HEADER_SIZE);
+
+        quint16 flags = 0;
+        int size = frame.size();
+        if (m_compressed) {
+            bool key = m_sinceKey == 0 || m_prev.size() != frame.size();
+            flags = ScanRecord::FLAG_CODED | (key ? ScanRecord::FLAG_KEY : 0);
+            size = CScanCodec::encode((const uchar*)frame.constData(), frame.size(),
+                key ? nullptr : (const uchar*)m_prev.constData(), m_block);
+            m_sinceKey = key ? 1 : (m_sinceKey + 1) % CScanCodec::KEYFRAME_INTERVAL;
+            // own copy: frame may be fromRawData over a buffer the caller reuses (CBlackBox::dump)
+            m_prev.resize(frame.size());
+            memcpy(m_prev.data(), frame.constData(), frame.size());
+        }
+        else {
+            m_block.append(frame);
+        }
+
+        uchar* h = (uchar*)m_block.data() + headerAt;
+        qToLittleEndian<quint64>(entry.timeNs, h);
+        qToLittleEndian<quint16>(linkId, h + 8);
+        qToLittleEndian<quint16>(flags, h + 10);
+        qToLittleEndian<quint32>(configHash, h + 12);
+        qToLittleEndian<quint32>(size, h + 16);
+        m_offset += ScanRecord::FRAME_HEADER_SIZE + size;
+        m_index.append(entry);
+        m_rawBytes += frame.size();
+        return true;
+    }
+
+    void close()
+    {
+        if (!m_file.isOpen()) return;
+
+        flush();
+        QByteArray footer;
+        footer.resize(m_index.size() * ScanRecord::INDEX_ENTRY_SIZE + ScanRecord::TRAILER_SIZE);
+        uchar* p = (uchar*)footer.data();
+        for (const ScanRecord::IndexEntry& e : qAsConst(m_index)) {
+            qToLittleEndian<quint64>(e.offset, p);
+            qToLittleEndian<quint64>(e.timeNs, p + 8);
+            p += ScanRecord::INDEX_ENTRY_SIZE;
+        }
+        qToLittleEndian<quint64>(m_offset, p);
+        qToLittleEndian<quint32>(m_index.size(), p + 8);
+        qToLittleEndian<quint32>(0, p + 12);
+        memcpy(p + 16, ScanRecord::INDEX_MAGIC, 8);
+        m_file.write(footer);
+        m_file.close();
+    }
+
+    int frameCount() const { return m_index.size(); }
+    quint64 bytesWritten() const { return m_bytesWritten + m_block.size(); }
+    quint64 rawBytes() const { return m_rawBytes; } // frame bytes before coding
+    QString fileName() const { return m_file.fileName(); }
+
+private:
+    // On a failed write the buffered frames are lost: their index entries and any
+    // partial write are dropped, so the footer only lists frames that are in the file.
+    bool flush()
+    {
+        if (m_block.isEmpty()) return true;
+        const quint64 blockStart = m_offset - m_block.size();
+        bool ok = m_file.write(m_block) == m_block.size();
+        if (ok) {
+            m_bytesWritten += m_block.size();
+        }
+        else {
+            while (!m_index.isEmpty() && m_index.last().offset >= blockStart) m_index.removeLast();
+            m_file.resize(blockStart);
+            m_file.seek(blockStart);
+            m_offset = blockStart;
+            m_sinceKey = 0; // the next frame can't be a delta to a lost one
+        }
+        m_block.resize(0);
+        return ok;
+    }
+
+    QFile m_file;
+    QByteArray m_block;
+    quint64 m_offset = 0;
+    quint64 m_bytesWritten = 0;
+    quint64 m_rawBytes = 0;
+    QVector<ScanRecord::IndexEntry> m_index;
+    QElapsedTimer m_clock;
+
+    bool m_compressed = false;
+    QByteArray m_prev;
+    int m_sinceKey = 0;
+};
+
+/**
+ * @brief Memory-mapped read access to a recording; frames are zero-copy views.
+ *
+ * Coded frames are decoded into one cached buffer; reading frames in order
+ * applies one delta per frame, a seek replays at most one chunk.
+ */
+class CScanReader : public IFrameSource
+{
+public:
+    ~CScanReader() { close(); }
+
+    // Frame::data is fromRawData over the mapping, or the decoded copy for coded frames.
+    bool open(const QString& path) override
+    {
+        close();
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::ReadOnly)) return false;
+
+        m_size = m_file.size();
+        m_base = m_size > 0 ? m_file.map(0, m_size) : nullptr;
+        if (!m_base || m_size < ScanRecord::FIXED_HEADER_SIZE
+            || memcmp(m_base, ScanRecord::FILE_MAGIC, 8) != 0) {
+            close();
+            return false;
+        }
+
+        m_startEpochMs = qFromLittleEndian<quint64>(m_base + 16);
+        m_configHash = qFromLittleEndian<quint32>(m_base + 24);
+        quint32 headerSize = qFromLittleEndian<quint32>(m_base + 12);
+        quint32 jsonSize = qFromLittleEndian<quint32>(m_base + 28);
+        if (headerSize > m_size || ScanRecord::FIXED_HEADER_SIZE + jsonSize > headerSize) {
+            close();
+            return false;
+        }
+        m_config = QJsonDocument::fromJson(QByteArray((const char*)m_base + ScanRecord::FIXED_HEADER_SIZE, jsonSize)).object();
+
+        if (!loadFooter(headerSize)) rebuildIndex(headerSize);
+        return true;
+    }
+
+    void close() override
+    {
+        if (m_base) m_file.unmap(m_base);
+        m_base = nullptr;
+        m_file.close();
+        m_index.clear();
+        m_decoded.clear();
+        m_decodedIndex = -1;
+    }
+
+    bool isOpen() const override { return m_base != nullptr; }
+    int frameCount() const override { return m_index.size(); }
+    quint64 startEpochMs() const { return m_startEpochMs; }
+    quint32 configHash() const override { return m_configHash; }
+    const QJsonObject& config() const override { return m_config; }
+
+    quint64 durationNs() const override
+    {
+        return m_index.isEmpty() ? 0 : m_index.last().timeNs - m_index.first().timeNs;
+    }
+
+    quint64 frameTimeNs(int i) const override { return m_index[i].timeNs; }
+
+    // Frame size as received (decoded size for coded frames), without decoding.
+    int frameSize(int i) const override
+    {
+        if (i < 0 || i >= m_index.size()) return -1;
+        const uchar* h = m_base + m_index[i].offset;
+        quint32 size = qFromLittleEndian<quint32>(h + 16);
+        if (!(qFromLittleEndian<quint16>(h + 10) & ScanRecord::FLAG_CODED)) return (int)size;
+        return CScanCodec::rawSize(h + ScanRecord::FRAME_HEADER_SIZE, size);
+    }
+
+    bool frame(int i, Frame* out) const override
+    {
+        if (i < 0 || i >= m_index.size()) return false;
+        const uchar* h = m_base + m_index[i].offset;
+        out->timeNs = qFromLittleEndian<quint64>(h);
+        out->linkId = qFromLittleEndian<quint16>(h + 8);
+        out->configHash = qFromLittleEndian<quint32>(h + 12);
+        quint32 size = qFromLittleEndian<quint32>(h + 16);
+        if (qFromLittleEndian<quint16>(h + 10) & ScanRecord::FLAG_CODED) {
+            if (!decodeTo(i)) return false;
+            out->data = m_decoded;
+            return true;
+        }
+        out->data = QByteArray::fromRawData((const char*)h + ScanRecord::FRAME_HEADER_SIZE, size);
+        return true;
+    }
+
+    // First frame at or after timeNs (binary search on the index).
+    int seek(quint64 timeNs) const override
+    {
+        auto it = std::lower_bound(m_index.constBegin(), m_index.constEnd(), timeNs,
+            [](const ScanRecord::IndexEntry& e, quint64 t) { return e.timeNs < t; });
+        return qMin(int(it - m_index.constBegin()), qMax(0, m_index.size() - 1));
+    }
+
+private:
+    quint16 frameFlags(int i) const
+    {
+        return qFromLittleEndian<quint16>(m_base + m_index[i].offset + 10);
+    }
+
+    // Decode frame i into m_decoded, from the cached frame or its keyframe.
+    bool decodeTo(int i) const
+    {
+        if (m_decodedIndex == i) return true;
+
+        int key = i;
+        while (key > 0 && !(frameFlags(key) & ScanRecord::FLAG_KEY)) --key;
+        int j = (m_decodedIndex >= key && m_decodedIndex < i) ? m_decodedIndex + 1 : key;
+
+        for (; j <= i; ++j) {
+            const uchar* h = m_base + m_index[j].offset;
+            const uchar* in = h + ScanRecord::FRAME_HEADER_SIZE;
+            int inSize = (int)qFromLittleEndian<quint32>(h + 16);
+            int rawSize = CScanCodec::rawSize(in, inSize);
+            bool isKey = frameFlags(j) & ScanRecord::FLAG_KEY;
+            if (rawSize < 0 || (!isKey && rawSize != m_decoded.size())) {
+                m_decodedIndex = -1;
+                return false;
+            }
+            m_decoded.resize(rawSize);
+            uchar* out = (uchar*)m_decoded.data(); // detaches if a caller still holds the previous frame
+            if (!CScanCodec::decode(in, inSize, isKey ? nullptr : out, out, rawSize)) {
+                m_decodedIndex = -1;
+                return false;
+            }
+            m_decodedIndex = j;
+        }
+        return true;
+    }
+
+    // Every entry must hold a whole frame between the header and the index; frame()
+    // and frameSize() rely on it. Any bad entry rejects the footer (linear scan instead).
+    bool loadFooter(quint64 headerSize)
+    {
+        if (m_size < ScanRecord::FIXED_HEADER_SIZE + ScanRecord::TRAILER_SIZE) return false;
+        const uchar* t = m_base + m_size - ScanRecord::TRAILER_SIZE;
+        if (memcmp(t + 16, ScanRecord::INDEX_MAGIC, 8) != 0) return false;
+
+        quint64 indexOffset = qFromLittleEndian<quint64>(t);
+        quint32 count = qFromLittleEndian<quint32>(t + 8);
+        if (indexOffset < headerSize || indexOffset > (quint64)m_size
+            || indexOffset + (quint64)count * ScanRecord::INDEX_ENTRY_SIZE + ScanRecord::TRAILER_SIZE != (quint64)m_size)
+            return false;
+
+        m_index.resize(count);
+        const uchar* p = m_base + indexOffset;
+        for (quint32 i = 0; i < count; ++i, p += ScanRecord::INDEX_ENTRY_SIZE) {
+            const quint64 offset = qFromLittleEndian<quint64>(p);
+            if (offset < headerSize || offset > indexOffset - ScanRecord::FRAME_HEADER_SIZE
+                || offset + ScanRecord::FRAME_HEADER_SIZE + qFromLittleEndian<quint32>(m_base + offset + 16) > indexOffset) {
+                m_index.clear();
+                return false;
+            }
+            m_index[i].offset = offset;
+            m_index[i].timeNs = qFromLittleEndian<quint64>(p + 8);
+        }
+        return true;
+    }
+
+    // Unterminated recording: walk the frames, stop at the first truncated one. A partly
+    // written footer is not a frame: unknown flags or a time going backwards end the walk.
+    void rebuildIndex(quint64 offset)
+    {
+        m_index.clear();
+        while (offset + ScanRecord::FRAME_HEADER_SIZE <= (quint64)m_size) {
+            const uchar* h = m_base + offset;
+            quint64 next = offset + ScanRecord::FRAME_HEADER_SIZE + qFromLittleEndian<quint32>(h + 16);
+            if (next > (quint64)m_size) break;
+            if (qFromLittleEndian<quint16>(h + 10) & ~(ScanRecord::FLAG_CODED | ScanRecord::FLAG_KEY)) break;
+            if (!m_index.isEmpty() && qFromLittleEndian<quint64>(h) < m_index.last().timeNs) break;
+            ScanRecord::IndexEntry entry = { offset, qFromLittleEndian<quint64>(h) };
+            m_index.append(entry);
+            offset = next;
+        }
+    }
+
+    QFile m_file;
+    uchar* m_base = nullptr;
+    qint64 m_size = 0;
+    quint64 m_startEpochMs = 0;
+    quint32 m_configHash = 0;
+    QJsonObject m_config;
+    QVector<ScanRecord::IndexEntry> m_index;
+
+    mutable QByteArray m_decoded;
+    mutable int m_decodedIndex = -1;
+};
+
+#endif // CSCANRECORD_H
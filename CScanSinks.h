@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSCANSINKS_H
+#define CSCANSINKS_H
+
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QtEndian>
+
+#include "CAcqSession.h"
+#include "CScanRecord.h"
+#include "CShmScanRing.h"
+#include "CScanMulticast.h"
+
+/**
+ * @brief Appends every received frame to a .lrec (replayable in the viewer).
+ *
+ * One file per sensor: <dir>/<sensor>_yyyyMMdd_hhmmss.lrec.
+ */
+class CRecordSink : public IScanSink
+{
+public:
+    CRecordSink(const QString& dir, bool compressed = true) : m_dir(dir), m_compressed(compressed) {}
+
+    bool open(const CAcqSession& session) override
+    {
+        if (!QDir().mkpath(m_dir)) return false;
+        m_path = QString("%1/%2_%3.lrec").arg(m_dir).arg(safeName(session.name()))
+            .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
+        m_recorder.setCompressed(m_compressed);
+        return m_recorder.open(m_path, session.config().toJson(), session.configHash());
+    }
+
+    void publish(const AcqScan& scan) override
+    {
+        m_recorder.write(scan.frame, quint16(scan.sensor), scan.configHash);
+    }
+
+    void close() override { m_recorder.close(); }
+    QString describe() const override { return "file " + (m_path.isEmpty() ? m_dir : m_path); }
+
+    static QString safeName(QString name)
+    {
+        for (QChar& c : name) {
+            if (!c.isLetterOrNumber() && c != '-' && c != '_') c = '_';
+        }
+        return name;
+    }
+
+private:
+    QString m_dir;
+    QString m_path;
+    bool m_compressed;
+    CScanRecorder m_recorder;
+};
+
+/**
+ * @brief Streams scans to local clients on QLocalServer "LumoMap.scans.<sensor>".
+ *
+ * Message (little endian): u32 magic 'LSCN' | u16 version | u16 channels |
+ * u64 seq | i64 epochNs | u32 configHash | u32 payloadBytes | payload
+ * (the getBulk payload as on the wire, big endian). A client more than
+ * MAX_BACKLOG bytes behind misses scans instead of growing the buffer;
+ * it sees the gap in seq.
+ */
+class CLocalSocketSink : public IScanSink
+{
+public:
+    enum : quint32 { MAGIC = 0x4E43534C }; // "LSCN"
+    enum { VERSION = 1, HEADER_BYTES = 32, MAX_BACKLOG = 4 * 1024 * 1024 };
+
+    static QString serverName(const QString& sensor) { return "LumoMap.scans." + CRecordSink::safeName(sensor); }
+
+    bool open(const CAcqSession& session) override
+    {
+        m_channels = session.config().channels;
+        m_name = serverName(session.name());
+        m_server.reset(new QLocalServer);
+        QLocalServer::removeServer(m_name); // stale socket of a crashed daemon
+        if (!m_server->listen(m_name)) return false;
+        QObject::connect(m_server.get(), &QLocalServer::newConnection, m_server.get(), [this]() {
+            while (QLocalSocket* client = m_server->nextPendingConnection()) {
+                QObject::connect(client, &QLocalSocket::disconnected, client, &QObject::deleteLater);
+                m_clients.append(client);
+            }
+        });
+        return true;
+    }
+
+    void publish(const AcqScan& scan) override
+    {
+        for (int i = m_clients.size() - 1; i >= 0; --i) {
+            if (!m_clients[i]) m_clients.removeAt(i);
+        }
+        if (m_clients.isEmpty()) return;
+
+        m_message.resize(HEADER_BYTES + scan.payload.size());
+        uchar* p = (uchar*)m_message.data();
+        qToLittleEndian<quint32>(MAGIC, p);
+        qToLittleEndian<quint16>(VERSION, p + 4);
+        qToLittleEndian<quint16>(quint16(m_channels), p + 6);
+        qToLittleEndian<quint64>(scan.seq, p + 8);
+        qToLittleEndian<qint64>(scan.epochNs, p + 16);
+        qToLittleEndian<quint32>(scan.configHash, p + 24);
+        qToLittleEndian<quint32>(quint32(scan.payload.size()), p + 28);
+        memcpy(p + HEADER_BYTES, scan.payload.constData(), scan.payload.size());
+
+        for (const QPointer<QLocalSocket>& client : m_clients) {
+            if (client->state() != QLocalSocket::ConnectedState || client->bytesToWrite() > MAX_BACKLOG) continue;
+            client->write(m_message);
+        }
+    }
+
+    void close() override
+    {
+        for (const QPointer<QLocalSocket>& client : m_clients) {
+            if (client) client->abort();
+        }
+        m_clients.clear();
+        m_server.reset();
+    }
+
+    QString describe() const override { return "socket " + m_name; }
+
+private:
+    std::unique_ptr<QLocalServer> m_server;
+    QVector<QPointer<QLocalSocket>> m_clients;
+    QString m_name;
+    int m_channels = 1;
+    QByteArray m_message;
+};
+
+/**
+ * @brief Publishes scans to the shared-memory ring ShmScan::segmentName(<sensor>).
+ *
+ * Readers use CShmScanReader (CShmScanRing.h). Points are sent as float
+ * x, y in meters; without the transform stage only the payload is filled.
+ */
+class CShmSink : public IScanSink
+{
+public:
+    CShmSink(int slots = CShmScanWriter::DEFAULT_SLOTS) : m_slots(slots) {}
+
+    bool open(const CAcqSession& session) override
+    {
+        const LidarConfig& cfg = session.config();
+        m_name = ShmScan::segmentName(CRecordSink::safeName(session.name()));
+        return m_writer.create(m_name, cfg.channels, quint32(cfg.mesuresPerScan * cfg.channels),
+            quint32(session.reqWordSize() * 2), session.configHash(), quint32(qMax(2, m_slots)));
+    }
+
+    void publish(const AcqScan& scan) override
+    {
+        m_xy.resize(scan.points.size() * 2);
+        for (int i = 0; i < scan.points.size(); ++i) {
+            m_xy[i * 2] = float(scan.points[i].x());
+            m_xy[i * 2 + 1] = float(scan.points[i].y());
+        }
+        m_writer.publish(scan.epochNs, m_xy.constData(), scan.points.size(), scan.payload);
+    }
+
+    void close() override { m_writer.close(); }
+    QString describe() const override { return "shm " + m_name; }
+
+private:
+    int m_slots;
+    QString m_name;
+    CShmScanWriter m_writer;
+    QVector<float> m_xy;
+};
+
+/**
+ * @brief Multicasts every scan (CScanMulticast.h format) for any number of receivers.
+ *
+ * Loopback is on, so receivers on the same host see the scans too; ttl 1
+ * keeps them on the local segment.
+ */
+class CMulticastSink : public IScanSink
+{
+public:
+    CMulticastSink(const QHostAddress& group = ScanMulticast::defaultGroup(), quint16 port = ScanMulticast::DEFAULT_PORT,
+        int ttl = 1, int datagramBytes = ScanMulticast::DEFAULT_DATAGRAM_BYTES, const QString& interfaceName = QString())
+        : m_group(group), m_port(port), m_ttl(ttl), m_datagramBytes(datagramBytes), m_interface(interfaceName) {}
+
+    bool open(const CAcqSession& session) override
+    {
+        m_channels = session.config().channels;
+        m_sensor = quint16(session.index());
+        m_socket.reset(new QUdpSocket);
+        if (!m_socket->bind(QHostAddress(QHostAddress::AnyIPv4), 0)) return false;
+        m_socket->setSocketOption(QAbstractSocket::MulticastTtlOption, m_ttl);
+        m_socket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+        if (!m_interface.isEmpty()) m_socket->setMulticastInterface(QNetworkInterface::interfaceFromName(m_interface));
+        return true;
+    }
+
+    void publish(const AcqScan& scan) override
+    {
+        const QByteArray encoded = ScanMulticast::encodeScan(scan.payload, m_channels);
+        for (const QByteArray& d : ScanMulticast::fragment(encoded, m_sensor, quint32(scan.seq), scan.epochNs, scan.configHash, m_datagramBytes)) {
+            m_socket->writeDatagram(d, m_group, m_port);
+        }
+    }
+
+    void close() override { m_socket.reset(); }
+    QString describe() const override { return QString("multicast %1:%2").arg(m_group.toString()).arg(m_port); }
+
+private:
+    QHostAddress m_group;
+    quint16 m_port;
+    int m_ttl;
+    int m_datagramBytes;
+    QString m_interface;
+    int m_channels = 1;
+    quint16 m_sensor = 0;
+    std::unique_ptr<QUdpSocket> m_socket;
+};
+
+#endif // CSCANSINKS_H
@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSHMSCANRING_H
+#define CSHMSCANRING_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Shared-memory scan ring: one writer (the acquisition session), any number
+ * of readers in other processes. Only this header is needed to read.
+ *
+ * Segment: Header (64 B) | slot 0 | slot 1 | ... , slot = SlotHeader (64 B)
+ * | float x, y [maxPoints] (meters, sensor frame) | payload [maxPayload]
+ * (getBulk payload as on the wire). Scan `seq` goes to slot seq % slotCount.
+ *
+ * Every slot has a seqlock: odd while the writer fills it. A reader checks
+ * it before and after reading and drops the read when it changed, so readers
+ * never write to the segment and cost the writer nothing. A reader that falls
+ * more than slotCount scans behind skips ahead and counts the scans as lost.
+ */
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory atomics must be lock free");
+
+namespace ShmScan {
+
+enum : quint32 { MAGIC = 0x4D48534C }; // "LSHM"
+enum { VERSION = 1, LINE = 64 };
+
+struct Header {
+    quint32 magic;
+    quint16 version;
+    quint16 channels;
+    quint32 slotCount;
+    quint32 slotBytes;          // SlotHeader + points + payload, multiple of LINE
+    quint32 maxPoints;
+    quint32 maxPayload;
+    quint32 configHash;
+    quint32 writerPid;
+    std::atomic<quint64> head;  // seq of the next scan = published count
+    std::atomic<quint32> live;  // 0 after the writer closed
+    char reserved[LINE - 44];
+};
+
+struct SlotHeader {
+    std::atomic<quint32> lock;  // seqlock
+    quint32 pointCount;
+    quint64 seq;
+    qint64 epochNs;             // receive time (wall clock)
+    qint64 publishNs;           // steady clock at publish, for latency
+    quint32 payloadBytes;
+    quint32 configHash;
+    char reserved[LINE - 40];
+};
+
+static_assert(sizeof(Header) == LINE && sizeof(SlotHeader) == LINE, "ring headers are one cache line");
+
+// steady_clock: CLOCK_MONOTONIC / QueryPerformanceCounter, same in every process.
+inline qint64 steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline QString segmentName(const QString& sensor) { return "LumoMap.scans." + sensor; }
+
+/**
+ * @brief Named shared memory: shm_open + mmap, CreateFileMapping on Windows.
+ */
+class Segment
+{
+public:
+    Segment() {}
+    ~Segment() { close(); }
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    // Replaces a segment left by a writer that didn't close it.
+    bool create(const QString& name, size_t bytes)
+    {
+        close();
+#ifdef Q_OS_WIN
+        m_handle = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+            DWORD(quint64(bytes) >> 32), DWORD(bytes), (LPCWSTR)nativeName(name).utf16());
+        if (!m_handle) return false;
+        m_data = MapViewOfFile(m_handle, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+#else
+        m_name = nativeName(name).toUtf8();
+        shm_unlink(m_name.constData());
+        int fd = shm_open(m_name.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, off_t(bytes)) == 0) {
+            void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            m_data = (p == MAP_FAILED) ? nullptr : p;
+        }
+        ::close(fd);
+        m_owner = true;
+#endif
+        m_size = bytes;
+        if (!m_data) close();
+        return m_data != nullptr;
+    }
+
+    bool open(const QString& name)
+    {
+        close();
+#ifdef Q_OS_WIN
+        m_handle = OpenFileMappingW(FILE_MAP_READ, FALSE, (LPCWSTR)nativeName(name).utf16());
+        if (!m_handle) return false;
+        m_data = MapViewOfFile(m_handle, FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info;
+        if (m_data && VirtualQuery(m_data, &info, sizeof(info))) m_size = info.RegionSize;
+#else
+        m_name = nativeName(name).toUtf8();
+        int fd = shm_open(m_name.constData(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            m_data = (p == MAP_FAILED) ? nullptr : p;
+            m_size = size_t(st.st_size);
+        }
+        ::close(fd);
+#endif
+        if (!m_data) close();
+        return m_data != nullptr;
+    }
+
+    void close()
+    {
+#ifdef Q_OS_WIN
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_handle) CloseHandle(m_handle);
+        m_handle = nullptr;
+#else
+        if (m_data) munmap(m_data, m_size);
+        if (m_owner) shm_unlink(m_name.constData()); // mapped readers keep their view
+        m_owner = false;
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    void* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+#ifdef Q_OS_WIN
+    static QString nativeName(const QString& name) { return "Local\\" + name; }
+    HANDLE m_handle = nullptr;
+#else
+    static QString nativeName(const QString& name) { return "/" + name; }
+    QByteArray m_name;
+    bool m_owner = false;
+#endif
+    void* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+inline size_t slotBytes(quint32 maxPoints, quint32 maxPayload)
+{
+    size_t bytes = sizeof(SlotHeader) + size_t(maxPoints) * 2 * sizeof(float) + maxPayload;
+    return (bytes + LINE - 1) / LINE * LINE;
+}
+
+} // namespace ShmScan
+
+/**
+ * @brief Writer side. publish() is wait-free: two stores around the copy.
+ */
+class CShmScanWriter
+{
+public:
+    enum { DEFAULT_SLOTS = 64 };
+
+    bool create(const QString& name, int channels, quint32 maxPoints, quint32 maxPayload,
+        quint32 configHash, quint32 slotCount = DEFAULT_SLOTS)
+    {
+        const size_t slot = ShmScan::slotBytes(maxPoints, maxPayload);
+        if (!slotCount || !m_segment.create(name, sizeof(ShmScan::Header) + slot * slotCount)) return false;
+        uchar* base = (uchar*)m_segment.data();
+        memset(base, 0, m_segment.size());
+
+        m_header = new (base) ShmScan::Header;
+        m_header->version = ShmScan::VERSION;
+        m_header->channels = quint16(channels);
+        m_header->slotCount = slotCount;
+        m_header->slotBytes = quint32(slot);
+        m_header->maxPoints = maxPoints;
+        m_header->maxPayload = maxPayload;
+        m_header->configHash = configHash;
+#ifdef Q_OS_WIN
+        m_header->writerPid = quint32(GetCurrentProcessId());
+#else
+        m_header->writerPid = quint32(getpid());
+#endif
+        m_header->head.store(0, std::memory_order_relaxed);
+        m_header->live.store(1, std::memory_order_relaxed);
+        for (quint32 i = 0; i < slotCount; ++i) new (base + sizeof(ShmScan::Header) + slot * i) ShmScan::SlotHeader;
+        // A reader trusts the header once it sees the magic.
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header->magic = ShmScan::MAGIC;
+        return true;
+    }
+
+    void close()
+    {
+        if (m_header) m_header->live.store(0, std::memory_order_release);
+        m_header = nullptr;
+        m_segment.close();
+    }
+
+    ~CShmScanWriter() { close(); }
+
+    bool isOpen() const { return m_header != nullptr; }
+
+    // points: x, y pairs in meters, count pairs (clipped to maxPoints); payload clipped to maxPayload.
+    quint64 publish(qint64 epochNs, const float* points, int count, const QByteArray& payload)
+    {
+        const quint64 seq = m_header->head.load(std::memory_order_relaxed);
+        uchar* slot = (uchar*)m_header + sizeof(ShmScan::Header) + size_t(m_header->slotBytes) * (seq % m_header->slotCount);
+        ShmScan::SlotHeader* h = (ShmScan::SlotHeader*)slot;
+
+        const quint32 v = h->lock.load(std::memory_order_relaxed);
+        h->lock.store(v + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        h->pointCount = quint32(qBound(0, count, int(m_header->maxPoints)));
+        h->payloadBytes = quint32(qMin(payload.size(), int(m_header->maxPayload)));
+        h->seq = seq;
+        h->epochNs = epochNs;
+        h->configHash = m_header->configHash;
+        memcpy(slot + sizeof(ShmScan::SlotHeader), points, h->pointCount * 2 * sizeof(float));
+        memcpy(slot + sizeof(ShmScan::SlotHeader) + size_t(m_header->maxPoints) * 2 * sizeof(float), payload.constData(), h->payloadBytes);
+        h->publishNs = ShmScan::steadyNs();
+
+        h->lock.store(v + 2, std::memory_order_release);
+        m_header->head.store(seq + 1, std::memory_order_release);
+        return seq;
+    }
+
+private:
+    ShmScan::Segment m_segment;
+    ShmScan::Header* m_header = nullptr;
+};
+
+/**
+ * @brief Reader side: polls the ring head, no syscalls after open().
+ *
+ * view() hands out pointers into the segment; the callback's work counts only
+ * when view() returns true (the slot wasn't overwritten meanwhile). next()
+ * copies into a reused Scan.
+ */
+class CShmScanReader
+{
+public:
+    struct View {
+        quint64 seq;
+        qint64 epochNs;
+        qint64 publishNs;
+        quint32 configHash;
+        const float* points;    // x, y pairs, meters
+        int pointCount;
+        const uchar* payload;
+        int payloadBytes;
+    };
+
+    struct Scan {
+        quint64 seq = 0;
+        qint64 epochNs = 0;
+        qint64 publishNs = 0;
+        quint32 configHash = 0;
+        QVector<float> points;
+        QByteArray payload;
+    };
+
+    // Starts at the newest scan (or the oldest still in the ring).
+    bool open(const QString& name, bool fromOldest = false)
+    {
+        if (!m_segment.open(name) || m_segment.size() < sizeof(ShmScan::Header)) return false;
+        m_header = (const ShmScan::Header*)m_segment.data();
+        if (m_header->magic != ShmScan::MAGIC || m_header->version != ShmScan::VERSION
+            || m_segment.size() < sizeof(ShmScan::Header) + size_t(m_header->slotBytes) * m_header->slotCount) {
+            close();
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const quint64 head = m_header->head.load(std::memory_order_acquire);
+        m_next = fromOldest ? (head > m_header->slotCount ? head - m_header->slotCount : 0) : (head ? head - 1 : 0);
+        m_lost = 0;
+        return true;
+    }
+
+    void close()
+    {
+        m_header = nullptr;
+        m_segment.close();
+    }
+
+    bool isOpen() const { return m_header != nullptr; }
+    // False once the writer closed: reopen to follow a restarted writer.
+    bool isLive() const { return m_header && m_header->live.load(std::memory_order_acquire); }
+    int channels() const { return m_header->channels; }
+    quint32 configHash() const { return m_header->configHash; }
+    quint64 lost() const { return m_lost; }
+    quint64 published() const { return m_header->head.load(std::memory_order_acquire); }
+
+    // The next unread scan, if any: f(const View&). False when nothing new or it was overwritten.
+    template <typename F>
+    bool view(F f)
+    {
+        const quint64 head = m_header->head.load(std::memory_order_acquire);
+        if (m_next >= head) return false;
+        if (head - m_next > m_header->slotCount) {
+            m_lost += head - m_header->slotCount - m_next;
+            m_next = head - m_header->slotCount;
+        }
+
+        const uchar* slot = (const uchar*)m_header + sizeof(ShmScan::Header) + size_t(m_header->slotBytes) * (m_next % m_header->slotCount);
+        const ShmScan::SlotHeader* h = (const ShmScan::SlotHeader*)slot;
+        const quint32 before = h->lock.load(std::memory_order_acquire);
+        bool ok = !(before & 1) && h->seq == m_next;
+        if (ok) {
+            View v;
+            v.seq = h->seq;
+            v.epochNs = h->epochNs;
+            v.publishNs = h->publishNs;
+            v.configHash = h->configHash;
+            v.pointCount = int(qMin(h->pointCount, m_header->maxPoints));
+            v.payloadBytes = int(qMin(h->payloadBytes, m_header->maxPayload));
+            v.points = (const float*)(slot + sizeof(ShmScan::SlotHeader));
+            v.payload = slot + sizeof(ShmScan::SlotHeader) + size_t(m_header->maxPoints) * 2 * sizeof(float);
+            f(v);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            ok = h->lock.load(std::memory_order_relaxed) == before;
+        }
+        if (!ok) ++m_lost; // overwritten while (or before) reading
+        ++m_next;
+        return ok;
+    }
+
+    bool next(Scan* out)
+    {
+        while (published() > m_next) {
+            bool ok = view([out](const View& v) {
+                out->seq = v.seq;
+                out->epochNs = v.epochNs;
+                out->publishNs = v.publishNs;
+                out->configHash = v.configHash;
+                out->points.resize(v.pointCount * 2);
+                memcpy(out->points.data(), v.points, v.pointCount * 2 * sizeof(float));
+                out->payload.resize(v.payloadBytes);
+                memcpy(out->payload.data(), v.payload, v.payloadBytes);
+            });
+            if (ok) return true;
+        }
+        return false;
+    }
+
+    // Spins, then yields, then naps 50 us, until a scan arrives or timeoutUs passes.
+    bool waitNext(Scan* out, qint64 timeoutUs)
+    {
+        const qint64 deadline = ShmScan::steadyNs() + timeoutUs * 1000;
+        for (int spin = 0; ; ++spin) {
+            if (next(out)) return true;
+            if (ShmScan::steadyNs() >= deadline) return false;
+            if (spin > 10000) std::this_thread::sleep_for(std::chrono::microseconds(50));
+            else if (spin > 1000) std::this_thread::yield();
+        }
+    }
+
+private:
+    ShmScan::Segment m_segment;
+    const ShmScan::Header* m_header = nullptr;
+    quint64 m_next = 0;
+    quint64 m_lost = 0;
+};
+
+#endif // CSHMSCANRING_H
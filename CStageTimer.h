@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSTAGETIMER_H
+#define CSTAGETIMER_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+#include <QMutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Per-stage latency histograms, one block per recording thread.
+ *
+ * Buckets are log-linear: 8 per power of two (values < 8 ns exact), so a
+ * bucket is at most 12.5% wide, below 2^39 ns; longer samples go to the last
+ * bucket. A thread only writes its own
+ * block (relaxed load + store, no lock, no RMW); snapshot() sums the blocks
+ * under the registry mutex, and intervals are the difference of two snapshots.
+ */
+class CStageTimer
+{
+public:
+    enum class eStage { inbox, recv, unpack, filter, process, lumos, paint, scan, COUNT };
+    enum { STAGE_COUNT = (int)eStage::COUNT, SUB_BITS = 3, SUB_BUCKETS = 1 << SUB_BITS,
+        MAX_EXP = 39, BUCKETS = (MAX_EXP - SUB_BITS + 1) * SUB_BUCKETS };
+
+    static const char* name(eStage stage)
+    {
+        static const char* names[STAGE_COUNT] = { "inbox", "recv", "unpack", "filter", "process", "lumos", "paint", "scan" };
+        return names[(int)stage];
+    }
+
+    static qint64 now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void setEnabled(bool enabled) { flag().store(enabled, std::memory_order_relaxed); }
+    static bool isEnabled() { return flag().load(std::memory_order_relaxed); }
+
+    static void record(eStage stage, qint64 ns)
+    {
+        Block& b = local();
+        const int s = (int)stage;
+        bump(b.counts[s][bucketOf(ns)], 1);
+        bump(b.total[s], 1);
+        if (ns > b.maxNs[s].load(std::memory_order_relaxed)) b.maxNs[s].store(ns, std::memory_order_relaxed);
+    }
+
+    static void addBytes(qint64 bytes)
+    {
+        if (isEnabled() && bytes > 0) bump(local().bytes, quint64(bytes));
+    }
+
+    static int bucketOf(qint64 ns)
+    {
+        if (ns < SUB_BUCKETS) return ns < 0 ? 0 : int(ns);
+        const int e = 63 - qCountLeadingZeroBits(quint64(ns));
+        if (e >= MAX_EXP) return BUCKETS - 1;
+        return (e - SUB_BITS + 1) * SUB_BUCKETS + int((ns >> (e - SUB_BITS)) & (SUB_BUCKETS - 1));
+    }
+
+    // Range of bucket b, [lower, upper] ns.
+    static qint64 bucketLowerNs(int b)
+    {
+        if (b < SUB_BUCKETS) return b;
+        const int e = b / SUB_BUCKETS + SUB_BITS - 1;
+        return qint64(SUB_BUCKETS + b % SUB_BUCKETS) << (e - SUB_BITS);
+    }
+    static qint64 bucketUpperNs(int b)
+    {
+        if (b < SUB_BUCKETS) return b;
+        const int e = b / SUB_BUCKETS + SUB_BITS - 1;
+        return bucketLowerNs(b) + (qint64(1) << (e - SUB_BITS)) - 1;
+    }
+
+    struct Snapshot {
+        qint64 timeNs = 0;
+        quint64 counts[STAGE_COUNT][BUCKETS] = {};
+        quint64 total[STAGE_COUNT] = {};
+        qint64 maxNs[STAGE_COUNT] = {};   // since start
+        quint64 bytes = 0;
+    };
+
+    static void snapshot(Snapshot* out)
+    {
+        *out = Snapshot();
+        out->timeNs = now();
+        Registry& r = registry();
+        QMutexLocker locker(&r.mutex);
+        for (const std::unique_ptr<Block>& b : r.blocks) {
+            for (int s = 0; s < STAGE_COUNT; ++s) {
+                for (int k = 0; k < BUCKETS; ++k) out->counts[s][k] += b->counts[s][k].load(std::memory_order_relaxed);
+                out->total[s] += b->total[s].load(std::memory_order_relaxed);
+                out->maxNs[s] = qMax(out->maxNs[s], b->maxNs[s].load(std::memory_order_relaxed));
+            }
+            out->bytes += b->bytes.load(std::memory_order_relaxed);
+        }
+    }
+
+    struct Summary {
+        quint64 count = 0;
+        double p50Us = 0, p99Us = 0, maxUs = 0;
+    };
+
+    // Between two snapshots (before may be empty: since start). Max is the top bucket, capped by the exact max.
+    static Summary summarize(const Snapshot& now, const Snapshot& before, eStage stage)
+    {
+        const int s = (int)stage;
+        Summary sum;
+        sum.count = now.total[s] - before.total[s];
+        if (!sum.count) return sum;
+
+        const quint64 rank50 = (sum.count + 1) / 2, rank99 = qMax<quint64>(1, (sum.count * 99 + 99) / 100);
+        quint64 seen = 0;
+        int top = 0;
+        for (int k = 0; k < BUCKETS; ++k) {
+            const quint64 c = now.counts[s][k] - before.counts[s][k];
+            if (!c) continue;
+            const double mid = (bucketLowerNs(k) + bucketUpperNs(k)) / 2000.0;
+            if (seen < rank50 && seen + c >= rank50) sum.p50Us = mid;
+            if (seen < rank99 && seen + c >= rank99) sum.p99Us = mid;
+            seen += c;
+            top = k;
+        }
+        sum.maxUs = qMin(bucketUpperNs(top), now.maxNs[s]) / 1000.0;
+        return sum;
+    }
+
+private:
+    struct Block {
+        std::atomic<quint64> counts[STAGE_COUNT][BUCKETS];
+        std::atomic<quint64> total[STAGE_COUNT];
+        std::atomic<qint64> maxNs[STAGE_COUNT];
+        std::atomic<quint64> bytes;
+    };
+
+    struct Registry {
+        QMutex mutex;
+        std::vector<std::unique_ptr<Block>> blocks; // kept for the process lifetime
+    };
+
+    static std::atomic<bool>& flag()
+    {
+        static std::atomic<bool> enabled{ true };
+        return enabled;
+    }
+
+    static Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    // Single writer per block: no read-modify-write needed.
+    static void bump(std::atomic<quint64>& counter, quint64 n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static Block& local()
+    {
+        thread_local Block* block = nullptr;
+        if (!block) {
+            std::unique_ptr<Block> fresh(new Block());
+            block = fresh.get();
+            Registry& r = registry();
+            QMutexLocker locker(&r.mutex);
+            r.blocks.push_back(std::move(fresh));
+        }
+        return *block;
+    }
+};
+
+/**
+ * @brief Records the lifetime of the scope into a stage (nothing while disabled).
+ */
+class CStageScope
+{
+public:
+    explicit CStageScope(CStageTimer::eStage stage)
+        : m_stage(stage), m_start(CStageTimer::isEnabled() ? CStageTimer::now() : -1) {}
+    ~CStageScope()
+    {
+        if (m_start >= 0) CStageTimer::record(m_stage, CStageTimer::now() - m_start);
+    }
+
+private:
+    CStageTimer::eStage m_stage;
+    qint64 m_start;
+};
+
+#endif // CSTAGETIMER_H
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSYNTHSCENE_H
+#define CSYNTHSCENE_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFile>
+#include <QJsonDocument>
+#include <QtMath>
+#include <cmath>
+
+/**
+ * @brief Synthetic LiDAR source: ray-casts a 2D scene into getBulk payloads.
+ *
+ * The scene is in sensor coordinates (meters, angle 0 = +x, counter-clockwise):
+ * wall segments seen by every layer, and boxes that move and bounce inside
+ * `bounds` and are seen by their lowest `layers` layers. Each return gets
+ * Gaussian-like range noise and is dropped (0) with probability `dropout`.
+ *
+ * Rays are precomputed per profile and the payload is written in place, so a
+ * frame costs mesuresPerScan x (walls + 4 x boxes) intersections and no
+ * allocation. Time advances 1/rate s per frame, independent of the wall clock.
+ *
+ * scene.json: { "rate": 20, "noise": 0.01, "dropout": 0.005, "maxRange": 40,
+ *   "walls": [[x1,y1,x2,y2], ...],
+ *   "boxes": [{ "x":, "y":, "w":, "h":, "vx":, "vy":, "layers": }, ...],
+ *   "bounds": [xmin, ymin, xmax, ymax] }
+ */
+class CSynthScene
+{
+public:
+    struct Wall { float x1, y1, x2, y2; };
+    struct Box { float x, y, w, h, vx, vy; int layers; };
+
+    CSynthScene() { setScene(defaultScene()); }
+
+    static QJsonObject defaultScene()
+    {
+        // 20 x 12 m room around the sensor, a pillar, three moving boxes
+        QJsonObject scene;
+        scene["rate"] = 20;
+        scene["noise"] = 0.01;
+        scene["dropout"] = 0.005;
+        scene["maxRange"] = 40.0;
+        scene["walls"] = QJsonArray{
+            QJsonArray{ -6, -10, 6, -10 }, QJsonArray{ 6, -10, 6, 10 },
+            QJsonArray{ 6, 10, -6, 10 }, QJsonArray{ -6, 10, -6, -10 },
+            QJsonArray{ 2, 3, 2.5, 3 }, QJsonArray{ 2.5, 3, 2.5, 3.5 },
+            QJsonArray{ 2.5, 3.5, 2, 3.5 }, QJsonArray{ 2, 3.5, 2, 3 } };
+        scene["boxes"] = QJsonArray{
+            QJsonObject{ { "x", 3.0 }, { "y", -4.0 }, { "w", 0.6 }, { "h", 0.6 }, { "vx", 0.0 }, { "vy", 1.2 }, { "layers", 4 } },
+            QJsonObject{ { "x", -3.0 }, { "y", 2.0 }, { "w", 1.8 }, { "h", 0.8 }, { "vx", 0.8 }, { "vy", -0.5 }, { "layers", 2 } },
+            QJsonObject{ { "x", 0.0 }, { "y", 6.0 }, { "w", 0.4 }, { "h", 0.4 }, { "vx", -1.5 }, { "vy", 0.0 }, { "layers", 1 } } };
+        scene["bounds"] = QJsonArray{ -5.5, -9.5, 5.5, 9.5 };
+        return scene;
+    }
+
+    // scene.json when present, otherwise the default scene.
+    static QJsonObject loadScene(const QString& path = "scene.json")
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return defaultScene();
+        QJsonObject scene = QJsonDocument::fromJson(file.readAll()).object();
+        return scene.isEmpty() ? defaultScene() : scene;
+    }
+
+    void setScene(const QJsonObject& scene)
+    {
+        m_rate = qMax(1.0, scene["rate"].toDouble(20));
+        m_noise = (float)scene["noise"].toDouble(0.01);
+        m_dropout = (float)scene["dropout"].toDouble(0.0);
+        m_maxRange = (float)scene["maxRange"].toDouble(40.0);
+
+        m_walls.clear();
+        for (const QJsonValue& v : scene["walls"].toArray()) {
+            QJsonArray w = v.toArray();
+            m_walls.append({ (float)w[0].toDouble(), (float)w[1].toDouble(), (float)w[2].toDouble(), (float)w[3].toDouble() });
+        }
+        m_boxes.clear();
+        for (const QJsonValue& v : scene["boxes"].toArray()) {
+            QJsonObject b = v.toObject();
+            m_boxes.append({ (float)b["x"].toDouble(), (float)b["y"].toDouble(), (float)b["w"].toDouble(0.5),
+                (float)b["h"].toDouble(0.5), (float)b["vx"].toDouble(), (float)b["vy"].toDouble(), b["layers"].toInt(4) });
+        }
+        QJsonArray bounds = scene["bounds"].toArray();
+        for (int i = 0; i < 4; ++i) m_bounds[i] = (float)bounds[i].toDouble(i < 2 ? -10.0 : 10.0);
+        m_initialBoxes = m_boxes;
+        m_frame = 0;
+    }
+
+    // rawToMeter = distanceRate * unitToMeter of the profile.
+    void setProfile(int channels, float resolution, int mesuresPerScan, float rawToMeter)
+    {
+        m_channels = qMax(1, channels);
+        m_measures = qMax(0, mesuresPerScan);
+        m_meterToRaw = rawToMeter > 0 ? 1.0f / rawToMeter : 0.0f;
+
+        const quint16 step = quint16(resolution * 100);
+        m_angles.resize(m_measures);
+        m_dirX.resize(m_measures);
+        m_dirY.resize(m_measures);
+        for (int i = 0; i < m_measures; ++i) {
+            m_angles[i] = quint16(i * step);
+            float radian = (m_angles[i] / 100.0f) * float(M_PI / 180.0);
+            m_dirX[i] = std::cos(radian);
+            m_dirY[i] = std::sin(radian);
+        }
+        m_range.resize(m_channels);
+        m_payload = QByteArray(payloadBytes(), 0);
+    }
+
+    int payloadBytes() const { return m_measures * (2 + m_channels * 2); }
+    double rate() const { return m_rate; }
+    void setRate(double hz) { m_rate = qMax(1.0, hz); }
+    double time() const { return m_frame / m_rate; }
+
+    // Next frame into out (payloadBytes()), big endian [angle, dist x channels] per measurement.
+    void generate(uchar* out)
+    {
+        const float t = float(time());
+        moveBoxes(t);
+
+        uchar* p = out;
+        for (int i = 0; i < m_measures; ++i) {
+            castRay(m_dirX[i], m_dirY[i], m_range.data());
+            *p++ = uchar(m_angles[i] >> 8);
+            *p++ = uchar(m_angles[i]);
+            for (int c = 0; c < m_channels; ++c) {
+                quint16 raw = toRaw(m_range[c]);
+                *p++ = uchar(raw >> 8);
+                *p++ = uchar(raw);
+            }
+        }
+        ++m_frame;
+    }
+
+    // Next frame in the internal buffer (reused: copy it if it must outlive the next call).
+    const QByteArray& nextPayload()
+    {
+        generate((uchar*)m_payload.data());
+        return m_payload;
+    }
+
+private:
+    void moveBoxes(float t)
+    {
+        // position at t bounced between the bounds (triangle wave), no accumulated drift
+        for (int b = 0; b < m_boxes.size(); ++b) {
+            const Box& s = m_initialBoxes[b];
+            Box& box = m_boxes[b];
+            box.x = bounce(s.x + s.vx * t, m_bounds[0], m_bounds[2] - s.w);
+            box.y = bounce(s.y + s.vy * t, m_bounds[1], m_bounds[3] - s.h);
+        }
+    }
+
+    static float bounce(float v, float lo, float hi)
+    {
+        float span = hi - lo;
+        if (span <= 0) return lo;
+        float u = std::fmod(v - lo, 2 * span);
+        if (u < 0) u += 2 * span;
+        return lo + (u <= span ? u : 2 * span - u);
+    }
+
+    // Nearest hit per layer along (dx, dy); no hit = +inf.
+    void castRay(float dx, float dy, float* range) const
+    {
+        float wallHit = INFINITY;
+        for (const Wall& w : m_walls) wallHit = qMin(wallHit, hitSegment(dx, dy, w.x1, w.y1, w.x2, w.y2));
+        for (int c = 0; c < m_channels; ++c) range[c] = wallHit;
+
+        for (const Box& b : m_boxes) {
+            float hit = hitBox(dx, dy, b);
+            if (hit >= wallHit) continue;
+            for (int c = 0; c < qMin(b.layers, m_channels); ++c) range[c] = qMin(range[c], hit);
+        }
+    }
+
+    static float hitSegment(float dx, float dy, float x1, float y1, float x2, float y2)
+    {
+        const float ex = x2 - x1, ey = y2 - y1;
+        const float det = dx * ey - dy * ex;
+        if (std::fabs(det) < 1e-9f) return INFINITY;
+        const float t = (x1 * ey - y1 * ex) / det;   // along the ray
+        const float s = (x1 * dy - y1 * dx) / det;   // along the segment
+        return (t > 0 && s >= 0 && s <= 1) ? t : INFINITY;
+    }
+
+    // Slab test against the axis-aligned box.
+    static float hitBox(float dx, float dy, const Box& b)
+    {
+        float tmin = 0, tmax = INFINITY;
+        const float lo[2] = { b.x, b.y }, hi[2] = { b.x + b.w, b.y + b.h }, d[2] = { dx, dy };
+        for (int k = 0; k < 2; ++k) {
+            if (std::fabs(d[k]) < 1e-9f) {
+                if (lo[k] > 0 || hi[k] < 0) return INFINITY;
+                continue;
+            }
+            float t1 = lo[k] / d[k], t2 = hi[k] / d[k];
+            if (t1 > t2) std::swap(t1, t2);
+            tmin = qMax(tmin, t1);
+            tmax = qMin(tmax, t2);
+            if (tmin > tmax) return INFINITY;
+        }
+        return tmin > 0 ? tmin : INFINITY;
+    }
+
+    quint16 toRaw(float meter)
+    {
+        if (!(meter < m_maxRange) || nextUniform() < m_dropout) return 0;
+        // Irwin-Hall (4 uniforms) ~ N(0, 1/3): cheap, bounded noise
+        float n = (nextUniform() + nextUniform() + nextUniform() + nextUniform() - 2.0f) * 1.7320508f;
+        float raw = (meter + n * m_noise) * m_meterToRaw;
+        return raw <= 1.0f ? 1 : (raw >= 65535.0f ? 65535 : quint16(raw + 0.5f));
+    }
+
+    float nextUniform()
+    {
+        // xorshift32
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return (m_seed >> 8) * (1.0f / 16777216.0f);
+    }
+
+    QVector<Wall> m_walls;
+    QVector<Box> m_boxes, m_initialBoxes;
+    float m_bounds[4] = { -10, -10, 10, 10 };
+    double m_rate = 20;
+    float m_noise = 0.01f;
+    float m_dropout = 0.0f;
+    float m_maxRange = 40.0f;
+
+    int m_channels = 1;
+    int m_measures = 0;
+    float m_meterToRaw = 0;
+    QVector<quint16> m_angles;
+    QVector<float> m_dirX, m_dirY;
+    QVector<float> m_range;
+    QByteArray m_payload;
+
+    quint64 m_frame = 0;
+    quint32 m_seed = 0x9E3779B9u;
+};
+
+#endif // CSYNTHSCENE_H
@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2024
+ *
+ * This file is part of LumosLiDARViewer.
+ *
+ * LumosLiDARViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * LumosLiDARViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LumosLiDARViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * LumoTests: qmake tests/CLumoTests.pro && make check
+ */
+
+#include <QtTest>
+#include <memory>
+
+#include "CStageTimer.h"
+#include "CScanFilter.h"
+#include "CProtocol.h"
+#include "CEmuDevice.h"
+#include "CBlackBox.h"
+#include "CScanRecord.h"
+#include "CScanCodec.h"
+
+namespace {
+
+// One-layer getBulk payload: bin 0 = `range`, the other bins a steady 500.
+QByteArray scanPayload(int bins, quint16 range)
+{
+    QByteArray payload(bins * 4, 0);
+    for (int i = 0; i < bins; ++i) {
+        const quint16 d = i == 0 ? range : 500;
+        payload[i * 4 + 2] = char(d >> 8);
+        payload[i * 4 + 3] = char(d);
+    }
+    return payload;
+}
+
+quint16 firstRange(const QByteArray& payload)
+{
+    return quint16((uchar(payload[2]) << 8) | uchar(payload[3]));
+}
+
+// Frame i of a test sequence: the first half changes every frame, the second every 5 frames.
+QByteArray testFrame(int i, int size)
+{
+    QByteArray frame(size, 0);
+    for (int k = 0; k < size; ++k) frame[k] = char(k < size / 2 ? k * 13 + i * 7 : k / 16 + i / 5);
+    return frame;
+}
+
+enum { RECORDED_FRAMES = 2 * CScanCodec::KEYFRAME_INTERVAL + 3, RECORDED_HASH = 0x1234 };
+
+// Frames 1 ms apart on links 0..2; the size changes at frame 50 (a forced keyframe when coded).
+QVector<QByteArray> writeRecording(const QString& path, bool compressed, const QJsonObject& config)
+{
+    QVector<QByteArray> frames;
+    CScanRecorder recorder;
+    recorder.setCompressed(compressed);
+    if (!recorder.open(path, config, RECORDED_HASH, 1700000000000LL)) return frames;
+    for (int i = 0; i < RECORDED_FRAMES; ++i) {
+        frames.append(testFrame(i, i < 50 ? 256 : 200));
+        recorder.write(frames.last(), quint16(i % 3), RECORDED_HASH, i * 1000000LL);
+    }
+    recorder.close();
+    return frames;
+}
+
+// Every frame of reader equals frames, in order and backwards (coded frames decode from their keyframe).
+void compareFrames(const CScanReader& reader, const QVector<QByteArray>& frames)
+{
+    QCOMPARE(reader.frameCount(), frames.size());
+    IFrameSource::Frame frame;
+    for (int i = 0; i < frames.size(); ++i) {
+        QCOMPARE(reader.frameSize(i), frames[i].size());
+        QVERIFY(reader.frame(i, &frame));
+        QCOMPARE(frame.data, frames[i]);
+        QCOMPARE(frame.timeNs, quint64(i * 1000000LL));
+        QCOMPARE(frame.linkId, quint16(i % 3));
+        QCOMPARE(frame.configHash, quint32(RECORDED_HASH));
+    }
+    for (int i = frames.size() - 1; i >= 0; i -= 7) {
+        QVERIFY(reader.frame(i, &frame));
+        QCOMPARE(frame.data, frames[i]);
+    }
+}
+
+} // namespace
+
+class CLumoTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void stageTimerBuckets()
+    {
+        typedef CStageTimer T;
+        QCOMPARE(T::bucketOf(-1), 0);
+        QCOMPARE(T::bucketOf(qint64(~0ull)), 0);
+        QCOMPARE(T::bucketOf(7), 7);
+        QCOMPARE(T::bucketOf((1LL << 39) - 1), T::BUCKETS - 1);
+        QCOMPARE(T::bucketOf(1LL << 39), T::BUCKETS - 1);
+        QCOMPARE(T::bucketOf(qint64(~0ull >> 1)), T::BUCKETS - 1);
+        for (int e = 0; e < 63; ++e) {
+            const int b = T::bucketOf(1LL << e);
+            QVERIFY(b >= 0 && b < T::BUCKETS);
+            if (e < T::MAX_EXP) QVERIFY(T::bucketLowerNs(b) == (1LL << e));
+        }
+    }
+
+    void stageTimerRecordsLongSamples()
+    {
+        CStageTimer::setEnabled(true);
+        std::unique_ptr<CStageTimer::Snapshot> before(new CStageTimer::Snapshot), after(new CStageTimer::Snapshot);
+        CStageTimer::snapshot(before.get());
+        CStageTimer::record(CStageTimer::eStage::scan, qint64(~0ull >> 1));
+        CStageTimer::record(CStageTimer::eStage::scan, 1LL << 39);
+        CStageTimer::snapshot(after.get());
+        const int s = (int)CStageTimer::eStage::scan, last = CStageTimer::BUCKETS - 1;
+        QCOMPARE(after->counts[s][last] - before->counts[s][last], quint64(2));
+    }
+
+    // A bin dropping in and out (0 = no return) must never lose a real return to 0.
+    void scanFilterIgnoresNoReturn()
+    {
+        const quint16 patterns[2][6] = { { 1000, 0, 1000, 0, 1000, 0 }, { 0, 0, 1000, 0, 0, 1000 } };
+        const CScanFilter::eMode modes[2] = { CScanFilter::eMode::median, CScanFilter::eMode::spike };
+        for (const quint16* pattern : patterns) {
+            for (CScanFilter::eMode mode : modes) {
+                for (int depth : { 3, 5 }) {
+                    CScanFilter filter;
+                    filter.setMode(mode, depth);
+                    for (int scan = 0; scan < 30; ++scan) {
+                        const quint16 in = pattern[scan % 6];
+                        QByteArray payload = scanPayload(8, in);
+                        filter.apply(payload, 1);
+                        const quint16 out = firstRange(payload);
+                        if (in) QCOMPARE(out, in);
+                        else QVERIFY(out == 0 || out == 1000);
+                        QCOMPARE(quint16((uchar(payload[6]) << 8) | uchar(payload[7])), quint16(500));
+                    }
+                }
+            }
+        }
+    }
+
+    void scanFilterMedianAndSpike()
+    {
+        CScanFilter filter;
+        filter.setMode(CScanFilter::eMode::median, 3);
+        const quint16 ranges[] = { 1000, 1010, 4000, 1020 };
+        const quint16 medians[] = { 1000, 1010, 1010, 1020 };
+        for (int i = 0; i < 4; ++i) {
+            QByteArray payload = scanPayload(4, ranges[i]);
+            filter.apply(payload, 1);
+            QCOMPARE(firstRange(payload), medians[i]);
+        }
+
+        filter.setMode(CScanFilter::eMode::spike, 3);
+        const quint16 spiked[] = { 1000, 1010, 1010, 1020 };
+        for (int i = 0; i < 4; ++i) {
+            QByteArray payload = scanPayload(4, ranges[i]);
+            filter.apply(payload, 1);
+            QCOMPARE(firstRange(payload), spiked[i]);
+        }
+    }
+
+    // setParam carries its payload size in words (wCnt), as protocol.h packs it for the firmware.
+    void protocolPacksSetParam()
+    {
+        QByteArray data = QByteArray::fromHex("0102a0b0");
+        const QByteArray packet = Protocol::pack(Protocol::eCmd::setParam, 3, 0x10, 0, &data);
+        // AA 00 'A' 'E', length 7 + words, dType, sAddr, wCnt = 2, data, CRC16 from the length field, CR
+        QCOMPARE(packet.toHex(), QByteArray("aa0041450009000300100002" "0102a0b0" "2f0a0d"));
+    }
+
+    // setParam as Protocol packs it, stored by the emulated device and read back with getParam.
+    void protocolSetParamRoundTrip()
+    {
+        const quint16 words[] = { 0x0102, 0xA0B0, 0xFFFF };
+        QByteArray data;
+        for (quint16 w : words) {
+            data.append(char(w >> 8));
+            data.append(char(w));
+        }
+        const QByteArray set = Protocol::pack(Protocol::eCmd::setParam, 3, 0x10, 0, &data);
+        QCOMPARE(CEmuDevice::requestLength((const uchar*)set.constData(), set.size()), set.size());
+        QCOMPARE(CEmuDevice::requestLength((const uchar*)set.constData(), set.size() - 1), set.size());
+
+        CEmuScanSource source;
+        CEmuDevice device(0, &source);
+        QVERIFY(device.listen(CEmuDevice::eTransport::tcp, QHostAddress::LocalHost, 0));
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, device.port());
+        QVERIFY(socket.waitForConnected(2000));
+
+        socket.write(set);
+        QTRY_COMPARE(socket.bytesAvailable(), qint64(15));
+        const QByteArray ack = socket.readAll();
+        QCOMPARE(ack.mid(2, 2), QByteArray("AE"));
+
+        socket.write(Protocol::pack(Protocol::eCmd::getParam, 3, 0x10, 3));
+        QTRY_COMPARE(socket.bytesAvailable(), qint64(12 + 6 + 3));
+        const QByteArray reply = socket.readAll();
+        for (int i = 0; i < 3; ++i) QCOMPARE(quint16((uchar(reply[12 + i * 2]) << 8) | uchar(reply[13 + i * 2])), words[i]);
+        QCOMPARE(device.stats().badRequests, quint64(0));
+    }
+
+    // Keyframes, deltas up to and across KEYFRAME_INTERVAL, zero runs and wrapped words.
+    void codecRoundTrip()
+    {
+        typedef CScanCodec C;
+        for (int size : { 256, 257 }) {
+            QByteArray prev, decoded(size, 0);
+            for (int i = 0; i <= 2 * C::KEYFRAME_INTERVAL + 1; ++i) {
+                QByteArray cur = testFrame(i, size);
+                // word 0 wraps 0 <-> 65535, word 1 swings by 0x8000 (the largest zigzag)
+                cur[0] = cur[1] = char(i & 1 ? 0xFF : 0);
+                cur[2] = char(i & 1 ? 0x80 : 0);
+                cur[3] = 0;
+                const bool key = i % C::KEYFRAME_INTERVAL == 0;
+                QByteArray coded;
+                const int n = C::encode((const uchar*)cur.constData(), size, key ? nullptr : (const uchar*)prev.constData(), coded);
+                QCOMPARE(n, coded.size());
+                QVERIFY(n <= C::maxEncodedSize(size));
+                QCOMPARE(C::rawSize((const uchar*)coded.constData(), n), size);
+                // in place over the previous frame, as CScanReader decodes
+                uchar* out = (uchar*)decoded.data();
+                QVERIFY(C::decode((const uchar*)coded.constData(), n, key ? nullptr : out, out, size));
+                QCOMPARE(decoded, cur);
+                prev = cur;
+            }
+        }
+
+        // an unchanged frame is a single run token
+        const QByteArray frame = testFrame(3, 256);
+        QByteArray coded;
+        QCOMPARE(C::encode((const uchar*)frame.constData(), 256, (const uchar*)frame.constData(), coded), C::HEADER_SIZE + 2);
+        QByteArray out(256, 0);
+        QVERIFY(C::decode((const uchar*)coded.constData(), coded.size(), (const uchar*)frame.constData(), (uchar*)out.data(), 256));
+        QCOMPARE(out, frame);
+    }
+
+    // Header, footer index and seek of a recording, raw and delta-coded.
+    void recordingRoundTrip()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QJsonObject config{ { "name", "test" }, { "channels", 4 } };
+        for (bool compressed : { false, true }) {
+            const QString path = dir.filePath(compressed ? "coded.lrec" : "raw.lrec");
+            const QVector<QByteArray> frames = writeRecording(path, compressed, config);
+            QCOMPARE(frames.size(), int(RECORDED_FRAMES));
+
+            CScanReader reader;
+            QVERIFY(reader.open(path));
+            QCOMPARE(reader.config(), config);
+            QCOMPARE(reader.configHash(), quint32(RECORDED_HASH));
+            QCOMPARE(reader.startEpochMs(), quint64(1700000000000LL));
+            QCOMPARE(reader.durationNs(), quint64((RECORDED_FRAMES - 1) * 1000000LL));
+            compareFrames(reader, frames);
+
+            QCOMPARE(reader.seek(0), 0);
+            QCOMPARE(reader.seek(5000000), 5);
+            QCOMPARE(reader.seek(5000001), 6);
+            QCOMPARE(reader.seek(quint64(~0ull)), RECORDED_FRAMES - 1);
+        }
+    }
+
+    // Without a footer (or with part of one) the index is rebuilt from the frames.
+    void recordingWithoutFooter()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const qint64 footerBytes = RECORDED_FRAMES * ScanRecord::INDEX_ENTRY_SIZE + ScanRecord::TRAILER_SIZE;
+        for (bool compressed : { false, true }) {
+            const QString path = dir.filePath(compressed ? "coded.lrec" : "raw.lrec");
+            const QVector<QByteArray> frames = writeRecording(path, compressed, QJsonObject());
+            QFile file(path);
+            const qint64 size = file.size();
+            const qint64 cuts[] = { size - 1, size - footerBytes + 3 * ScanRecord::INDEX_ENTRY_SIZE, size - footerBytes };
+            for (qint64 cut : cuts) {
+                QVERIFY(file.resize(cut));
+                CScanReader reader;
+                QVERIFY(reader.open(path));
+                compareFrames(reader, frames);
+            }
+
+            // a frame cut short is dropped
+            QVERIFY(file.resize(size - footerBytes - 5));
+            CScanReader reader;
+            QVERIFY(reader.open(path));
+            compareFrames(reader, frames.mid(0, frames.size() - 1));
+        }
+    }
+
+    // push -> dump -> CScanReader gives back every frame, raw and delta-coded.
+    void blackBoxDumpKeepsEveryFrame()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVector<QByteArray> frames;
+        for (int i = 0; i < 40; ++i) frames.append(testFrame(i, 256));
+
+        for (bool compressed : { false, true }) {
+            CBlackBox box;
+            QVERIFY(box.allocate(256, 1));
+            box.setCompressed(compressed);
+            box.setArmed(true);
+            for (const QByteArray& frame : frames) box.push(frame);
+
+            const QString path = dir.filePath(compressed ? "coded.lrec" : "raw.lrec");
+            QVERIFY(box.trigger(path, "test"));
+            box.waitForDump();
+
+            CScanReader reader;
+            QVERIFY(reader.open(path));
+            QCOMPARE(reader.frameCount(), frames.size());
+            IFrameSource::Frame frame;
+            for (int i = 0; i < frames.size(); ++i) {
+                QVERIFY(reader.frame(i, &frame));
+                QCOMPARE(frame.data, frames[i]);
+            }
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(CLumoTests)
+#include "CLumoTests.moc"
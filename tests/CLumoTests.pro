@@ -0,0 +1,31 @@
+# LumoTests: unit tests for the header-only pipeline pieces
+QT += core network concurrent testlib
+QT -= gui
+
+CONFIG += console c++11 testcase
+CONFIG -= app_bundle
+TARGET = LumoTests
+INCLUDEPATH += ..
+
+HEADERS += \
+    ../CStageTimer.h \
+    ../CScanFilter.h \
+    ../CEmuDevice.h \
+    ../CBlackBox.h \
+    ../CSynthScene.h \
+    ../CScanRecord.h \
+    ../CScanCodec.h \
+    ../CPcapReader.h \
+    ../CLidarConfig.h \
+    ../CProtocol.h \
+    ../crc16.h
+SOURCES += \
+    CLumoTests.cpp
+win32-msvc*: QMAKE_CXXFLAGS += /utf-8
+
+CONFIG(debug, debug|release) {
+    DESTDIR = ../antiGravity/debug
+}
+CONFIG(release, debug|release) {
+    DESTDIR = ../antiGravity/release
+}